@@ -0,0 +1,120 @@
+// @vitest-environment node
+import { describe, expect, it } from "vitest";
+import {
+  EspLinkParser,
+  LR_EV,
+  LR_LINE,
+  LR_REPLY,
+  cobsDecode,
+  crc16,
+  decodeRecord,
+  recordToLines,
+} from "@/lib/espLink";
+
+const MAC = [0x02, 0x5a, 0x48, 0x00, 0x00, 0x01];
+const MAC_STR = "02:5A:48:00:00:01";
+
+// Station side of the link: [type][MAC][payload][CRC16 LE], COBS, 0x00
+function cobsEncode(src: Uint8Array): Buffer {
+  const out: number[] = [0];
+  let codeAt = 0;
+  let code = 1;
+  for (const b of src) {
+    if (b === 0) {
+      out[codeAt] = code;
+      codeAt = out.length;
+      out.push(0);
+      code = 1;
+      continue;
+    }
+    out.push(b);
+    if (++code === 0xff) {
+      out[codeAt] = code;
+      codeAt = out.length;
+      out.push(0);
+      code = 1;
+    }
+  }
+  out[codeAt] = code;
+  return Buffer.from(out);
+}
+
+function encodeRecord(type: number, payload: Uint8Array | string): Buffer {
+  const body = Buffer.concat([Buffer.from([type, ...MAC]), Buffer.from(payload)]);
+  const crc = crc16(body);
+  const rec = Buffer.concat([body, Buffer.from([crc & 0xff, crc >> 8])]);
+  return Buffer.concat([cobsEncode(rec), Buffer.from([0])]);
+}
+
+function feed(chunks: Buffer[]): { lines: string[]; parser: EspLinkParser } {
+  const parser = new EspLinkParser();
+  const lines: string[] = [];
+  parser.on("data", (l: string) => lines.push(l));
+  for (const c of chunks) parser.write(c);
+  return { lines, parser };
+}
+
+describe("espLink record decoding", () => {
+  it("round-trips encoded records into the text lines", () => {
+    const { lines, parser } = feed([
+      encodeRecord(LR_LINE, "WELCOME " + MAC_STR),
+      encodeRecord(LR_EV, Buffer.from([0x50, 7, 1])),
+      encodeRecord(LR_REPLY, "RESULT SUCCESS " + MAC_STR),
+    ]);
+    expect(lines).toEqual([
+      "WELCOME " + MAC_STR,
+      `EV P 7 1 ${MAC_STR}`,
+      `← reply from ${MAC_STR}: RESULT SUCCESS ${MAC_STR}`,
+    ]);
+    expect(parser.bad).toBe(0);
+  });
+
+  it("round-trips payloads containing zero bytes and long runs", () => {
+    const payload = Buffer.alloc(300, 0x41);
+    payload[10] = 0;
+    payload[299] = 0;
+    const frame = encodeRecord(LR_LINE, payload);
+    const rec = decodeRecord(frame.subarray(0, frame.length - 1));
+    expect(rec).not.toBeNull();
+    expect(rec!.type).toBe(LR_LINE);
+    expect(rec!.mac).toBe(MAC_STR);
+    expect(Buffer.compare(rec!.payload, payload)).toBe(0);
+  });
+
+  it("drops a record whose CRC does not match", () => {
+    const frame = encodeRecord(LR_LINE, "READY " + MAC_STR);
+    frame[frame.length - 2] ^= 0x01; // last CRC byte, still non-zero after COBS
+    const { lines, parser } = feed([frame, encodeRecord(LR_LINE, "after")]);
+    expect(lines).toEqual(["after"]);
+    expect(parser.bad).toBe(1);
+  });
+
+  it("skips empty frames and counts short ones", () => {
+    const { lines, parser } = feed([Buffer.from([0, 0]), Buffer.from([0x03, 0x01, 0x02, 0x00])]);
+    expect(lines).toEqual([]);
+    expect(parser.bad).toBe(1);
+    expect(cobsDecode(Buffer.from([0x05, 0x01]))).toBeNull(); // code runs past the block
+  });
+
+  it("resyncs after an overlong frame without a delimiter", () => {
+    const { lines, parser } = feed([Buffer.alloc(5000, 0x41), encodeRecord(LR_LINE, "resync")]);
+    expect(parser.bad).toBe(1);
+    expect(lines).toEqual(["resync"]);
+  });
+
+  it("joins a frame split across two chunks", () => {
+    const frame = encodeRecord(LR_REPLY, "CLEAN-OK");
+    const cut = 5;
+    const { lines } = feed([frame.subarray(0, cut), frame.subarray(cut)]);
+    expect(lines).toEqual([`← reply from ${MAC_STR}: CLEAN-OK`]);
+  });
+
+  it("prints LR_LINE as-is and LR_REPLY as a hub reply", () => {
+    const payload = Buffer.from("MONITOR-OK");
+    expect(recordToLines({ type: LR_LINE, mac: MAC_STR, payload })).toEqual(["MONITOR-OK"]);
+    expect(recordToLines({ type: LR_REPLY, mac: MAC_STR, payload })).toEqual([
+      `← reply from ${MAC_STR}: MONITOR-OK`,
+    ]);
+    expect(recordToLines({ type: 99, mac: MAC_STR, payload })).toEqual([]);
+  });
+});
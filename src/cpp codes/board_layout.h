@@ -0,0 +1,90 @@
+#pragma once
+// MCP23017 board layouts shared by hub.cpp (pin map, CHANNEL_COUNT) and
+// station.cpp (channel range of the hubs it talks to).
+//
+// A layout lists its expanders in channel order, each with the I2C bus it
+// sits on (0 = Wire, 1 = Wire1) and its address (0x20..0x27, so at most 8
+// per bus). Channels fill the expanders two pins each, LED then switch, in
+// GPIO order; swapPorts moves every pin to the other port (GPA <-> GPB),
+// which is how the current PCB groups LEDs and switches. The pin map is
+// generated from this at compile time.
+#include <stdint.h>
+#include <stddef.h>
+
+namespace kfb {
+
+static constexpr int BUSES = 2;
+static constexpr int EXPANDERS_PER_BUS = 8;  // MCP23017 A2..A0
+static constexpr int MAX_EXPANDERS = BUSES * EXPANDERS_PER_BUS;
+
+struct ExpanderDesc {
+  uint8_t bus;   // 0 = Wire, 1 = Wire1
+  uint8_t addr;  // 0x20..0x27
+};
+
+struct BoardLayout {
+  uint16_t channels;
+  bool swapPorts;
+  uint8_t expanderCount;
+  ExpanderDesc expanders[MAX_EXPANDERS];
+};
+
+struct ChannelPins { uint8_t mcpIndex, ledPin, swPin; };
+
+template <int N>
+struct PinMap {
+  ChannelPins pins[N];
+  constexpr const ChannelPins &operator[](int ch) const { return pins[ch]; }
+};
+
+constexpr ChannelPins layoutPins(const BoardLayout &b, int ch) {
+  const int base = ch * 2;
+  const int swap = b.swapPorts ? 8 : 0;
+  return {uint8_t(base / 16), uint8_t((base % 16) ^ swap), uint8_t(((base + 1) % 16) ^ swap)};
+}
+
+template <int N>
+constexpr PinMap<N> makePinMap(const BoardLayout &b) {
+  PinMap<N> m{};
+  for (int ch = 0; ch < N; ++ch) m.pins[ch] = layoutPins(b, ch);
+  return m;
+}
+
+// Enough pins, valid bus/address per expander, no address used twice on a bus
+constexpr bool layoutValid(const BoardLayout &b) {
+  if (b.channels < 1 || b.expanderCount < 1 || b.expanderCount > MAX_EXPANDERS) return false;
+  if (b.channels * 2 > b.expanderCount * 16) return false;
+  for (int i = 0; i < b.expanderCount; ++i) {
+    const ExpanderDesc &e = b.expanders[i];
+    if (e.bus >= BUSES || e.addr < 0x20 || e.addr >= 0x20 + EXPANDERS_PER_BUS) return false;
+    for (int j = 0; j < i; ++j)
+      if (b.expanders[j].bus == e.bus && b.expanders[j].addr == e.addr) return false;
+  }
+  return true;
+}
+
+constexpr bool layoutUsesBus(const BoardLayout &b, int bus) {
+  for (int i = 0; i < b.expanderCount; ++i)
+    if (b.expanders[i].bus == bus) return true;
+  return false;
+}
+
+// 5 expanders on Wire, the original fixture
+static constexpr BoardLayout LAYOUT_40CH = {
+    40, true, 5, {{0, 0x20}, {0, 0x21}, {0, 0x22}, {0, 0x23}, {0, 0x24}}};
+// A full Wire bus
+static constexpr BoardLayout LAYOUT_64CH = {
+    64, true, 8, {{0, 0x20}, {0, 0x21}, {0, 0x22}, {0, 0x23}, {0, 0x24}, {0, 0x25}, {0, 0x26}, {0, 0x27}}};
+// Both buses full
+static constexpr BoardLayout LAYOUT_128CH = {
+    128, true, 16, {{0, 0x20}, {0, 0x21}, {0, 0x22}, {0, 0x23}, {0, 0x24}, {0, 0x25}, {0, 0x26}, {0, 0x27},
+                    {1, 0x20}, {1, 0x21}, {1, 0x22}, {1, 0x23}, {1, 0x24}, {1, 0x25}, {1, 0x26}, {1, 0x27}}};
+
+static_assert(layoutValid(LAYOUT_40CH) && layoutValid(LAYOUT_64CH) && layoutValid(LAYOUT_128CH),
+              "bad board layout");
+
+// Highest channel number any hub may have: what the station accepts in
+// MONITOR/CHECK lists; each hub still checks against its own layout
+static constexpr int MAX_CHANNELS = LAYOUT_128CH.channels;
+
+} // namespace kfb
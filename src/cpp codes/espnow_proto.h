@@ -0,0 +1,195 @@
+#pragma once
+// Binary ESP-NOW framing shared by hub.cpp and station.cpp.
+//
+// Every binary frame starts with a 4-byte header. Text frames always start
+// with an ASCII letter, so the high nibble of byte 0 tells the two apart and
+// both sides can keep accepting the legacy text protocol.
+//
+//   [0] MAGIC | VERSION   [1] FrameType   [2..3] ID, little endian (0 = no ACK wanted)
+//
+// The sender MAC is never carried: receivers take it from ESP-NOW src_addr
+// and render it back into the text lines the host expects.
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+namespace kfb {
+
+static constexpr uint8_t MAGIC = 0xA0;   // high nibble; never printable ASCII
+static constexpr uint8_t VERSION = 1;    // low nibble
+static constexpr size_t HEADER_LEN = 4;
+static constexpr size_t MAX_FRAME = 250; // ESP_NOW_MAX_DATA_LEN
+
+enum FrameType : uint8_t {
+  FT_ACK    = 1, // no payload; ID = acknowledged ID
+  FT_EVENT  = 2, // [kind 'P'|'L'][channel, 1-based][value 0|1]
+  FT_REPLY  = 3, // [ReplyCode]
+  FT_RESULT = 4, // [ok 0|1][n][missing][extra][unlatched][pressed][latched], n bytes each; bit i = channel i+1
+  FT_EVENTS = 5, // [flags][n][P changed][P value][L changed][L value], n bytes each
+};
+
+// FT_RESULT: unlatched = contactless channels among missing; pressed/latched
+// are the final state of the tracked channels. Hubs before them sent only
+// missing/extra, so receivers accept n*2 bytes too.
+static constexpr size_t RESULT_SETS = 5;
+
+// FT_EVENTS flags
+static constexpr uint8_t EVF_SNAPSHOT = 0x01; // baseline: expand per channel (P then L)
+
+// Fixed replies; replyText() is the legacy text spelling of each
+enum ReplyCode : uint8_t {
+  RC_READY = 1,
+  RC_WELCOME,
+  RC_MONITOR_OK,
+  RC_MONITOR_START, // text form carries the board MAC
+  RC_AUTO_FINAL,
+  RC_BLINK_OK,
+  RC_CHASE_OK,
+  RC_PING_OK,
+  RC_CLEAN_OK,
+};
+
+inline const char *replyText(uint8_t code) {
+  switch (code) {
+    case RC_READY:         return "READY";
+    case RC_WELCOME:       return "WELCOME";
+    case RC_MONITOR_OK:    return "MONITOR-OK";
+    case RC_MONITOR_START: return "MONITOR-START";
+    case RC_AUTO_FINAL:    return "AUTO-FINAL";
+    case RC_BLINK_OK:      return "BLINK-OK";
+    case RC_CHASE_OK:      return "CHASE-OK";
+    case RC_PING_OK:       return "PING-OK";
+    case RC_CLEAN_OK:      return "CLEAN-OK";
+    default:               return nullptr;
+  }
+}
+inline bool replyHasMac(uint8_t code) { return code == RC_MONITOR_START; }
+
+struct Header {
+  uint8_t version;
+  uint8_t type;
+  uint16_t id;
+};
+
+inline bool isBinary(const uint8_t *d, int len) {
+  return d && len >= (int)HEADER_LEN && (d[0] & 0xF0) == MAGIC;
+}
+
+inline size_t putHeader(uint8_t *out, uint8_t type, uint16_t id) {
+  out[0] = uint8_t(MAGIC | VERSION);
+  out[1] = type;
+  out[2] = uint8_t(id & 0xFF);
+  out[3] = uint8_t(id >> 8);
+  return HEADER_LEN;
+}
+
+// Patch the ID of an already encoded frame (reliable send assigns it late)
+inline void setId(uint8_t *frame, uint16_t id) {
+  frame[2] = uint8_t(id & 0xFF);
+  frame[3] = uint8_t(id >> 8);
+}
+
+// False for text frames and for binary frames of an unknown version
+inline bool parseHeader(const uint8_t *d, int len, Header &h) {
+  if (!isBinary(d, len)) return false;
+  h.version = uint8_t(d[0] & 0x0F);
+  h.type = d[1];
+  h.id = uint16_t(d[2] | (d[3] << 8));
+  return h.version == VERSION;
+}
+
+// FINAL_CHECK policy for one session, carried as optional text tokens on
+// MONITOR (resets to the hub defaults first) and CHECK (adjusts the session):
+//   SAMPLES=<n> SPACING=<ms> PASS=<n>|ALL|MAJORITY SETTLE=<ms> HOLD=<ms>
+// HOLD is the auto-final hold while MONITORING; the rest shape FINAL_CHECK.
+struct CheckPolicy {
+  uint8_t samples;     // FINAL_CHECK samples
+  uint16_t spacingMs;  // between samples
+  uint8_t pass;        // passing samples needed; PASS_ALL / PASS_MAJORITY resolve against samples
+  uint16_t settleMs;   // wait before the first sample
+  uint16_t holdMs;     // MONITORING: all inputs OK this long → AUTO-FINAL
+};
+static constexpr uint8_t PASS_ALL = 0;
+static constexpr uint8_t PASS_MAJORITY = 0xFF;
+static constexpr uint8_t POLICY_MAX_SAMPLES = 16;
+static constexpr uint16_t POLICY_MAX_SPACING_MS = 1000;
+static constexpr uint16_t POLICY_MAX_SETTLE_MS = 1000;
+static constexpr uint16_t POLICY_MAX_HOLD_MS = 5000;
+// Settle plus sample spacing up to the last sample; kept well below the
+// ~2 s a reliable frame is retried for, so a CHECK answers within it
+static constexpr unsigned long POLICY_MAX_CHECK_MS = 1000;
+
+constexpr unsigned long policyCheckMs(const CheckPolicy &p) {
+  return p.settleMs + (unsigned long)(p.samples ? p.samples - 1 : 0) * p.spacingMs;
+}
+
+inline uint8_t passThreshold(const CheckPolicy &p) {
+  if (p.pass == PASS_ALL) return p.samples;
+  if (p.pass == PASS_MAJORITY) return uint8_t(p.samples / 2 + 1);
+  return p.pass < p.samples ? p.pass : p.samples;
+}
+
+// Case-insensitive "KEY=" prefix of a token
+inline bool policyKey(const char *tok, const char *key, const char *&val) {
+  for (; *key; ++tok, ++key) {
+    const char c = (*tok >= 'a' && *tok <= 'z') ? char(*tok - 32) : *tok;
+    if (c != *key) return false;
+  }
+  val = tok;
+  return true;
+}
+
+// Decimal value up to the end of the token, within [lo, hi]
+inline bool policyNumber(const char *v, const char *end, unsigned long lo, unsigned long hi, unsigned long &out) {
+  if (v == end) return false;
+  unsigned long n = 0;
+  for (; v < end; ++v) {
+    if (*v < '0' || *v > '9') return false;
+    n = n * 10 + unsigned(*v - '0');
+    if (n > hi) return false;
+  }
+  out = n;
+  return n >= lo;
+}
+
+// Apply every policy token in `s` to `p` and blank them out, so the rest of
+// the command parses as before. False if a policy token had a bad value
+// (valid ones are still applied), or if the result would take longer than
+// POLICY_MAX_CHECK_MS (then `p` is left as it was).
+inline bool takePolicy(char *s, CheckPolicy &p) {
+  const CheckPolicy before = p;
+  bool ok = true;
+  for (char *t = s; *t;) {
+    if (*t == ' ' || *t == ',') { ++t; continue; }
+    char *end = t;
+    while (*end && *end != ' ' && *end != ',') ++end;
+    const char *v = nullptr;
+    unsigned long n = 0;
+    bool known = true, good = false;
+    if (policyKey(t, "SAMPLES=", v)) {
+      if ((good = policyNumber(v, end, 1, POLICY_MAX_SAMPLES, n))) p.samples = uint8_t(n);
+    } else if (policyKey(t, "SPACING=", v)) {
+      if ((good = policyNumber(v, end, 0, POLICY_MAX_SPACING_MS, n))) p.spacingMs = uint16_t(n);
+    } else if (policyKey(t, "SETTLE=", v)) {
+      if ((good = policyNumber(v, end, 0, POLICY_MAX_SETTLE_MS, n))) p.settleMs = uint16_t(n);
+    } else if (policyKey(t, "HOLD=", v)) {
+      if ((good = policyNumber(v, end, 0, POLICY_MAX_HOLD_MS, n))) p.holdMs = uint16_t(n);
+    } else if (policyKey(t, "PASS=", v)) {
+      const char *a = nullptr;
+      if (policyKey(v, "ALL", a) && a == end) { p.pass = PASS_ALL; good = true; }
+      else if (policyKey(v, "MAJORITY", a) && a == end) { p.pass = PASS_MAJORITY; good = true; }
+      else if ((good = policyNumber(v, end, 1, POLICY_MAX_SAMPLES, n))) p.pass = uint8_t(n);
+    } else {
+      known = false;
+    }
+    if (known) {
+      ok = ok && good;
+      for (char *q = t; q < end; ++q) *q = ' ';
+    }
+    t = end;
+  }
+  if (policyCheckMs(p) > POLICY_MAX_CHECK_MS) { p = before; return false; }
+  return ok;
+}
+
+} // namespace kfb
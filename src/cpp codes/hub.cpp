@@ -21,68 +21,335 @@ void hub_cpp_requires_esp32_headers() {} // host-side stub when ESP32 SDK header
 #include "esp_err.h"
 #include <cstring>
 #include <cctype>
+#include <atomic>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/portmacro.h"
-#include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "espnow_proto.h"
+#include "latency_hist.h"
+#include "board_layout.h"
 // ==== Config ====
-static constexpr uint8_t MCP_I2C_ADDR[] = {0x20, 0x21, 0x22, 0x23, 0x24};
-static constexpr int CHANNEL_COUNT = 40;
-static constexpr size_t MAX_MSG_LEN = 128;
+static constexpr bool USE_BINARY_FRAMES = true; // false: legacy ASCII frames on air
+// Expanders and channels (board_layout.h); the host simulator builds other
+// layouts with -DKFB_HUB_LAYOUT=<name>
+#ifdef KFB_HUB_LAYOUT
+static constexpr const kfb::BoardLayout &BOARD = kfb::KFB_HUB_LAYOUT;
+#else
+static constexpr const kfb::BoardLayout &BOARD = kfb::LAYOUT_40CH;
+#endif
+static constexpr int CHANNEL_COUNT = BOARD.channels;
+static constexpr int I2C_PINS[kfb::BUSES][2] = {{21, 22}, {32, 33}}; // SDA, SCL of Wire, Wire1
+static_assert(CHANNEL_COUNT <= kfb::MAX_CHANNELS, "station would reject this hub's channels");
 static constexpr uint8_t ESPNOW_CHANNEL = 1;
 static constexpr unsigned long BLINK_INTERVAL_MS = 100;
 
 const int BTN_PIN = 16;
 const unsigned long DEBOUNCE_MS = 40;
 
-// Timing
+// Timing (FINAL_CHECK values are the session defaults; MONITOR/CHECK may override them)
 static constexpr int FINAL_CHECK_SAMPLES = 5; // 5×50ms = 250ms
 static constexpr int SAMPLE_DELAY_MS = 50;
-static constexpr unsigned long CH_DEBOUNCE_MS = 25;
+// Switch debounce window per channel class (MONITOR NORMAL / LATCH)
+static constexpr unsigned long CH_DEBOUNCE_MS    = 25;
+static constexpr unsigned long LATCH_DEBOUNCE_MS = 25;
+static constexpr unsigned long DEBOUNCE_MIN_MS =
+    CH_DEBOUNCE_MS < LATCH_DEBOUNCE_MS ? CH_DEBOUNCE_MS : LATCH_DEBOUNCE_MS;
+static constexpr unsigned long DEBOUNCE_MAX_MS =
+    CH_DEBOUNCE_MS > LATCH_DEBOUNCE_MS ? CH_DEBOUNCE_MS : LATCH_DEBOUNCE_MS;
 
 // Tuning knobs
 static constexpr bool MAJORITY_OK = false; // set true → 3/5 majority pass
-static constexpr int PASS_THRESHOLD =
-    MAJORITY_OK ? (FINAL_CHECK_SAMPLES / 2 + 1) : FINAL_CHECK_SAMPLES;
-static_assert(SAMPLE_DELAY_MS >= CH_DEBOUNCE_MS,
-              "SAMPLE_DELAY_MS must be >= CH_DEBOUNCE_MS for stable voting");
+static_assert(SAMPLE_DELAY_MS >= DEBOUNCE_MAX_MS,
+              "SAMPLE_DELAY_MS must be >= the debounce windows for stable voting");
+static_assert(FINAL_CHECK_SAMPLES <= kfb::POLICY_MAX_SAMPLES, "FINAL_CHECK_SAMPLES exceeds the policy limit");
+
+// CHECK passes on the first sample when every channel the verdict depends on
+// has held its debounced state, without a raw toggle, for the span the
+// remaining samples would cover ((samples - 1) × spacing); otherwise sampling
+// runs until it has. Spans beyond the quiet counter (255 ms) always sample.
 
 // Optional pre-check settle. Set to 0 to disable.
 static constexpr unsigned long FINAL_CHECK_SETTLE_MS = 0;
 
-// IO mapping
-struct ChannelPins { uint8_t mcpIndex, ledPin, swPin; };
-static constexpr size_t EXPANDER_COUNT = sizeof(MCP_I2C_ADDR) / sizeof(MCP_I2C_ADDR[0]);
-static_assert(CHANNEL_COUNT * 2 <= EXPANDER_COUNT * 16, "Not enough MCP pins for CHANNEL_COUNT*2");
+// Tasks. The scanner samples switches, debounces and publishes a snapshot on
+// SCAN_TASK_CORE; protocol, LED policy and radio work run on PROTO_TASK_CORE,
+// so animations, FINAL_CHECK sampling or ACK retries never stall sampling.
+static constexpr uint32_t SCAN_RATE_HZ = 1000;   // poll mode fixed rate
+static constexpr BaseType_t SCAN_TASK_CORE  = 1;
+static constexpr BaseType_t PROTO_TASK_CORE = 0;
+static constexpr UBaseType_t SCAN_TASK_PRIO  = 5;
+static constexpr UBaseType_t PROTO_TASK_PRIO = 2;
+static constexpr UBaseType_t RX_QUEUE_LEN    = 8;  // received frames awaiting the protocol task
+static constexpr TickType_t SCAN_PERIOD_TICKS =
+    (configTICK_RATE_HZ / SCAN_RATE_HZ) ? (configTICK_RATE_HZ / SCAN_RATE_HZ) : 1;
+// Poll mode on a board with expanders on both buses: a worker task polls Wire1
+// while the scanner polls Wire, and the scanner merges the latest Wire1 sample
+// (at most one period old) into each scan. false → one scanner reads both buses.
+static constexpr bool PARALLEL_BUS_SCAN = true;
+
+// Switch capture. false → the scanner polls at SCAN_RATE_HZ. true → the
+// expanders raise interrupt-on-change (INTA/INTB mirrored, open-drain,
+// wired-OR onto SW_INT_PIN) and the scanner reads INTF/INTCAP/GPIO only when it fires.
+static constexpr bool SW_IRQ_MODE = false;
+static constexpr int SW_INT_PIN = 27;
+// Rescan without an interrupt at this period (guards against wiring glitches). 0 = bus idle.
+static constexpr unsigned long SW_IRQ_SAFETY_POLL_MS = 0;
+// Idle IRQ scanner re-runs the debounce from the last snapshot (no bus traffic)
+// at this period so the quiet counters behind the CHECK shortcut keep aging.
+static constexpr unsigned long SW_IRQ_QUIET_TICK_MS = 50;
+// INT still low after the bounded re-reads never produces another FALLING
+// edge: poll the expanders at this period until it releases.
+static constexpr unsigned long SW_IRQ_STUCK_POLL_MS = 10;
+// IRQ mode: a contactless press captured in INTCAP latches even if it was
+// released before the read (too short to survive LATCH_DEBOUNCE_MS).
+static constexpr bool LATCH_PULSE_CAPTURE = true;
+
+// I2C clock per bus, tuned at boot and while idle: start at I2C_BOOT_STEP and
+// step up I2C_CLOCKS while a probe (I2C_PROBE_READS config-register reads per
+// expander, compared against what initExpanders wrote) stays clean. In
+// service, I2C_FALLBACK_ERRORS faults within I2C_ERROR_WINDOW_MS step the bus
+// down one rate, and that rate is not tried again until reboot. The MCP23017
+// runs up to 1.7 MHz; the ESP32 I2C controller tops out at 1 MHz.
+static constexpr uint32_t I2C_CLOCKS[] = {100000, 400000, 700000, 1000000};
+static constexpr uint8_t I2C_CLOCK_STEPS = sizeof(I2C_CLOCKS) / sizeof(I2C_CLOCKS[0]);
+static constexpr uint8_t I2C_BOOT_STEP = 1;        // 400 kHz
+static constexpr int I2C_PROBE_READS = 8;
+static constexpr unsigned long I2C_RETUNE_MS = 60000; // idle: try the next rate up this often
+static constexpr uint32_t I2C_FALLBACK_ERRORS = 3;
+static constexpr unsigned long I2C_ERROR_WINDOW_MS = 1000;
+
+// Fixed-size channel set; session evaluation is word-wide boolean algebra
+// over these, so widening CHANNEL_COUNT past 64 only adds words.
+template <size_t N>
+struct BitSet {
+  static constexpr size_t WORDS = (N + 63) / 64;
+  static constexpr size_t BYTES = (N + 7) / 8;
+  static constexpr uint64_t TAIL = (N % 64) ? ((uint64_t(1) << (N % 64)) - 1) : ~uint64_t(0);
+  uint64_t w[WORDS] = {};
+
+  static BitSet all() { BitSet r; for (size_t i = 0; i < WORDS; ++i) r.w[i] = ~uint64_t(0); r.w[WORDS - 1] &= TAIL; return r; }
+  void clear() { for (size_t i = 0; i < WORDS; ++i) w[i] = 0; }
+  bool test(size_t b) const { return (w[b >> 6] >> (b & 63)) & 1u; }
+  void set(size_t b, bool v = true) {
+    const uint64_t m = uint64_t(1) << (b & 63);
+    if (v) w[b >> 6] |= m; else w[b >> 6] &= ~m;
+  }
+  void reset(size_t b) { set(b, false); }
+  bool any() const { uint64_t a = 0; for (size_t i = 0; i < WORDS; ++i) a |= w[i]; return a != 0; }
+  bool none() const { return !any(); }
+  int count() const { int c = 0; for (size_t i = 0; i < WORDS; ++i) c += __builtin_popcountll(w[i]); return c; }
+
+  BitSet operator~() const { BitSet r; for (size_t i = 0; i < WORDS; ++i) r.w[i] = ~w[i]; r.w[WORDS - 1] &= TAIL; return r; }
+  BitSet operator&(const BitSet &o) const { BitSet r; for (size_t i = 0; i < WORDS; ++i) r.w[i] = w[i] & o.w[i]; return r; }
+  BitSet operator|(const BitSet &o) const { BitSet r; for (size_t i = 0; i < WORDS; ++i) r.w[i] = w[i] | o.w[i]; return r; }
+  BitSet operator^(const BitSet &o) const { BitSet r; for (size_t i = 0; i < WORDS; ++i) r.w[i] = w[i] ^ o.w[i]; return r; }
+  BitSet &operator&=(const BitSet &o) { for (size_t i = 0; i < WORDS; ++i) w[i] &= o.w[i]; return *this; }
+  BitSet &operator|=(const BitSet &o) { for (size_t i = 0; i < WORDS; ++i) w[i] |= o.w[i]; return *this; }
+  bool operator==(const BitSet &o) const { for (size_t i = 0; i < WORDS; ++i) if (w[i] != o.w[i]) return false; return true; }
+  bool operator!=(const BitSet &o) const { return !(*this == o); }
+
+  // Little-endian packing, bit i of the result = bit i of the set
+  void toBytes(uint8_t *out) const {
+    for (size_t i = 0; i < BYTES; ++i) out[i] = uint8_t(w[i >> 3] >> ((i & 7) * 8));
+  }
+
+  // Visit set bits in ascending order
+  template <class F> void forEach(F f) const {
+    for (size_t i = 0; i < WORDS; ++i)
+      for (uint64_t v = w[i]; v; v &= v - 1) f(int(i * 64 + __builtin_ctzll(v)));
+  }
+};
+using ChannelSet = BitSet<CHANNEL_COUNT>;
+
+// (dst & ~mask) | (src & mask)
+static inline ChannelSet mergeMasked(const ChannelSet &dst, const ChannelSet &src, const ChannelSet &mask) {
+  return (dst & ~mask) | (src & mask);
+}
+
+// One saturating BITS-wide counter per channel, stored as bit planes (bit b of
+// every channel's count lives in plane[b]) so all channels advance and compare
+// in a few word-wide operations per 64 channels, whatever the channel count.
+template <int BITS>
+struct VerticalCounter {
+  static constexpr uint32_t MAX = (1u << BITS) - 1;
+  ChannelSet plane[BITS];
+
+  void clear(const ChannelSet &mask) { for (auto &p : plane) p &= ~mask; }
+
+  // count = run ? min(count + k, MAX) : 0
+  void advance(const ChannelSet &run, uint32_t k) {
+    if (k > MAX) k = MAX;
+    for (size_t i = 0; i < ChannelSet::WORDS; ++i) {
+      const uint64_t r = run.w[i];
+      uint64_t carry = 0;
+      for (int b = 0; b < BITS; ++b) {
+        const uint64_t c = plane[b].w[i] & r, kb = ((k >> b) & 1u) ? r : 0;
+        plane[b].w[i] = c ^ kb ^ carry;
+        carry = (c & kb) | (carry & (c ^ kb));
+      }
+      for (int b = 0; b < BITS; ++b) plane[b].w[i] |= carry;
+    }
+  }
+
+  // Channels whose count is >= n, most significant plane first
+  ChannelSet atLeast(uint32_t n) const {
+    ChannelSet out;
+    for (size_t i = 0; i < ChannelSet::WORDS; ++i) {
+      uint64_t gt = 0, eq = ~uint64_t(0);
+      for (int b = BITS - 1; b >= 0; --b) {
+        const uint64_t c = plane[b].w[i];
+        if ((n >> b) & 1u) eq &= c;
+        else { gt |= eq & c; eq &= ~c; }
+      }
+      out.w[i] = (gt | eq) & (i == ChannelSet::WORDS - 1 ? ChannelSet::TAIL : ~uint64_t(0));
+    }
+    return out;
+  }
+
+  uint32_t count(int ch) const {
+    uint32_t v = 0;
+    for (int b = 0; b < BITS; ++b) v |= uint32_t(plane[b].test(ch)) << b;
+    return v;
+  }
+};
+
+// IO mapping, generated from BOARD at compile time
+using kfb::ChannelPins;
+static constexpr size_t EXPANDER_COUNT = BOARD.expanderCount;
+static_assert(kfb::layoutValid(BOARD), "bad board layout");
 static_assert(ESPNOW_CHANNEL >= 1 && ESPNOW_CHANNEL <= 13, "Bad ESPNOW channel");
+static constexpr kfb::PinMap<CHANNEL_COUNT> pinsMap = kfb::makePinMap<CHANNEL_COUNT>(BOARD);
 Adafruit_MCP23X17 mcp[EXPANDER_COUNT];
-ChannelPins pinsMap[CHANNEL_COUNT];
-// Guard MCP/Wire calls across tasks/cores
-static SemaphoreHandle_t i2cMutex = nullptr;
-static inline void i2cLock()   { if (i2cMutex) xSemaphoreTake(i2cMutex, portMAX_DELAY); }
-static inline void i2cUnlock() { if (i2cMutex) xSemaphoreGive(i2cMutex); }
+static inline TwoWire &expanderWire(size_t i) { return BOARD.expanders[i].bus ? Wire1 : Wire; }
+static constexpr bool SPLIT_BUS_SCAN = PARALLEL_BUS_SCAN && !SW_IRQ_MODE &&
+                                       kfb::layoutUsesBus(BOARD, 0) && kfb::layoutUsesBus(BOARD, 1);
+
+// Bus ownership. Until startScanTask() setup() drives the buses directly;
+// after it every bus has one owner task that alone touches its Wire: the
+// scanner, or with SPLIT_BUS_SCAN the Wire1 worker for Wire1. Other tasks
+// post I2cCmds to the owner's ring and read switches from the published
+// snapshot, so no bus access takes a lock.
+static bool busOwnersRunning = false;
+static inline bool scannerOwnsBus(int bus) { return !(SPLIT_BUS_SCAN && bus == 1); }
+
+// I2C health. Fault counters are per expander and read by STATS from the
+// ESP-NOW callback; the clock state of a bus is only changed by its owner.
+enum class I2cFault : uint8_t { NONE, NACK, TIMEOUT, MISMATCH };
+struct ExpanderFaults {
+  std::atomic<uint32_t> nack{0}, timeout{0}, mismatch{0};
+};
+struct BusClock {
+  std::atomic<uint8_t> step{0};
+  uint8_t ceiling = I2C_CLOCK_STEPS - 1;  // highest step still allowed
+  std::atomic<uint32_t> fallbacks{0};
+  uint32_t windowFaults = 0;
+  unsigned long windowAt = 0;
+};
+static ExpanderFaults i2cFaults[EXPANDER_COUNT];
+static BusClock busClock[kfb::BUSES];
+static uint16_t expectIodir[EXPANDER_COUNT], expectGppu[EXPANDER_COUNT];  // as set by initExpanders
+
+// Owner command ring per bus. The protocol task is the only producer and the
+// owner the only consumer, so, like the station's RX log ring, the producer
+// owns i2cHead and the consumer i2cTail. A full ring leaves the LEDs dirty
+// for the next flushLeds() and is counted.
+static constexpr uint32_t I2C_CMD_SLOTS = 8;  // power of two
+static_assert((I2C_CMD_SLOTS & (I2C_CMD_SLOTS - 1)) == 0, "I2C_CMD_SLOTS must be a power of two");
+enum class I2cOp : uint8_t {
+  LED_WRITE,  // write olat[] to the expanders in `mask`, read back OLAT
+  RETUNE,     // try the next clock step up (idle only)
+};
+struct I2cCmd {
+  I2cOp op;
+  uint32_t mask;                  // LED_WRITE: expanders of this bus
+  uint16_t olat[EXPANDER_COUNT];  // LED_WRITE: indexed like BOARD.expanders
+  uint32_t postedUs;              // micros() at post, for led-write
+};
+static I2cCmd i2cRing[kfb::BUSES][I2C_CMD_SLOTS];
+static std::atomic<uint32_t> i2cHead[kfb::BUSES], i2cTail[kfb::BUSES];
+static std::atomic<uint32_t> i2cRingFull[kfb::BUSES];
+
+// Scanner state: one GPIOAB burst per expander per scan, decoded via pinsMap,
+// debounced and published. Only the scanner (and, with SPLIT_BUS_SCAN, the
+// Wire1 worker) reads the switches.
+struct ScanSnapshot {
+  ChannelSet raw;       // last sample (pressed = 1)
+  ChannelSet stable;    // debounced
+  uint32_t tick;        // scanner iterations
+  unsigned long at;     // millis() of the sample
+};
+static uint16_t portRaw[EXPANDER_COUNT];
+static uint16_t busPorts[EXPANDER_COUNT];  // latest good sample per expander, any bus
+static std::atomic<uint32_t> busPortsSeq[kfb::BUSES];  // odd = owner writing
+static ChannelSet scanRaw, scanStable;
+static ChannelSet scanEdges;        // sticky press edges (+ IRQ pulses) until the protocol takes them
+// Per channel: ms its raw state has differed from the stable one (debounce),
+// and ms it has matched it without a raw toggle (quiet, the CHECK shortcut)
+static VerticalCounter<6> debounce;
+static VerticalCounter<8> quiet;
+static ChannelSet debounceLatch;    // channels debounced with LATCH_DEBOUNCE_MS
+static_assert(CH_DEBOUNCE_MS <= decltype(debounce)::MAX && LATCH_DEBOUNCE_MS <= decltype(debounce)::MAX,
+              "debounce windows must fit the debounce counter");
+static unsigned long scanAtMs;      // millis() of the previous scanStep()
+static portMUX_TYPE scanMux = portMUX_INITIALIZER_UNLOCKED; // serializes snapshot writers
+static ScanSnapshot scanSnap;                               // seqlock: odd scanSeq = write in progress
+static std::atomic<uint32_t> scanSeq{0};
+static TaskHandle_t scanTaskHandle = nullptr;
+static TaskHandle_t busScanTaskHandle = nullptr;
+static TaskHandle_t protoTaskHandle = nullptr;
+
+// Protocol-side copy of the latest sample; readSwRaw()/isPressedRaw() read this
+static ChannelSet swPressed;
+
+// LED output shadow: setLed() edits olatShadow and marks the expander dirty;
+// flushLeds() writes each dirty expander once with a 16-bit GPIOAB write.
+static uint16_t olatShadow[EXPANDER_COUNT];
+static uint32_t olatDirty = 0; // bit per expander
+static portMUX_TYPE ledMux = portMUX_INITIALIZER_UNLOCKED;
+static_assert(EXPANDER_COUNT <= 32, "olatDirty holds one bit per expander");
+static constexpr uint32_t ALL_EXPANDERS = ~0u >> (32 - EXPANDER_COUNT);
+
+// BLINK/CHASE play as one step per protocolLoop pass, so frames keep being
+// handled meanwhile. While one runs, flushLeds() writes animOlat instead of
+// olatShadow; when it ends the state's own LED picture is written back.
+static constexpr int BLINK_MAX_TIMES  = 20;  // 120 ms on + 120 ms off each
+static constexpr int CHASE_MAX_ROUNDS = 3;   // ~41 ms per channel per round
+enum class Anim : uint8_t { NONE, BLINK, CHASE };
+static Anim anim = Anim::NONE;     // protocol task only
+static int animLeft = 0;           // blinks / rounds still to play
+static int animCh = 0;             // CHASE: channel in this step
+static bool animOn = false;        // current half of the step
+static unsigned long animAt = 0;   // millis() of the next step
+static uint16_t animOlat[EXPANDER_COUNT];
+static uint32_t animDirty = 0;
 
 // State
 enum class State { SELF_CHECK, WAIT_FOR_TARGET, MONITORING, FINAL_CHECK, WELCOME };
 static volatile State state = State::SELF_CHECK;
 
 // Model
-static bool monNormal[CHANNEL_COUNT];
-static bool monLatch[CHANNEL_COUNT];
-static bool latched[CHANNEL_COUNT];
-static bool ignoredCh[CHANNEL_COUNT];
+static ChannelSet monNormal;
+static ChannelSet monLatch;
+static ChannelSet latched;
+static ChannelSet ignoredCh;
 static unsigned long liveOkSince = 0;
 static constexpr unsigned long AUTO_FINAL_HOLD_MS = 200; // hold time before auto-final
 
-// Debounce
-static bool lastPressed[CHANNEL_COUNT];
-static bool rawPrev[CHANNEL_COUNT];
-static unsigned long rawChangedAt[CHANNEL_COUNT];
+// FINAL_CHECK policy of the current session (kfb::takePolicy tokens)
+static constexpr kfb::CheckPolicy DEFAULT_POLICY = {
+    FINAL_CHECK_SAMPLES, SAMPLE_DELAY_MS, MAJORITY_OK ? kfb::PASS_MAJORITY : kfb::PASS_ALL,
+    FINAL_CHECK_SETTLE_MS, AUTO_FINAL_HOLD_MS};
+static kfb::CheckPolicy policy = DEFAULT_POLICY;
+static_assert(kfb::policyCheckMs(DEFAULT_POLICY) <= kfb::POLICY_MAX_CHECK_MS, "default FINAL_CHECK policy exceeds the cap");
+
+// Debounced state as last consumed by the protocol task
+static ChannelSet lastPressed;
 
 // Streaming telemetry
 static bool streamActive = false;
-static bool prevPressed[CHANNEL_COUNT];
-static bool prevLatchedState[CHANNEL_COUNT];
+static ChannelSet prevPressed;
+static ChannelSet prevLatchedState;
 
 static constexpr unsigned long MIN_EVENT_GAP_MS = 10; // small throttle to avoid floods
 
@@ -113,17 +380,15 @@ static unsigned long lastDebounce = 0;
 static unsigned long lastBlinkTick = 0;
 static bool blinkState = false;
 
-// FAILURE buffers
-static char missingBuf[MAX_MSG_LEN];
-static char extraBuf[MAX_MSG_LEN];
-static size_t missingLen = 0, extraLen = 0;
+// FAILURE content of the last checkAll(); RESULT encodes it at send time
+static ChannelSet lastMissing, lastExtra;
 static inline bool hasWorkToCheck(bool restrictToSelection);
 // helper
 // (removed unused allNormalsHeldNow)
 
 
 // CHECK selection
-static bool checkSelect[CHANNEL_COUNT];
+static ChannelSet checkSelect;
 static bool checkActive = false;
 
 // WELCOME
@@ -136,58 +401,553 @@ static char BOARD_MAC[18] = {0};
 static void goDarkAndIdle();  // add
 // ==== Fwd decls ====
 static inline void setLed(int ch, bool on);
+static void setLeds(const ChannelSet &on);
 static inline bool readSwRaw(int ch);
 static inline bool isPressedRaw(int ch);
-static void buildPins();
+static void scanInputs();
+static void refreshInputs();
+static void flushLeds();
+static bool initExpanders();
 static bool ensurePeer(const uint8_t *addr);
 static bool sendCmd(const char *msg, const uint8_t *dest = nullptr);
 static bool sendCmdRaw(const char *msg, const uint8_t *dest = nullptr);
+static bool sendFrame(uint8_t *frame, size_t len, const uint8_t *dest, bool reliable, uint32_t originUs = 0);
+static esp_err_t espNowSend(const uint8_t *mac, const uint8_t *data, size_t len, uint32_t originUs = 0);
+static void sendEventBatch(const ChannelSet &pChanged, const ChannelSet &pVal,
+                           const ChannelSet &lChanged, const ChannelSet &lVal,
+                           bool snapshot, const uint8_t *dest, uint32_t originUs = 0);
+static void sendStats(const uint8_t *dest);
+static bool sendReply(uint8_t code, const uint8_t *dest, bool reliable);
+static void sendResult(bool ok);
 static void serviceAckTx();
 static bool extractIdToken(const char* msg, int len, uint32_t &outId);
 static void triggerHello();
 static void allLeds(bool on);
-static void appendCsv(char *buf, size_t &len, int oneBased);
-static void resetBuffers();
-static inline void trimBuffers();
-static bool checkAll(bool restrictToSelection, unsigned long now);
+static bool checkAll(bool restrictToSelection);
 static void parseMonitorPayload(const char *data, int len);
 static void parseCheckSelection(const char *payload, int len);
 static void doSelfCheck();
 static void doMonitoring();
 static void doFinalCheck();
 static void onRecv(const esp_now_recv_info_t *info, const uint8_t *data, int len);
+struct RxItem;
+static void handleFrame(const RxItem &item);
 static void cleanAll();
+static void protocolTask(void *);
 
-// Pending work (offloaded from RX callback)
-struct PendingCmd {
-  enum Kind { None, Blink, Chase, MonitorBaseline } kind;
-  int n;
-  bool hasMac;
+// Received frames, handed from the ESP-NOW callback to the protocol task in order
+struct RxItem {
   uint8_t mac[6];
+  uint8_t len;
+  char data[kfb::MAX_FRAME + 1]; // NUL-terminated copy
 };
-static volatile bool havePending = false;
-static PendingCmd pending = {PendingCmd::None, 0, false, {0}};
-static portMUX_TYPE pendingMux = portMUX_INITIALIZER_UNLOCKED;
+static QueueHandle_t rxQueue = nullptr;
+static std::atomic<uint32_t> rxDropped{0};
+
+// ==== Latency ====
+// micros() stamps (esp_timer, shared by both cores) along the event path:
+// raw edge → settled → picked up by the protocol task → esp_now_send returned
+// → onSent, plus the reliable-frame round trip and LED batches from post to
+// written by their bus owner. STATS dumps p50/p99/max.
+enum LatStage { LAT_DEBOUNCE, LAT_PICKUP, LAT_EV_SEND, LAT_TX_DONE, LAT_EDGE_TO_AIR, LAT_ACK, LAT_LED_WRITE, LAT_COUNT };
+static const char *const LAT_NAMES[LAT_COUNT] = {"debounce", "pickup", "ev-send", "tx-done", "edge-to-air", "ack",
+                                                 "led-write"};
+static kfb::LatencyHist latency[LAT_COUNT];
+
+// Scanner side, under scanMux: the oldest stable change the protocol task has
+// not picked up yet (changes that pile up before the pickup share its stamps)
+static uint32_t changeRawUs = 0, changeSettledUs = 0;
+static bool changePending = false;
+// Protocol side: origin of the change being streamed and when it was picked up
+static uint32_t pickupOriginUs = 0, pickupUs = 0;
+
+// esp_now_send() calls awaiting onSent, oldest first. Entries are stamped
+// before the call (the callback may beat the return) and voided if it fails.
+struct TxStamp { uint32_t seq, sentUs, originUs; bool dead; };
+static constexpr int TX_STAMPS = 16;
+static TxStamp txStamps[TX_STAMPS];
+static int txStampHead = 0, txStampCount = 0;
+static uint32_t txStampSeq = 0;
+static portMUX_TYPE txStampMux = portMUX_INITIALIZER_UNLOCKED;
+
+// ==== I2C access and health ====
+// MCP23017 registers (IOCON.BANK = 0)
+static constexpr uint8_t MCP_REG_IODIRA = 0x00;
+static constexpr uint8_t MCP_REG_GPPUA  = 0x0C;
+static constexpr uint8_t MCP_REG_GPIOA  = 0x12;
+static constexpr uint8_t MCP_REG_OLATA  = 0x14;
+
+// Sequential register read; the caller holds the bus lock
+static I2cFault mcpRead(size_t idx, uint8_t reg, uint8_t *buf, uint8_t n) {
+  TwoWire &w = expanderWire(idx);
+  const uint8_t addr = BOARD.expanders[idx].addr;
+  w.beginTransmission(addr);
+  w.write(reg);
+  const uint8_t rc = w.endTransmission(false);
+  if (rc == 2 || rc == 3) return I2cFault::NACK;
+  if (rc != 0) return I2cFault::TIMEOUT;
+  // requestFrom() does not say why it came up short; counted as a timeout
+  if (w.requestFrom(addr, n) != n) return I2cFault::TIMEOUT;
+  for (uint8_t i = 0; i < n; ++i) buf[i] = uint8_t(w.read());
+  return I2cFault::NONE;
+}
+
+static I2cFault mcpRead16(size_t idx, uint8_t reg, uint16_t &v) {
+  uint8_t b[2];
+  const I2cFault f = mcpRead(idx, reg, b, 2);
+  if (f == I2cFault::NONE) v = uint16_t(b[0] | (b[1] << 8));
+  return f;
+}
+
+static I2cFault mcpWrite16(size_t idx, uint8_t reg, uint16_t v) {
+  TwoWire &w = expanderWire(idx);
+  w.beginTransmission(BOARD.expanders[idx].addr);
+  w.write(reg);
+  w.write(uint8_t(v));
+  w.write(uint8_t(v >> 8));
+  const uint8_t rc = w.endTransmission();
+  return rc == 0 ? I2cFault::NONE : (rc == 2 || rc == 3) ? I2cFault::NACK : I2cFault::TIMEOUT;
+}
+
+static void setBusStep(int bus, uint8_t step) {
+  busClock[bus].step.store(step, std::memory_order_relaxed);
+  (bus ? Wire1 : Wire).setClock(I2C_CLOCKS[step]);
+}
+
+// Count an in-service fault; enough of them in one window step the bus down.
+// Caller holds the bus lock. Returns f so callers can test it inline.
+static I2cFault i2cFault(size_t idx, I2cFault f) {
+  if (f == I2cFault::NONE) return f;
+  ExpanderFaults &c = i2cFaults[idx];
+  (f == I2cFault::NACK ? c.nack : f == I2cFault::TIMEOUT ? c.timeout : c.mismatch)
+      .fetch_add(1, std::memory_order_relaxed);
+  const int bus = BOARD.expanders[idx].bus;
+  BusClock &b = busClock[bus];
+  const unsigned long now = millis();
+  if (now - b.windowAt > I2C_ERROR_WINDOW_MS) { b.windowAt = now; b.windowFaults = 0; }
+  const uint8_t step = b.step.load(std::memory_order_relaxed);
+  if (++b.windowFaults >= I2C_FALLBACK_ERRORS && step > 0) {
+    b.ceiling = uint8_t(step - 1);
+    b.windowFaults = 0;
+    b.fallbacks.fetch_add(1, std::memory_order_relaxed);
+    setBusStep(bus, b.ceiling);
+  }
+  return f;
+}
+
+// I2C_PROBE_READS reads of IODIR and GPPU on every expander of `bus` at its
+// current clock; true when all of them ACKed and matched. Caller holds the lock.
+static bool probeBus(int bus) {
+  for (int r = 0; r < I2C_PROBE_READS; ++r) {
+    for (size_t i = 0; i < EXPANDER_COUNT; ++i) {
+      if (BOARD.expanders[i].bus != bus) continue;
+      uint16_t iodir = 0, gppu = 0;
+      if (mcpRead16(i, MCP_REG_IODIRA, iodir) != I2cFault::NONE || iodir != expectIodir[i]) return false;
+      if (mcpRead16(i, MCP_REG_GPPUA, gppu) != I2cFault::NONE || gppu != expectGppu[i]) return false;
+    }
+  }
+  return true;
+}
+
+// Boot: find the fastest clean rate, stepping down from I2C_BOOT_STEP if even
+// that fails. False when no rate probes clean (the bus is left at the slowest).
+static bool tuneBusAtBoot(int bus) {
+  uint8_t step = I2C_BOOT_STEP;
+  setBusStep(bus, step);
+  while (!probeBus(bus)) {
+    if (step == 0) return false;
+    setBusStep(bus, --step);
+  }
+  while (step + 1 <= busClock[bus].ceiling) {
+    setBusStep(bus, uint8_t(step + 1));
+    if (!probeBus(bus)) { setBusStep(bus, step); break; }
+    ++step;
+  }
+  return true;
+}
+
+// RETUNE: one rate up if below the ceiling, kept only if it probes clean
+static void retuneBus(int bus) {
+  const uint8_t step = busClock[bus].step.load(std::memory_order_relaxed);
+  if (step >= busClock[bus].ceiling) return;
+  setBusStep(bus, uint8_t(step + 1));
+  if (!probeBus(bus)) setBusStep(bus, step);
+}
+
+// Write and verify one batch of LED ports; failures stay dirty for the next flush
+static void writeLedBatch(uint32_t mask, const uint16_t olat[EXPANDER_COUNT], uint32_t postedUs) {
+  uint32_t failed = 0;
+  for (size_t i = 0; i < EXPANDER_COUNT; ++i) {
+    if (!(mask & (1u << i))) continue;
+    uint16_t back = 0;
+    I2cFault f = mcpWrite16(i, MCP_REG_GPIOA, olat[i]);
+    if (f == I2cFault::NONE) f = mcpRead16(i, MCP_REG_OLATA, back);
+    if (f == I2cFault::NONE && back != olat[i]) f = I2cFault::MISMATCH;
+    if (i2cFault(i, f) != I2cFault::NONE) failed |= 1u << i;
+  }
+  if (failed) {
+    portENTER_CRITICAL(&ledMux);
+    olatDirty |= failed;
+    portEXIT_CRITICAL(&ledMux);
+  }
+  if (postedUs) latency[LAT_LED_WRITE].record(micros() - postedUs);
+}
+
+// Producer side (protocol task); false when the ring is full
+static bool postI2cCmd(int bus, const I2cCmd &cmd) {
+  const uint32_t head = i2cHead[bus].load(std::memory_order_relaxed);
+  if (head - i2cTail[bus].load(std::memory_order_acquire) >= I2C_CMD_SLOTS) {
+    i2cRingFull[bus].fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  i2cRing[bus][head & (I2C_CMD_SLOTS - 1)] = cmd;
+  i2cHead[bus].store(head + 1, std::memory_order_release);
+  if (SW_IRQ_MODE && scanTaskHandle) xTaskNotifyGive(scanTaskHandle);  // it sleeps until INT otherwise
+  return true;
+}
+
+// Owner side: run everything queued for `bus`, in order
+static void serviceBusCommands(int bus) {
+  uint32_t tail = i2cTail[bus].load(std::memory_order_relaxed);
+  while (tail != i2cHead[bus].load(std::memory_order_acquire)) {
+    const I2cCmd &cmd = i2cRing[bus][tail & (I2C_CMD_SLOTS - 1)];
+    if (cmd.op == I2cOp::LED_WRITE) writeLedBatch(cmd.mask, cmd.olat, cmd.postedUs);
+    else retuneBus(bus);
+    i2cTail[bus].store(++tail, std::memory_order_release);
+  }
+}
+
+// Idle: every I2C_RETUNE_MS, ask each bus owner to try one rate up
+static void retuneI2cIdle() {
+  static unsigned long lastRetune = 0;
+  const unsigned long now = millis();
+  if (now - lastRetune < I2C_RETUNE_MS) return;
+  lastRetune = now;
+  I2cCmd cmd{};
+  cmd.op = I2cOp::RETUNE;
+  for (int bus = 0; bus < kfb::BUSES; ++bus)
+    if (kfb::layoutUsesBus(BOARD, bus)) postI2cCmd(bus, cmd);
+}
 
 // ==== Helpers ====
 static inline void setLed(int ch, bool on) {
-  static bool ledState[CHANNEL_COUNT];
-  if (ledState[ch] == on) return;
-  ledState[ch] = on;
-  auto &p = pinsMap[ch];
-  i2cLock();
-  mcp[p.mcpIndex].digitalWrite(p.ledPin, on ? HIGH : LOW);
-  i2cUnlock();
+  const auto &p = pinsMap[ch];
+  const uint16_t bit = uint16_t(1u << p.ledPin);
+  portENTER_CRITICAL(&ledMux);
+  uint16_t &o = olatShadow[p.mcpIndex];
+  const uint16_t next = on ? uint16_t(o | bit) : uint16_t(o & ~bit);
+  if (next != o) { o = next; olatDirty |= 1u << p.mcpIndex; }
+  portEXIT_CRITICAL(&ledMux);
+}
+
+// Drive every channel's LED from one set under a single shadow update
+static void setLeds(const ChannelSet &on) {
+  uint16_t next[EXPANDER_COUNT];
+  portENTER_CRITICAL(&ledMux);
+  memcpy(next, olatShadow, sizeof(next));
+  for (int ch = 0; ch < CHANNEL_COUNT; ++ch) {
+    const auto &p = pinsMap[ch];
+    const uint16_t bit = uint16_t(1u << p.ledPin);
+    next[p.mcpIndex] = on.test(ch) ? uint16_t(next[p.mcpIndex] | bit) : uint16_t(next[p.mcpIndex] & ~bit);
+  }
+  for (size_t i = 0; i < EXPANDER_COUNT; ++i)
+    if (next[i] != olatShadow[i]) { olatShadow[i] = next[i]; olatDirty |= 1u << i; }
+  portEXIT_CRITICAL(&ledMux);
+}
+
+static void flushLeds() {
+  uint16_t out[EXPANDER_COUNT];
+  uint32_t dirty;
+  if (anim != Anim::NONE) {
+    // A failed post lands in olatDirty; the end of the animation rewrites all
+    if (!animDirty) return;
+    dirty = animDirty; animDirty = 0;
+    memcpy(out, animOlat, sizeof(out));
+  } else {
+    if (!olatDirty) return;
+    portENTER_CRITICAL(&ledMux);
+    dirty = olatDirty; olatDirty = 0;
+    memcpy(out, olatShadow, sizeof(out));
+    portEXIT_CRITICAL(&ledMux);
+  }
+  if (!busOwnersRunning) { writeLedBatch(dirty, out, 0); return; }
+  // One batched LED_WRITE per bus; the owner runs it before its next sample
+  I2cCmd cmd;
+  cmd.op = I2cOp::LED_WRITE;
+  memcpy(cmd.olat, out, sizeof(cmd.olat));
+  cmd.postedUs = micros();
+  for (int bus = 0; bus < kfb::BUSES; ++bus) {
+    cmd.mask = 0;
+    for (size_t i = 0; i < EXPANDER_COUNT; ++i)
+      if (BOARD.expanders[i].bus == bus) cmd.mask |= dirty & (1u << i);
+    if (cmd.mask && !postI2cCmd(bus, cmd)) {
+      portENTER_CRITICAL(&ledMux);
+      olatDirty |= cmd.mask;
+      portEXIT_CRITICAL(&ledMux);
+    }
+  }
+}
+
+// Channels whose switch bit is set in `ports`
+static ChannelSet decodeSwBits(const uint16_t ports[EXPANDER_COUNT]) {
+  ChannelSet out;
+  for (int ch = 0; ch < CHANNEL_COUNT; ++ch) {
+    const auto &p = pinsMap[ch];
+    if ((ports[p.mcpIndex] >> p.swPin) & 1u) out.set(ch);
+  }
+  return out;
+}
+
+// Seqlock publish; caller holds scanMux so writers never interleave
+static void publishSnapshot(unsigned long now) {
+  scanSeq.fetch_add(1, std::memory_order_acq_rel);
+  scanSnap.raw = scanRaw;
+  scanSnap.stable = scanStable;
+  scanSnap.tick++;
+  scanSnap.at = now;
+  scanSeq.fetch_add(1, std::memory_order_release);
+}
+
+static ScanSnapshot readSnapshot() {
+  ScanSnapshot out;
+  uint32_t a, b;
+  do {
+    a = scanSeq.load(std::memory_order_acquire);
+    out = scanSnap;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    b = scanSeq.load(std::memory_order_relaxed);
+  } while ((a & 1u) || a != b);
+  return out;
+}
+
+// One scanner tick: advance the debounce counters by the time since the last
+// tick, flip channels whose raw state outlived their class window, accumulate
+// press edges and publish.
+struct ScanResult { bool stableChanged, settling; };
+static ScanResult scanStep(const ChannelSet &raw, const ChannelSet &pulse, unsigned long now) {
+  const uint32_t us = micros();
+  portENTER_CRITICAL(&scanMux);
+  const ChannelSet diff = raw ^ scanStable, held = ~(raw ^ scanRaw);
+  const uint32_t elapsed = uint32_t(now - scanAtMs);
+  debounce.advance(diff & held, elapsed);   // a departure restarts at 0
+  quiet.advance(~diff & held, elapsed);
+  const ChannelSet settled = diff & (CH_DEBOUNCE_MS == LATCH_DEBOUNCE_MS
+      ? debounce.atLeast(CH_DEBOUNCE_MS)
+      : mergeMasked(debounce.atLeast(CH_DEBOUNCE_MS), debounce.atLeast(LATCH_DEBOUNCE_MS), debounceLatch));
+  scanAtMs = now;
+  scanRaw = raw;
+  scanStable = scanStable ^ settled;
+  scanEdges |= (settled & raw) | pulse;   // rising edge = press
+  publishSnapshot(now);
+  const bool settling = (raw ^ scanStable).any();
+  uint32_t oldestMs = 0;  // longest debounce among the settled channels
+  settled.forEach([&](int ch) {
+    const uint32_t d = debounce.count(ch);
+    latency[LAT_DEBOUNCE].record(d * 1000u);
+    if (d > oldestMs) oldestMs = d;
+  });
+  if ((settled.any() || pulse.any()) && !changePending) {
+    changeRawUs = us - oldestMs * 1000u;  // IRQ pulses alone skip the debounce
+    changeSettledUs = us;
+    changePending = true;
+  }
+  portEXIT_CRITICAL(&scanMux);
+  return {settled.any() || pulse.any(), settling};
+}
+
+// GPIOAB of every expander on `bus` into ports[] (indexed like BOARD.expanders)
+// A failed read keeps the expander's last published sample.
+static void readBusPorts(int bus, uint16_t ports[EXPANDER_COUNT]) {
+  for (size_t i = 0; i < EXPANDER_COUNT; ++i) {
+    if (BOARD.expanders[i].bus != bus) continue;
+    if (i2cFault(i, mcpRead16(i, MCP_REG_GPIOA, ports[i])) != I2cFault::NONE) ports[i] = busPorts[i];
+  }
+}
+
+// Publish a bus's slice of ports[] for the scanner to merge (seqlock per bus,
+// written only by that bus's owner)
+static void storeBusPorts(int bus, const uint16_t ports[EXPANDER_COUNT]) {
+  busPortsSeq[bus].fetch_add(1, std::memory_order_acq_rel);
+  for (size_t i = 0; i < EXPANDER_COUNT; ++i)
+    if (BOARD.expanders[i].bus == bus) busPorts[i] = ports[i];
+  busPortsSeq[bus].fetch_add(1, std::memory_order_release);
+}
+
+static ChannelSet decodePorts(const uint16_t ports[EXPANDER_COUNT]) {
+  memcpy(portRaw, ports, sizeof(portRaw));
+  return ~decodeSwBits(ports); // pull-up: low = pressed
+}
+
+// Every bus, one after the other
+static ChannelSet readPorts() {
+  uint16_t ports[EXPANDER_COUNT];
+  for (int bus = 0; bus < kfb::BUSES; ++bus) {
+    if (!kfb::layoutUsesBus(BOARD, bus)) continue;
+    readBusPorts(bus, ports);
+    storeBusPorts(bus, ports);
+  }
+  return decodePorts(ports);
+}
+
+// SPLIT_BUS_SCAN: read Wire here, take Wire1 from its worker's last sample
+static ChannelSet readPortsMerged() {
+  uint16_t ports[EXPANDER_COUNT];
+  readBusPorts(0, ports);
+  storeBusPorts(0, ports);
+  uint32_t a, b;
+  do {
+    a = busPortsSeq[1].load(std::memory_order_acquire);
+    for (size_t i = 0; i < EXPANDER_COUNT; ++i)
+      if (BOARD.expanders[i].bus == 1) ports[i] = busPorts[i];
+    std::atomic_thread_fence(std::memory_order_acquire);
+    b = busPortsSeq[1].load(std::memory_order_relaxed);
+  } while ((a & 1u) || a != b);
+  return decodePorts(ports);
 }
 
-static inline bool readSwRaw(int ch) {
-  auto &p = pinsMap[ch];
-  i2cLock();
-  int v = mcp[p.mcpIndex].digitalRead(p.swPin);
-  i2cUnlock();
-  return v == HIGH; // pull-up
+// SPLIT_BUS_SCAN worker and owner of one bus: runs its commands and polls it
+// at SCAN_RATE_HZ, independent of the scanner, so neither bus's transfers (or
+// LED writes) hold up the other
+static void busScanTask(void *arg) {
+  const int bus = int(intptr_t(arg));
+  uint16_t ports[EXPANDER_COUNT];
+  TickType_t wake = xTaskGetTickCount();
+  for (;;) {
+    vTaskDelayUntil(&wake, SCAN_PERIOD_TICKS);
+    serviceBusCommands(bus);
+    readBusPorts(bus, ports);
+    storeBusPorts(bus, ports);
+  }
 }
-static inline bool isPressedRaw(int ch) { return !readSwRaw(ch); }
+
+// Boot-time sample: adopt the current state as stable (no phantom edges)
+static void scanInputs() {
+  const ChannelSet raw = readPorts();
+  const unsigned long now = millis();
+  portENTER_CRITICAL(&scanMux);
+  scanRaw = scanStable = raw;
+  scanEdges.clear();
+  debounce.clear(ChannelSet::all());
+  quiet.clear(ChannelSet::all());
+  scanAtMs = now;
+  publishSnapshot(now);
+  portEXIT_CRITICAL(&scanMux);
+  swPressed = lastPressed = raw;
+}
+
+// Protocol side: pick up the latest published sample
+static void refreshInputs() { swPressed = readSnapshot().raw; }
+
+// INTFA..GPIOB are contiguous, so one 6-byte sequential read returns INTF,
+// INTCAP and GPIO for both ports.
+static constexpr uint8_t MCP_REG_INTFA = 0x0E;
+
+static bool readIrqBlock(size_t idx, uint16_t &intf, uint16_t &intcap, uint16_t &gpio) {
+  uint8_t b[6];
+  if (i2cFault(idx, mcpRead(idx, MCP_REG_INTFA, b, 6)) != I2cFault::NONE) return false;
+  intf   = uint16_t(b[0] | (b[1] << 8));
+  intcap = uint16_t(b[2] | (b[3] << 8));
+  gpio   = uint16_t(b[4] | (b[5] << 8));
+  return true;
+}
+
+// Read every expander's interrupt block (this also clears INTA/INTB).
+// `pulse` gets presses captured in INTCAP that were already released by the read.
+static ChannelSet readIrqPorts(ChannelSet &pulse) {
+  uint16_t intf[EXPANDER_COUNT], cap[EXPANDER_COUNT], gpio[EXPANDER_COUNT];
+  for (size_t i = 0; i < EXPANDER_COUNT; ++i) {
+    if (!readIrqBlock(i, intf[i], cap[i], gpio[i])) {
+      intf[i] = 0; cap[i] = gpio[i] = portRaw[i];   // keep last known state on bus error
+    }
+  }
+  uint16_t pulses[EXPANDER_COUNT];
+  for (size_t i = 0; i < EXPANDER_COUNT; ++i) {
+    portRaw[i] = gpio[i];
+    pulses[i] = uint16_t(intf[i] & ~cap[i] & gpio[i]); // captured low, reads high now
+  }
+  pulse = LATCH_PULSE_CAPTURE ? decodeSwBits(pulses) : ChannelSet();
+  return ~decodeSwBits(gpio);
+}
+
+static void IRAM_ATTR onSwIrq() {
+  BaseType_t woken = pdFALSE;
+  if (scanTaskHandle) vTaskNotifyGiveFromISR(scanTaskHandle, &woken);
+  portYIELD_FROM_ISR(woken);
+}
+
+// Poll mode: fixed-rate vTaskDelayUntil() sampling. IRQ mode: sleep until INT
+// fires, capture, and re-run the debounce (without bus traffic) once the
+// window has elapsed or the quiet tick is due; a stuck INT drops back to
+// polling. Either way the protocol task is woken on stable changes.
+// Queued bus commands run first, in the scanner's own bus time.
+static void scanTask(void *) {
+  TickType_t wake = xTaskGetTickCount();
+  bool settling = false, intStuck = false;
+  unsigned long readAtMs = millis();
+  for (;;) {
+    ChannelSet raw, pulse;
+    if (!SW_IRQ_MODE) {
+      vTaskDelayUntil(&wake, SCAN_PERIOD_TICKS);
+      for (int bus = 0; bus < kfb::BUSES; ++bus)
+        if (scannerOwnsBus(bus)) serviceBusCommands(bus);
+      raw = SPLIT_BUS_SCAN ? readPortsMerged() : readPorts();
+    } else {
+      const TickType_t wait = settling ? pdMS_TO_TICKS(DEBOUNCE_MIN_MS) + 1
+                            : intStuck ? pdMS_TO_TICKS(SW_IRQ_STUCK_POLL_MS)
+                                       : pdMS_TO_TICKS(SW_IRQ_QUIET_TICK_MS);
+      const bool woke = ulTaskNotifyTake(pdTRUE, wait) > 0;
+      for (int bus = 0; bus < kfb::BUSES; ++bus) serviceBusCommands(bus);
+      // A wake for commands leaves INT high: it stays asserted until the expanders are read
+      const bool fired = (woke || intStuck) && digitalRead(SW_INT_PIN) == LOW;
+      const bool safety = SW_IRQ_SAFETY_POLL_MS && millis() - readAtMs >= SW_IRQ_SAFETY_POLL_MS;
+      intStuck = false;
+      if (fired || safety) {
+        // INT re-asserted during the read → read again (bounded in case the line is stuck)
+        for (int pass = 0; pass < 4; ++pass) {
+          ChannelSet p;
+          raw = readIrqPorts(p);
+          pulse |= p;
+          if (digitalRead(SW_INT_PIN) != LOW) break;
+        }
+        intStuck = digitalRead(SW_INT_PIN) == LOW;
+        readAtMs = millis();
+      } else {
+        raw = readSnapshot().raw;     // debounce deadline or quiet tick: inputs unchanged
+      }
+    }
+    const ScanResult r = scanStep(raw, pulse, millis());
+    settling = r.settling;
+    if (r.stableChanged && protoTaskHandle) xTaskNotifyGive(protoTaskHandle);
+  }
+}
+
+static void setupSwIrq() {
+  for (size_t i = 0; i < EXPANDER_COUNT; ++i) mcp[i].setupInterrupts(true, true, LOW);
+  for (int ch = 0; ch < CHANNEL_COUNT; ++ch) mcp[pinsMap[ch].mcpIndex].setupInterruptPin(pinsMap[ch].swPin, CHANGE);
+  pinMode(SW_INT_PIN, INPUT_PULLUP);
+  ChannelSet ignored;
+  readIrqPorts(ignored); // clear anything latched during configuration
+}
+
+static void startScanTask() {
+  if (SW_IRQ_MODE) setupSwIrq();
+  busOwnersRunning = true;  // from here on only the owners touch the buses
+  if (xTaskCreatePinnedToCore(scanTask, "scan", 4096, nullptr, SCAN_TASK_PRIO,
+                              &scanTaskHandle, SCAN_TASK_CORE) != pdPASS) {
+    Serial.println("FATAL: scan task create failed");
+    while (true) delay(1000);
+  }
+  // Same core as the scanner: both mostly wait on their bus
+  if (SPLIT_BUS_SCAN && xTaskCreatePinnedToCore(busScanTask, "scan1", 4096, (void *)intptr_t(1), SCAN_TASK_PRIO,
+                                                &busScanTaskHandle, SCAN_TASK_CORE) != pdPASS) {
+    Serial.println("FATAL: Wire1 scan task create failed");
+    while (true) delay(1000);
+  }
+  if (SW_IRQ_MODE) attachInterrupt(digitalPinToInterrupt(SW_INT_PIN), onSwIrq, FALLING);
+}
+
+static inline bool readSwRaw(int ch) { return !swPressed.test(ch); }
+static inline bool isPressedRaw(int ch) { return swPressed.test(ch); }
 
 static inline bool isZeroMac(const uint8_t *addr) {
   static const uint8_t zero[6] = {0,0,0,0,0,0};
@@ -204,37 +964,102 @@ static bool resolveTarget(const uint8_t *dest, uint8_t out[6]) {
   return true;
 }
 
-static void buildPins() {
+// Bring up the buses BOARD uses, every expander on its bus and the channel
+// pins (LED off, switch pulled up), then tune each bus clock. False after
+// printing the failing expander.
+static bool initExpanders() {
+  for (int bus = 0; bus < kfb::BUSES; ++bus) {
+    if (!kfb::layoutUsesBus(BOARD, bus)) continue;
+    TwoWire &w = bus ? Wire1 : Wire;
+    w.begin(I2C_PINS[bus][0], I2C_PINS[bus][1]);
+    setBusStep(bus, I2C_BOOT_STEP);
+  }
+  for (size_t i = 0; i < EXPANDER_COUNT; ++i) {
+    bool ok = mcp[i].begin_I2C(BOARD.expanders[i].addr, &expanderWire(i));
+    if (!ok) {
+      Serial.printf("MCP@0x%02X (bus %u) init failed\n", BOARD.expanders[i].addr, BOARD.expanders[i].bus);
+      return false;
+    }
+  }
   for (int ch = 0; ch < CHANNEL_COUNT; ++ch) {
-    uint16_t base = uint16_t(ch * 2);
-    uint8_t idx = uint8_t(base / 16);
-    uint8_t a = uint8_t(base % 16);
-    uint8_t b = uint8_t((base + 1) % 16);
-    // Swap low/high nibble so LED/SW are grouped on this PCB
-    auto remap = [](uint8_t p) -> uint8_t { return p < 8 ? uint8_t(p + 8) : uint8_t(p - 8); };
-    pinsMap[ch] = {idx, remap(a), remap(b)};
+    const auto &p = pinsMap[ch];
+    mcp[p.mcpIndex].pinMode(p.ledPin, OUTPUT);
+    mcp[p.mcpIndex].digitalWrite(p.ledPin, LOW);
+    mcp[p.mcpIndex].pinMode(p.swPin, INPUT_PULLUP);
+  }
+  for (size_t i = 0; i < EXPANDER_COUNT; ++i) {
+    expectIodir[i] = 0xFFFF;  // power-on default: all inputs, no pull-ups
+    expectGppu[i] = 0;
+    busPorts[i] = 0xFFFF;     // idle high until the first good read
+  }
+  for (int ch = 0; ch < CHANNEL_COUNT; ++ch) {
+    const auto &p = pinsMap[ch];
+    expectIodir[p.mcpIndex] &= uint16_t(~(1u << p.ledPin));
+    expectGppu[p.mcpIndex] |= uint16_t(1u << p.swPin);
   }
+  for (int bus = 0; bus < kfb::BUSES; ++bus) {
+    if (!kfb::layoutUsesBus(BOARD, bus)) continue;
+    if (!tuneBusAtBoot(bus)) Serial.printf("WARN: I2C bus %d fails the probe at every clock, running at %lu Hz\n", bus,
+                              (unsigned long)I2C_CLOCKS[0]);
+    else Serial.printf("I2C bus %d: %lu Hz\n", bus, (unsigned long)I2C_CLOCKS[busClock[bus].step.load()]);
+  }
+  return true;
 }
 
-static inline void sendEvent(const char* kind, int ch, bool val) {
-  if (!streamActive) return;
-  unsigned long now = millis();
+// Single-channel EV (text protocol / fallback)
+static bool sendEventTo(char kind, int ch, bool val, const uint8_t *dest) {
+  if (USE_BINARY_FRAMES) {
+    uint8_t f[kfb::HEADER_LEN + 3];
+    size_t n = kfb::putHeader(f, kfb::FT_EVENT, 0);
+    f[n++] = uint8_t(kind);
+    f[n++] = uint8_t(ch + 1);
+    f[n++] = val ? 1 : 0;
+    return sendFrame(f, n, dest, false);
+  }
+  char pkt[48];
+  snprintf(pkt, sizeof(pkt), "EV %c %d %d %s", kind, ch + 1, val ? 1 : 0, BOARD_MAC);
+  return sendCmdRaw(pkt, dest);
+}
 
-  if (kind[0] == 'P') {
-    if (now - lastEventSentP[ch] < MIN_EVENT_GAP_MS) return;
-    lastEventSentP[ch] = now;
-  } else { // 'L'
-    if (now - lastEventSentL[ch] < MIN_EVENT_GAP_MS) return;
-    lastEventSentL[ch] = now;
+// All P/L changes of one tick in a single FT_EVENTS frame (per-channel EVs in text mode).
+// Only bits set in pChanged/lChanged are reported; pVal/lVal may be full sets.
+static void sendEventBatch(const ChannelSet &pChanged, const ChannelSet &pVal,
+                           const ChannelSet &lChanged, const ChannelSet &lVal,
+                           bool snapshot, const uint8_t *dest, uint32_t originUs) {
+  if (USE_BINARY_FRAMES) {
+    uint8_t f[kfb::HEADER_LEN + 2 + 4 * ChannelSet::BYTES];
+    size_t n = kfb::putHeader(f, kfb::FT_EVENTS, 0);
+    f[n++] = snapshot ? kfb::EVF_SNAPSHOT : 0;
+    f[n++] = uint8_t(ChannelSet::BYTES);
+    pChanged.toBytes(f + n); n += ChannelSet::BYTES;
+    pVal.toBytes(f + n);     n += ChannelSet::BYTES;
+    lChanged.toBytes(f + n); n += ChannelSet::BYTES;
+    lVal.toBytes(f + n);     n += ChannelSet::BYTES;
+    sendFrame(f, n, dest, false, originUs);
+    return;
+  }
+  if (snapshot) {
+    (pChanged | lChanged).forEach([&](int ch) {
+      if (pChanged.test(ch)) sendEventTo('P', ch, pVal.test(ch), dest);
+      // small yield to avoid bursting 80 frames back-to-back
+      vTaskDelay(pdMS_TO_TICKS(1));
+      if (lChanged.test(ch)) { sendEventTo('L', ch, lVal.test(ch), dest); vTaskDelay(pdMS_TO_TICKS(1)); }
+    });
+    return;
   }
+  lChanged.forEach([&](int ch) { sendEventTo('L', ch, lVal.test(ch), dest); });
+  pChanged.forEach([&](int ch) { sendEventTo('P', ch, pVal.test(ch), dest); });
+}
 
-  char pkt[48];
-  snprintf(pkt, sizeof(pkt), "EV %s %d %d %s", kind, ch + 1, val ? 1 : 0, BOARD_MAC);
-  uint8_t target[6]; bool ok = getTarget(target);
-  // Only send EVs when we have an explicit session peer (no broadcast)
-  if (!ok) return;
-  // Live telemetry uses RAW to avoid occupying the global ACK slot
-  sendCmdRaw(pkt, target);
+// Channels of `want` whose last event is MIN_EVENT_GAP_MS old; the rest wait for a later tick
+static ChannelSet eventGapElapsed(const ChannelSet &want, unsigned long *lastSent, unsigned long now) {
+  ChannelSet due;
+  want.forEach([&](int ch) {
+    if (now - lastSent[ch] < MIN_EVENT_GAP_MS) return;
+    lastSent[ch] = now;
+    due.set(ch);
+  });
+  return due;
 }
 
 
@@ -242,12 +1067,10 @@ static inline void startStreaming(bool rebaseline = true) {
   if (streamActive && !rebaseline) return;
   streamActive = true;
   if (rebaseline) {
-    for (int i = 0; i < CHANNEL_COUNT; ++i) {
-      prevPressed[i]      = lastPressed[i];
-      prevLatchedState[i] = latched[i];
-      lastEventSentP[i]   = 0;
-      lastEventSentL[i]   = 0;
-    }
+    prevPressed      = lastPressed;
+    prevLatchedState = latched;
+    memset(lastEventSentP, 0, sizeof(lastEventSentP));
+    memset(lastEventSentL, 0, sizeof(lastEventSentL));
   }
 }
 
@@ -270,10 +1093,8 @@ static void goDarkAndIdle() {
 }
 
 static inline void sendSuccessAndIdle() {
-  char out[64];
-  snprintf(out, sizeof(out), "RESULT SUCCESS %s", BOARD_MAC);
-  uint8_t dest[6]; bool ok = getTarget(dest);
-  if (ok) sendCmd(out, dest);
+  uint8_t dest[6];
+  if (getTarget(dest)) sendResult(true);
   else Serial.println("WARN: success without session target");
   goDarkAndIdle();   // goDarkAndIdle already stops streaming
 }
@@ -298,17 +1119,40 @@ static bool ensurePeer(const uint8_t *addr) {
   return true;
 }
 
-// ===== Simple ACK/ID support =====
-static volatile bool hubAckActive = false;
-static volatile uint32_t hubAckId = 0;
-static uint8_t hubAckMac[6] = {0};
-static unsigned long hubAckLastSend = 0;
-static int hubAckRetriesLeft = 0;
-static char hubAckMsg[256];
-static unsigned hubAckTimeoutMs = 240; // retry spacing; reset on new TX or completion
+// ===== Reliable TX window =====
+// Up to ACK_WINDOW reliable frames are in flight at once, each with its own
+// ID, destination, retry budget and backoff. Only the protocol task claims
+// and arms slots (the RX callback just completes them on ACK); frames armed
+// while the window is full wait as QUEUED, in order, until serviceAckTx()
+// has room. Nothing in flight is ever evicted: with every slot taken the
+// sender gets false.
+static constexpr int      ACK_WINDOW         = 4;   // frames on the air at once
+static constexpr int      ACK_SLOTS          = 8;   // window plus backlog
+static constexpr int      ACK_RETRIES        = 4;   // resends after the first TX
+static constexpr unsigned ACK_TIMEOUT_MS     = 240; // first retry spacing
+static constexpr unsigned ACK_TIMEOUT_MAX_MS = 640;
+static constexpr unsigned ACK_BACKOFF_MS     = 80;  // linear backoff per retry
+
+struct AckSlot {
+  enum : uint8_t { FREE, FILLING, QUEUED, ACTIVE } st;
+  uint32_t id;
+  uint32_t order;           // arm order, for QUEUED
+  uint8_t mac[6];
+  unsigned long lastSend;   // 0 = not sent yet
+  uint32_t firstTxUs;       // micros() of the first send, for the ACK round trip
+  unsigned timeoutMs;
+  int retriesLeft;
+  size_t len;
+  uint8_t buf[kfb::MAX_FRAME]; // text (NUL included) or binary frame
+};
+static AckSlot ackSlots[ACK_SLOTS];
+static uint32_t ackOrder = 0;
+static portMUX_TYPE ackMux = portMUX_INITIALIZER_UNLOCKED;
 
+// IDs fit the 16-bit binary field; 0 means "no ACK wanted". Caller holds ackMux.
 static uint32_t nextSeqId() {
   static uint32_t seq = 1000;
+  if (seq > 0xFFFF) seq = 1;
   return seq++;
 }
 
@@ -323,34 +1167,121 @@ static bool extractIdToken(const char* msg, int len, uint32_t &outId) {
   outId = v; return true;
 }
 
+// Claim a slot for a new reliable frame, -1 when window and backlog are
+// both full. Fill slot.buf/len, then ackArm().
+static int ackClaim(const uint8_t* target, uint32_t &id) {
+  int idx = -1;
+  portENTER_CRITICAL(&ackMux);
+  for (int i = 0; i < ACK_SLOTS; ++i)
+    if (ackSlots[i].st == AckSlot::FREE) { idx = i; break; }
+  if (idx >= 0) {
+    AckSlot &s = ackSlots[idx];
+    s.st = AckSlot::FILLING;
+    s.id = id = nextSeqId();
+    memcpy(s.mac, target, 6);
+    s.lastSend = 0;
+    s.timeoutMs = ACK_TIMEOUT_MS;
+    s.retriesLeft = ACK_RETRIES;
+    s.len = 0;
+  }
+  portEXIT_CRITICAL(&ackMux);
+  if (idx < 0) Serial.println("WARN: ACK window and backlog full, reliable frame not sent");
+  return idx;
+}
+
+// Move the oldest QUEUED slots onto the air while the window has room. Caller holds ackMux.
+static void ackPromote() {
+  int active = 0;
+  for (const AckSlot &s : ackSlots) active += s.st == AckSlot::ACTIVE;
+  while (active < ACK_WINDOW) {
+    AckSlot *next = nullptr;
+    for (AckSlot &s : ackSlots)
+      if (s.st == AckSlot::QUEUED && (!next || int32_t(s.order - next->order) < 0)) next = &s;
+    if (!next) return;
+    next->st = AckSlot::ACTIVE;
+    ++active;
+  }
+}
+
+static void ackArm(int idx) {
+  portENTER_CRITICAL(&ackMux);
+  ackSlots[idx].order = ++ackOrder;
+  ackSlots[idx].st = AckSlot::QUEUED;
+  ackPromote();
+  portEXIT_CRITICAL(&ackMux);
+  // Immediate first send (when the window had room)
+  serviceAckTx();
+}
+
+// ACK from `mac`; binary ACKs only carry the low 16 bits of the ID
+static void ackComplete(const uint8_t* mac, uint32_t id, bool id16) {
+  const uint32_t us = micros();
+  bool acked = false; uint32_t firstTxUs = 0;
+  portENTER_CRITICAL(&ackMux);
+  for (AckSlot &s : ackSlots) {
+    if (s.st != AckSlot::ACTIVE) continue;
+    const uint32_t sid = id16 ? (s.id & 0xFFFF) : s.id;
+    if (sid == id && memcmp(mac, s.mac, 6) == 0) {
+      s.st = AckSlot::FREE;
+      acked = s.lastSend != 0;
+      firstTxUs = s.firstTxUs;
+      break;
+    }
+  }
+  portEXIT_CRITICAL(&ackMux);
+  if (acked) latency[LAT_ACK].record(us - firstTxUs);
+}
+
+// Retransmit scheduler: sends every slot whose backoff expired
 static void serviceAckTx() {
-  if (!hubAckActive) return;
   // stop retrying if we are no longer in an active session
   if (state == State::SELF_CHECK) {
-    hubAckActive = false;
-    hubAckTimeoutMs = 240; // reset spacing
+    portENTER_CRITICAL(&ackMux);
+    for (AckSlot &s : ackSlots)
+      if (s.st == AckSlot::ACTIVE || s.st == AckSlot::QUEUED) s.st = AckSlot::FREE;
+    portEXIT_CRITICAL(&ackMux);
     return;
   }
-  unsigned long now = millis();
-  if (hubAckLastSend == 0 || now - hubAckLastSend >= hubAckTimeoutMs) {
-    if (!ensurePeer(hubAckMac)) {
-      Serial.println("ACK peer ensure failed");
-    } else {
-      esp_now_send(hubAckMac, reinterpret_cast<const uint8_t*>(hubAckMsg), strlen(hubAckMsg)+1);
-      Serial.printf("→ (ACKed) Sent '%s' to %02X:%02X:%02X:%02X:%02X:%02X\n",
-        hubAckMsg, hubAckMac[0],hubAckMac[1],hubAckMac[2],hubAckMac[3],hubAckMac[4],hubAckMac[5]);
-    }
-    hubAckLastSend = now;
-    if (hubAckRetriesLeft > 0) {
-      hubAckRetriesLeft--;
-      // linear backoff with clamp
-      unsigned next = hubAckTimeoutMs + 80;
-      hubAckTimeoutMs = (next > 640u) ? 640u : next;
-    } else {
-      Serial.printf("WARN: no ACK for ID=%lu, giving up\n", (unsigned long)hubAckId);
-      hubAckActive = false;
-      hubAckTimeoutMs = 240; // reset for next session
+  // Slots freed by ACKs or give-ups let queued frames on the air
+  portENTER_CRITICAL(&ackMux);
+  ackPromote();
+  portEXIT_CRITICAL(&ackMux);
+  for (int i = 0; i < ACK_SLOTS; ++i) {
+    uint8_t buf[kfb::MAX_FRAME]; uint8_t mac[6];
+    size_t len = 0; uint32_t id = 0; bool giveUp = false;
+    unsigned long now = millis();
+    portENTER_CRITICAL(&ackMux);
+    AckSlot &s = ackSlots[i];
+    if (s.st == AckSlot::ACTIVE && (s.lastSend == 0 || now - s.lastSend >= s.timeoutMs)) {
+      if (s.lastSend != 0 && s.retriesLeft-- <= 0) {
+        giveUp = true;
+        s.st = AckSlot::FREE;
+      } else {
+        if (s.lastSend != 0) {
+          unsigned next = s.timeoutMs + ACK_BACKOFF_MS;
+          s.timeoutMs = (next > ACK_TIMEOUT_MAX_MS) ? ACK_TIMEOUT_MAX_MS : next;
+        } else {
+          s.firstTxUs = micros();
+        }
+        s.lastSend = now ? now : 1;
+        len = s.len;
+        memcpy(buf, s.buf, len);
+        memcpy(mac, s.mac, 6);
+      }
+      id = s.id;
     }
+    portEXIT_CRITICAL(&ackMux);
+
+    if (giveUp) { Serial.printf("WARN: no ACK for ID=%lu, giving up\n", (unsigned long)id); continue; }
+    if (!len) continue;
+    if (!ensurePeer(mac)) { Serial.println("ACK peer ensure failed"); continue; }
+    espNowSend(mac, buf, len);
+    if (kfb::isBinary(buf, (int)len))
+      Serial.printf("→ (ACKed) Sent frame type=%u ID=%lu (%u B) to %02X:%02X:%02X:%02X:%02X:%02X\n",
+        buf[1], (unsigned long)id, (unsigned)len, mac[0],mac[1],mac[2],mac[3],mac[4],mac[5]);
+    else
+      Serial.printf("→ (ACKed) Sent '%s' to %02X:%02X:%02X:%02X:%02X:%02X\n",
+        (const char*)buf, mac[0],mac[1],mac[2],mac[3],mac[4],mac[5]);
   }
 }
 
@@ -359,33 +1290,26 @@ static void triggerHello() {
   // Broadcast HELLO (optional)
   static const uint8_t bcast[6] = {0xFF,0xFF,0xFF,0xFF,0xFF,0xFF};
   ensurePeer(bcast);
-  esp_now_send(bcast, (const uint8_t*)"HELLO", 6);
+  espNowSend(bcast, (const uint8_t*)"HELLO", 6);
   Serial.printf("HELLO %s\n", BOARD_MAC);
 }
 
-static void allLeds(bool on) { for (int ch = 0; ch < CHANNEL_COUNT; ++ch) setLed(ch, on); }
-
-static void appendCsv(char *buf, size_t &len, int oneBased) {
-  if (len >= MAX_MSG_LEN - 2) return;               // need at least space for "N,"
-  int avail = int(MAX_MSG_LEN - 1 - len);           // keep space for NUL
-  int wrote = snprintf(buf + len, avail, "%d,", oneBased);
-  if (wrote < 0) return;
-  if (wrote >= avail) {                             // truncated
-    len = MAX_MSG_LEN - 1;
-    buf[len] = '\0';
-  } else {
-    len += size_t(wrote);
-  }
-}
-
-static void resetBuffers() {
-  missingLen = extraLen = 0;
-  missingBuf[0] = '\0';
-  extraBuf[0] = '\0';
-}
-static inline void trimBuffers() {
-  if (missingLen && missingBuf[missingLen - 1] == ',') missingBuf[--missingLen] = '\0';
-  if (extraLen   && extraBuf[extraLen   - 1] == ',')   extraBuf[--extraLen]   = '\0';
+static void allLeds(bool on) { setLeds(on ? ChannelSet::all() : ChannelSet()); }
+
+// Append "<label>a,b,c" (1-based) to out; false if it had to stop at an earlier channel
+static bool appendChannels(char *out, size_t &pos, size_t cap, const char *label, const ChannelSet &set) {
+  bool fits = true, first = true;
+  auto put = [&](int w) {
+    if (w < 0 || size_t(w) >= cap - pos) fits = false;
+    else pos += size_t(w);
+  };
+  put(snprintf(out + pos, cap - pos, "%s", label));
+  set.forEach([&](int ch) {
+    if (fits) put(snprintf(out + pos, cap - pos, first ? "%d" : ",%d", ch + 1));
+    first = false;
+  });
+  if (!fits) out[pos] = '\0';
+  return fits;
 }
 
 static inline bool isMacToken(const char* tok) {
@@ -414,26 +1338,110 @@ static inline bool parsePureInt(const char* tok, int& out /*1-based*/) {
   return true;
 }
 
-// Debounce + edge
-static inline bool debouncedPressed(int ch, unsigned long now, bool &pressedEdge) {
-  bool raw = isPressedRaw(ch);
-  if (raw != rawPrev[ch]) {               // raw just toggled -> start (re)timing
-    rawPrev[ch] = raw;
-    rawChangedAt[ch] = now;
+// "N" or "A-B" (1-based, A <= B); the station shortens long lists this way
+static bool parseChannelRange(const char* tok, int& first, int& last) {
+  const char* dash = strchr(tok, '-');
+  if (!dash) {
+    if (!parsePureInt(tok, first)) return false;
+    last = first;
+    return true;
   }
-  pressedEdge = false;
-  // accept only after raw stayed stable for CH_DEBOUNCE_MS
-  if (now - rawChangedAt[ch] >= CH_DEBOUNCE_MS && lastPressed[ch] != raw) {
-    lastPressed[ch] = raw;
-    pressedEdge = raw;                   // rising edge = press
+  char head[8];
+  const size_t n = size_t(dash - tok);
+  if (n == 0 || n >= sizeof(head)) return false;
+  memcpy(head, tok, n); head[n] = '\0';
+  return parsePureInt(head, first) && parsePureInt(dash + 1, last) && first <= last;
+}
+
+// Consume the scanner's debounced state: lastPressed/swPressed follow the
+// snapshot and the press edges (plus IRQ pulses) accumulated since the last
+// call are returned, so nothing is lost while the protocol task was busy.
+static ChannelSet debouncedPressed() {
+  const uint32_t us = micros();
+  portENTER_CRITICAL(&scanMux);
+  const ChannelSet edges = scanEdges;
+  scanEdges.clear();
+  lastPressed = scanStable;
+  swPressed = scanRaw;
+  const bool picked = changePending;
+  const uint32_t settledUs = changeSettledUs;
+  pickupOriginUs = picked ? changeRawUs : 0;
+  changePending = false;
+  portEXIT_CRITICAL(&scanMux);
+  if (picked) { latency[LAT_PICKUP].record(us - settledUs); pickupUs = us; }
+  return edges;
+}
+
+// Debounce `latch` with LATCH_DEBOUNCE_MS from the next scan on, the rest with CH_DEBOUNCE_MS
+static void setDebounceClass(const ChannelSet &latch) {
+  portENTER_CRITICAL(&scanMux);
+  debounceLatch = latch;
+  portEXIT_CRITICAL(&scanMux);
+}
+
+// Channels that have been quiet for the span of the remaining FINAL_CHECK samples
+static ChannelSet quietChannels() {
+  const unsigned long span = (unsigned long)(policy.samples - 1) * policy.spacingMs;
+  if (span > decltype(quiet)::MAX) return ChannelSet();
+  portENTER_CRITICAL(&scanMux);
+  const ChannelSet q = quiet.atLeast(span);
+  portEXIT_CRITICAL(&scanMux);
+  return q;
+}
+
+// Adopt the current raw state as stable for `mask` without generating edges
+static void rebaseDebounce(const ChannelSet &mask) {
+  portENTER_CRITICAL(&scanMux);
+  scanStable = mergeMasked(scanStable, scanRaw, mask);
+  scanEdges &= ~mask;
+  debounce.clear(mask);
+  publishSnapshot(millis());
+  lastPressed = mergeMasked(lastPressed, scanRaw, mask);
+  swPressed = scanRaw;
+  portEXIT_CRITICAL(&scanMux);
+}
+
+// Latch contactless press edges and stream this tick's P/L deltas as one frame
+static void applyEdges(const ChannelSet &pressEdge) {
+  const ChannelSet newLatch = monLatch & pressEdge;
+  latched   |= newLatch;
+  ignoredCh |= newLatch;
+  if (!streamActive) return;
+  const unsigned long now = millis();
+  // Throttled channels stay pending in prev* and go out with a later tick
+  const ChannelSet lEdge  = eventGapElapsed(monLatch & latched & ~prevLatchedState, lastEventSentL, now);
+  const ChannelSet pDelta = eventGapElapsed((monNormal | monLatch) & (lastPressed ^ prevPressed), lastEventSentP, now);
+  prevLatchedState |= lEdge;
+  prevPressed = mergeMasked(prevPressed, lastPressed, pDelta);
+  if (lEdge.none() && pDelta.none()) return;
+  // Only send EVs when we have an explicit session peer (no broadcast);
+  // live telemetry uses RAW to avoid occupying the ACK slot
+  uint8_t target[6];
+  if (!getTarget(target)) return;
+  sendEventBatch(pDelta, lastPressed, lEdge, latched, false, target, pickupOriginUs);
+  if (pickupOriginUs) latency[LAT_EV_SEND].record(micros() - pickupUs);
+  pickupOriginUs = 0;
+}
+
+// Strip FINAL_CHECK policy tokens from a command; MONITOR starts over from
+// the compiled defaults, CHECK adjusts the session's policy
+static void takeSessionPolicy(char *args, bool fromDefaults) {
+  if (fromDefaults) policy = DEFAULT_POLICY;
+  const kfb::CheckPolicy before = policy;
+  if (!kfb::takePolicy(args, policy))
+    Serial.printf("WARN: FINAL_CHECK policy rejected (bad token or over %lu ms)\n", kfb::POLICY_MAX_CHECK_MS);
+  // Samples closer than the debounce window would vote on the same bounce
+  if (policy.spacingMs < DEBOUNCE_MAX_MS) policy.spacingMs = DEBOUNCE_MAX_MS;
+  if (kfb::policyCheckMs(policy) > kfb::POLICY_MAX_CHECK_MS) {
+    Serial.printf("WARN: FINAL_CHECK policy over %lu ms rejected\n", kfb::POLICY_MAX_CHECK_MS);
+    policy = before;
   }
-  return lastPressed[ch];
 }
 
 // === Parse MONITOR ===
 // === Parse MONITOR ===
 static void parseMonitorPayload(const char *data, int len) {
-  char buf[200];
+  char buf[kfb::MAX_FRAME + 1];
   int c = min(len, (int)sizeof(buf) - 1);
   memcpy(buf, data, c);
   buf[c] = '\0';
@@ -442,13 +1450,13 @@ static void parseMonitorPayload(const char *data, int len) {
   if (!p) return;
   p += 7;
   while (*p == ' ') ++p;
+  takeSessionPolicy(p, true);
 
   // Uppercase for simpler parsing
   for (char *q = p; *q; ++q) *q = toupper((unsigned char)*q);
 
   bool latchMode = false;
   bool skipCount = false;         // skip the "(N)" right after NORMAL/LATCH
-  const unsigned long now = millis();
 
   // Tokenize; allow forms like: "MONITOR normal(2)=[1,2] contactless(1)=[3]"
   char *save = nullptr;
@@ -470,59 +1478,35 @@ static void parseMonitorPayload(const char *data, int len) {
     // Skip the count token that follows NORMAL/LATCH
     if (skipCount) { skipCount = false; continue; }
 
-    // Channel number
-    int oneBased = 0;
-    if (!parsePureInt(tok, oneBased)) continue;
-    const int ch = oneBased - 1;
-    const bool had = (monNormal[ch] || monLatch[ch]);   // already tracked?
-
-    if (latchMode) {
-      if (monNormal[ch]) { // reclassify NORMAL -> LATCH
-        latched[ch] = false;
-        ignoredCh[ch] = false;
-        rawPrev[ch] = isPressedRaw(ch);
-        rawChangedAt[ch] = now;
-        lastPressed[ch] = rawPrev[ch];
-      }
-      monLatch[ch] = true; monNormal[ch] = false;
-      if (!had) {
-        ignoredCh[ch]   = false;
-        latched[ch]     = false;
-        rawPrev[ch]     = isPressedRaw(ch);
-        rawChangedAt[ch]= now;
-        lastPressed[ch] = rawPrev[ch];
+    // Channel number or range
+    int first = 0, last = 0;
+    if (!parseChannelRange(tok, first, last)) continue;
+    for (int ch = first - 1; ch < last; ++ch) {
+      // New channel or reclassification (NORMAL <-> LATCH): restart its model
+      const bool reset = latchMode ? !monLatch.test(ch) : !monNormal.test(ch);
+      if (reset) {
+        latched.reset(ch);
+        ignoredCh.reset(ch);
+        ChannelSet one; one.set(ch);
+        rebaseDebounce(one);
       }
-      setLed(ch, !latched[ch]);
-    } else {
-      if (monLatch[ch]) { // reclassify LATCH -> NORMAL
-        latched[ch] = false;
-        ignoredCh[ch] = false;
-        rawPrev[ch] = isPressedRaw(ch);
-        rawChangedAt[ch] = now;
-        lastPressed[ch] = rawPrev[ch];
-      }
-      monNormal[ch] = true; monLatch[ch]  = false;
-      if (!had) {
-        ignoredCh[ch]   = false;
-        latched[ch]     = false;
-        rawPrev[ch]     = isPressedRaw(ch);
-        rawChangedAt[ch]= now;
-        lastPressed[ch] = rawPrev[ch];
-      }
-      setLed(ch, true);
+      monLatch.set(ch, latchMode);
+      monNormal.set(ch, !latchMode);
+      setLed(ch, latchMode ? !latched.test(ch) : true);
     }
   }
 
+  setDebounceClass(monLatch);
   // If we were idle, require release once before edges start counting
   if (state != State::MONITORING) needReleaseGate = true;
 }
 
 // === Parse CHECK ===
 static void parseCheckSelection(const char *payload, int len) {
-  memset(checkSelect, 0, sizeof(checkSelect));
+  checkSelect.clear();
   checkActive = false;
 
-  char buf[160];
+  char buf[kfb::MAX_FRAME + 1];
   int c = min(len, int(sizeof(buf) - 1));
   memcpy(buf, payload, c); buf[c] = '\0';
 
@@ -530,14 +1514,14 @@ static void parseCheckSelection(const char *payload, int len) {
   if (!p) return;
   p += 5;
   while (*p == ' ') ++p;
+  takeSessionPolicy(p, false);
 
   bool any = false;
   char *save = nullptr;
   for (char *tok = strtok_r(p, " ,", &save); tok; tok = strtok_r(nullptr, " ,", &save)) {
-    int oneBased=0;
-    if (!parsePureInt(tok, oneBased)) continue;  // ignore MAC or non-numeric
-    int ch = oneBased - 1;
-    checkSelect[ch] = true;
+    int first = 0, last = 0;
+    if (!parseChannelRange(tok, first, last)) continue;  // ignore MAC or non-numeric
+    for (int ch = first - 1; ch < last; ++ch) checkSelect.set(ch);
     any = true;
   }
   checkActive = any; // if false → evaluate tracked pins
@@ -545,68 +1529,35 @@ static void parseCheckSelection(const char *payload, int len) {
 
 // === Determine if all contactless are latched ===
 static inline bool allContactlessLatched() {
-  for (int ch = 0; ch < CHANNEL_COUNT; ++ch)
-    if (monLatch[ch] && !latched[ch]) return false;
-  return true;
+  return (monLatch & ~latched).none();
 }
 
 // === LED + status for CHECK (strict) ===
-static bool checkAll(bool restrictToSelection, unsigned long now) {
-  bool ok = true;
-  resetBuffers();
-
-  bool pressed[CHANNEL_COUNT];
-  for (int ch = 0; ch < CHANNEL_COUNT; ++ch) {
-    bool e = false;
-    pressed[ch] = debouncedPressed(ch, now, e);
-
-    // Latch handling
-    if (monLatch[ch] && e) {
-      latched[ch] = true; ignoredCh[ch] = true;
-      if (streamActive && !prevLatchedState[ch]) {
-        sendEvent("L", ch, true);
-        prevLatchedState[ch] = true;
-      }
-    }
-
-    // Pressed state delta
-    if (streamActive && (monNormal[ch] || monLatch[ch]) && pressed[ch] != prevPressed[ch]) {
-      sendEvent("P", ch, pressed[ch]);      // Pressed changed
-      prevPressed[ch] = pressed[ch];
-    }
-  }
-
-
-  for (int ch = 0; ch < CHANNEL_COUNT; ++ch) {
-    const bool tracked = (monNormal[ch] || monLatch[ch]) && !ignoredCh[ch];
-    const bool selected = restrictToSelection ? (checkActive && checkSelect[ch] && !ignoredCh[ch])
-                                              : tracked;
-
-    if (ignoredCh[ch]) { setLed(ch, false); continue; }
-
-    if (monNormal[ch]) {
-      if (selected && !pressed[ch]) { ok = false; appendCsv(missingBuf, missingLen, ch + 1); }
-      setLed(ch, !pressed[ch]);
-    } else if (monLatch[ch]) {
-      if (selected && !latched[ch]) { ok = false; appendCsv(missingBuf, missingLen, ch + 1); }
-      setLed(ch, !latched[ch]);
-    } else {
-      if (pressed[ch]) { ok = false; appendCsv(extraBuf, extraLen, ch + 1); setLed(ch, blinkState); }
-      else setLed(ch, false);
-    }
-  }
-  return ok;
+static bool checkAll(bool restrictToSelection) {
+  applyEdges(debouncedPressed());
+
+  const ChannelSet &pressed = lastPressed;
+  const ChannelSet active   = ~ignoredCh;
+  const ChannelSet tracked  = monNormal | monLatch;
+  const ChannelSet selected = restrictToSelection
+      ? (checkActive ? checkSelect & active : ChannelSet())
+      : tracked & active;
+
+  const ChannelSet normalOff = monNormal & active & ~pressed;  // normal not held
+  const ChannelSet latchOff  = monLatch  & active & ~latched;  // contactless not latched
+  const ChannelSet missing   = selected & (normalOff | latchOff);
+  const ChannelSet extra     = ~tracked & pressed;
+
+  lastMissing = missing;
+  lastExtra = extra;
+  setLeds(normalOff | latchOff | (blinkState ? extra : ChannelSet()));
+  return missing.none() && extra.none();
 }
 
 // === SELF_CHECK ===
 static void doSelfCheck() {
-  bool anyBad = false;
-  for (int ch = 0; ch < CHANNEL_COUNT; ++ch) {
-    bool raw = isPressedRaw(ch);
-    setLed(ch, blinkState && raw);
-    if (raw) anyBad = true;
-  }
-  if (!anyBad) {
+  setLeds(blinkState ? swPressed : ChannelSet());
+  if (swPressed.none()) {
     state = State::WAIT_FOR_TARGET;
     Serial.println(">> SELF_CHECK OK, waiting for MONITOR");
   }
@@ -617,73 +1568,33 @@ static void doMonitoring() {
 
   if (needReleaseGate) {
     needReleaseGate = false;
-    unsigned long now = millis();
-    for (int i = 0; i < CHANNEL_COUNT; ++i) {
-      bool r = isPressedRaw(i);
-      rawPrev[i]      = r;
-      rawChangedAt[i] = now;
-      lastPressed[i]  = r;
-      if (streamActive) prevPressed[i] = r;
-    }
+    rebaseDebounce(ChannelSet::all());
+    if (streamActive) prevPressed = swPressed;
   }
 
   unsigned long now = millis();
-  bool pressed[CHANNEL_COUNT];
-
-  for (int ch = 0; ch < CHANNEL_COUNT; ++ch) {
-    bool e = false;
-    pressed[ch] = debouncedPressed(ch, now, e);
-
-    // latch edges (contactless)
-    if (monLatch[ch] && e) {
-      latched[ch] = true;
-      ignoredCh[ch] = true;
-    }
-
-    // live stream telemetry while monitoring
-    if (streamActive) {
-      if (monLatch[ch] && e && !prevLatchedState[ch]) {
-        sendEvent("L", ch, true);
-        prevLatchedState[ch] = true;
-      }
-      if ((monNormal[ch] || monLatch[ch]) && pressed[ch] != prevPressed[ch]) {
-        sendEvent("P", ch, pressed[ch]);
-        prevPressed[ch] = pressed[ch];
-      }
-    }
-  }
+  // latch edges (contactless) + live stream telemetry while monitoring
+  applyEdges(debouncedPressed());
 
+  const ChannelSet &pressed = lastPressed;
+  const ChannelSet active   = ~ignoredCh;
   const bool finalReady = allContactlessLatched();
 
-  // LED policy
-  if (finalReady) {
-    for (int ch = 0; ch < CHANNEL_COUNT; ++ch) {
-      if (ignoredCh[ch]) { setLed(ch, false); continue; }
-      const bool held = (monNormal[ch] || monLatch[ch]) && pressed[ch];
-      if (monNormal[ch])      setLed(ch, held ? false : true);
-      else if (monLatch[ch])  setLed(ch, latched[ch]);
-      else                    setLed(ch, pressed[ch] ? blinkState : false);
-    }
-  } else {
-    for (int ch = 0; ch < CHANNEL_COUNT; ++ch) {
-      if (ignoredCh[ch]) { setLed(ch, false); continue; }
-      if (monNormal[ch])      setLed(ch, !pressed[ch]);
-      else if (monLatch[ch])  setLed(ch, !latched[ch]);
-      else                    setLed(ch, pressed[ch] ? blinkState : false);
-    }
-  }
+  // LED policy: normals lit until held, contactless lit until latched
+  // (latched channels are ignored → dark), stray presses blink.
+  const ChannelSet normalOff = monNormal & active & ~pressed;
+  const ChannelSet latchOff  = monLatch & active & ~latched;
+  const ChannelSet stray     = ~(monNormal | monLatch) & pressed;
+  setLeds(normalOff | latchOff | (blinkState ? stray : ChannelSet()));
 
   // All latch channels latched (finalReady) AND all normal channels currently held
-  bool normalsHeld = true;
-  for (int ch = 0; ch < CHANNEL_COUNT; ++ch) {
-    if (monNormal[ch] && !ignoredCh[ch] && !pressed[ch]) { normalsHeld = false; break; }
-  }
+  const bool normalsHeld = normalOff.none();
 
   if (finalReady && normalsHeld && hasWorkToCheck(false)) {
     if (!liveOkSince) liveOkSince = now;
-    if (now - liveOkSince >= AUTO_FINAL_HOLD_MS) {
+    if (now - liveOkSince >= policy.holdMs) {
       // emit AUTO-FINAL as RAW to avoid competing with RESULT ACK state
-      { uint8_t dest[6]; if (getTarget(dest)) sendCmdRaw("AUTO-FINAL", dest); }
+      { uint8_t dest[6]; if (getTarget(dest)) sendReply(kfb::RC_AUTO_FINAL, dest, false); }
       sendSuccessAndIdle();   // RESULT SUCCESS + stopStreaming + goDarkAndIdle()
       return;
     }
@@ -697,130 +1608,250 @@ static void doMonitoring() {
 // === FINAL_CHECK ===
 // helper
 static inline bool hasWorkToCheck(bool restrictToSelection) {
-  if (restrictToSelection) {
-    for (int ch = 0; ch < CHANNEL_COUNT; ++ch)
-      if (checkSelect[ch] && !ignoredCh[ch]) return true;
-    return false;
+  const ChannelSet work = restrictToSelection ? checkSelect : (monNormal | monLatch);
+  return (work & ~ignoredCh).any();
+}
+
+// === FINAL_CHECK ===
+// Stepped from protocolLoop: the settle time and the sample spacing are
+// deadlines, not delays, so ACK retries and received frames keep flowing.
+static struct {
+  bool running;       // settle started for the current CHECK
+  int taken, ok;      // samples so far / passing ones
+  unsigned long at;   // millis() of the next sample
+} finalCheck;
+
+static void finishFinalCheck(bool pass) {
+  finalCheck.running = false;
+  (void)checkAll(checkActive);
+  // tiny yield so RAW EVs can TX before RESULT claims the ACK slot
+  vTaskDelay(1);
+
+  if (pass) {
+    Serial.println(">> SUCCESS");
+    { uint8_t dest[6]; if (getTarget(dest)) sendResult(true); }
+    stopStreaming();
+    goDarkAndIdle();            // <<< was: state = State::SELF_CHECK;
   } else {
-    for (int ch = 0; ch < CHANNEL_COUNT; ++ch)
-      if ((monNormal[ch] || monLatch[ch]) && !ignoredCh[ch]) return true;
-    return false;
+    { uint8_t dest[6]; if (getTarget(dest)) sendResult(false); }
+    state = State::MONITORING;
   }
 }
 
-// === FINAL_CHECK ===
 static void doFinalCheck() {
   const bool restrict = checkActive ? true : false;
+  const unsigned long now = millis();
 
-  if (!hasWorkToCheck(restrict)) {
-    Serial.println(">> SUCCESS (no-work)");
-    char out[64];
-    snprintf(out, sizeof(out), "RESULT SUCCESS %s", BOARD_MAC);
-    { uint8_t dest[6]; if (getTarget(dest)) sendCmd(out, dest); }
-    stopStreaming();
-    goDarkAndIdle();            // <<< was: state = State::SELF_CHECK;
+  if (!finalCheck.running) {
+    if (!hasWorkToCheck(restrict)) {
+      Serial.println(">> SUCCESS (no-work)");
+      { uint8_t dest[6]; if (getTarget(dest)) sendResult(true); }
+      stopStreaming();
+      goDarkAndIdle();            // <<< was: state = State::SELF_CHECK;
+      return;
+    }
+    // We were already streaming since MONITOR; don't rebaseline here
+    startStreaming(false);
+    finalCheck.running = true;
+    finalCheck.taken = finalCheck.ok = 0;
+    finalCheck.at = now + policy.settleMs;
+  }
+  if ((long)(now - finalCheck.at) < 0) return;
+
+  // The verdict reads the selected normals and every untracked channel (stray
+  // presses); latch channels only through `latched`, which never clears here.
+  const ChannelSet tracked = monNormal | monLatch;
+  const ChannelSet watch = ((restrict ? checkSelect : tracked) & monNormal & ~ignoredCh) | ~tracked;
+
+  const int need = kfb::passThreshold(policy);
+  const bool pass = checkAll(restrict);
+  finalCheck.taken++;
+  if (pass) finalCheck.ok++;
+  flushLeds();
+  if (finalCheck.ok >= need) { finishFinalCheck(true); return; }
+  // Quiet long enough: the remaining samples would read this same state
+  if (pass && (watch & ~quietChannels()).none()) { finishFinalCheck(true); return; }
+  if ((policy.samples - finalCheck.taken) + finalCheck.ok < need) { finishFinalCheck(false); return; }
+  finalCheck.at = now + policy.spacingMs;
+}
+
+
+
+// === RX ===
+// Runs in the Wi-Fi task: settle ACKs, queue everything else for the protocol
+// task and ACK a frame only once it is queued, so a frame dropped on a full
+// queue is simply retried by the station.
+static void onRecv(const esp_now_recv_info_t *info, const uint8_t *data, int len) {
+  if (!info || !data || len <= 0) return;
+  const uint8_t *src = info->src_addr;
+
+  kfb::Header h;
+  if (kfb::parseHeader(data, len, h) && h.type == kfb::FT_ACK) {
+    ackComplete(src, h.id, true);
     return;
   }
 
-  // We were already streaming since MONITOR; don't rebaseline here
-  startStreaming(false);
+  RxItem item;
+  memcpy(item.mac, src, 6);
+  item.len = (uint8_t)min(len, (int)kfb::MAX_FRAME);
+  memcpy(item.data, data, item.len);
+  item.data[item.len] = '\0';
+  const bool text = !kfb::isBinary(data, len);
 
-  if (FINAL_CHECK_SETTLE_MS) vTaskDelay(pdMS_TO_TICKS(FINAL_CHECK_SETTLE_MS));
+  // Process ACK replies
+  if (text && strncmp(item.data, "ACK ", 4) == 0) {
+    ackComplete(src, strtoul(item.data + 4, nullptr, 10), false);
+    return; // ACKs carry no content
+  }
 
-  int ok = 0, fail = 0;
-  for (int i = 0; i < FINAL_CHECK_SAMPLES; ++i) {
-    if (checkAll(restrict, millis())) ok++; else fail++;
-    if (ok >= PASS_THRESHOLD) break;
-    if ((FINAL_CHECK_SAMPLES - i - 1) + ok < PASS_THRESHOLD) break;
-    vTaskDelay(pdMS_TO_TICKS(SAMPLE_DELAY_MS));
+  // Latency report: answered here so a busy protocol task neither delays nor
+  // skews it; STATS-OK closes the station's reply window
+  if (text && strncmp(item.data, "STATS", 5) == 0 && (item.data[5] == '\0' || item.data[5] == ' ')) {
+    if (strncmp(item.data + 5, " RESET", 6) == 0) {
+      for (auto &h : latency) h.reset();
+      for (auto &c : i2cFaults) { c.nack.store(0); c.timeout.store(0); c.mismatch.store(0); }
+      for (auto &b : busClock) b.fallbacks.store(0);
+      for (auto &f : i2cRingFull) f.store(0);
+      sendCmdRaw("STATS-OK RESET", src);
+    } else {
+      sendStats(src);
+      sendCmdRaw("STATS-OK", src);
+    }
+  } else if (xQueueSend(rxQueue, &item, 0) != pdTRUE) {
+    rxDropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  } else if (protoTaskHandle) {
+    xTaskNotifyGive(protoTaskHandle);
   }
 
-  (void)checkAll(restrict, millis());
-  // tiny yield so RAW EVs can TX before RESULT claims the ACK slot
-  vTaskDelay(1);
-  trimBuffers();
+  // Auto-ACK any frame that contains an ID token
+  uint32_t incomingId = 0;
+  if (text && !isZeroMac(src) && extractIdToken(item.data, item.len, incomingId)) {
+    char ackBuf[24];
+    int m = snprintf(ackBuf, sizeof(ackBuf), "ACK %lu", (unsigned long)incomingId);
+    if (m > 0 && m < (int)sizeof(ackBuf)) {
+      // Send ACK without adding our own ID, reply to src directly
+      sendCmdRaw(ackBuf, src);
+    }
+  }
+}
 
-  if (ok >= PASS_THRESHOLD) {
-    Serial.println(">> SUCCESS");
-    char out[64];
-    snprintf(out, sizeof(out), "RESULT SUCCESS %s", BOARD_MAC);
-    { uint8_t dest[6]; if (getTarget(dest)) sendCmd(out, dest); }
-    stopStreaming();
-    goDarkAndIdle();            // <<< was: state = State::SELF_CHECK;
-  } else {
-    char core[MAX_MSG_LEN * 2]; size_t pos = 0;
-    auto app = [&](const char* s){
-      int a = snprintf(core + pos, sizeof(core) - pos, "%s", s);
-      if (a > 0) {
-        size_t newPos = pos + (size_t)a;
-        size_t cap = sizeof(core) - 1;
-        pos = (newPos < cap) ? newPos : cap;
-      }
-    };
-    app("FAILURE");
-    if (missingLen) { app(" MISSING "); app(missingBuf); }
-    if (extraLen)   { app(missingLen ? ";EXTRA " : " EXTRA "); app(extraBuf); }
-    char pkt[MAX_MSG_LEN * 2 + 16];
-    snprintf(pkt, sizeof(pkt), "RESULT %s %s", core, BOARD_MAC);
-    { uint8_t dest[6]; if (getTarget(dest)) sendCmd(pkt, dest); }
-    state = State::MONITORING;
+// Animation frame: `on` LEDs lit, every other output bit as in olatShadow
+static void animShow(const ChannelSet &on, unsigned long holdMs) {
+  uint16_t next[EXPANDER_COUNT];
+  portENTER_CRITICAL(&ledMux);
+  memcpy(next, olatShadow, sizeof(next));
+  portEXIT_CRITICAL(&ledMux);
+  for (int ch = 0; ch < CHANNEL_COUNT; ++ch) {
+    const auto &p = pinsMap[ch];
+    const uint16_t bit = uint16_t(1u << p.ledPin);
+    next[p.mcpIndex] = on.test(ch) ? uint16_t(next[p.mcpIndex] | bit) : uint16_t(next[p.mcpIndex] & ~bit);
   }
+  for (size_t i = 0; i < EXPANDER_COUNT; ++i)
+    if (next[i] != animOlat[i]) { animOlat[i] = next[i]; animDirty |= 1u << i; }
+  animAt = millis() + holdMs;
 }
 
+static void startAnimation(Anim kind, int count) {
+  portENTER_CRITICAL(&ledMux);
+  memcpy(animOlat, olatShadow, sizeof(animOlat));
+  portEXIT_CRITICAL(&ledMux);
+  animDirty = ALL_EXPANDERS;
+  anim = kind;
+  animLeft = count;
+  animCh = 0;
+  animOn = true;
+  ChannelSet on;
+  if (kind == Anim::BLINK) on = ChannelSet::all(); else on.set(0);
+  animShow(on, kind == Anim::BLINK ? 120 : 40);
+}
 
+// Hand the LEDs back to the current state; its picture is rewritten in full
+static void stopAnimation() {
+  if (anim == Anim::NONE) return;
+  anim = Anim::NONE;
+  portENTER_CRITICAL(&ledMux);
+  olatDirty = ALL_EXPANDERS;
+  portEXIT_CRITICAL(&ledMux);
+}
 
-// === RX ===
-static void onRecv(const esp_now_recv_info_t *info, const uint8_t *data, int len) {
-  if (!info || !data || len <= 0) return;
-  if (isZeroMac(info->src_addr)) {
+static void stepAnimation() {
+  if (anim == Anim::NONE || (long)(millis() - animAt) < 0) return;
+  ChannelSet on;
+  if (anim == Anim::BLINK) {
+    if (animOn) { animOn = false; animShow(on, 120); return; }
+    if (--animLeft == 0) { stopAnimation(); return; }
+    on = ChannelSet::all();
+    animOn = true;
+    animShow(on, 120);
+    return;
+  }
+  if (animOn) { animOn = false; animShow(on, 1); return; }
+  if (++animCh == CHANNEL_COUNT) {
+    animCh = 0;
+    if (--animLeft == 0) { stopAnimation(); return; }
+  }
+  on.set(animCh);
+  animOn = true;
+  animShow(on, 40);
+}
+
+// Count argument of BLINK/CHASE, clamped to [1, maxCount]
+static int animCount(const char *rx, int dflt, int maxCount) {
+  const char* sp = strchr(rx, ' ');
+  if (!sp || !*(sp+1)) return dflt;
+  const long n = strtol(sp+1, nullptr, 10);
+  return n < 1 ? 1 : n > maxCount ? maxCount : int(n);
+}
+
+// Start streaming and send MONITOR-START + one baseline snapshot frame via RAW
+static void sendMonitorBaseline(const uint8_t *dest) {
+  startStreaming();
+  sendReply(kfb::RC_MONITOR_START, dest, false);
+  refreshInputs(); // earlier commands in this batch may have taken a while
+
+  const ChannelSet tracked = monNormal | monLatch;
+  sendEventBatch(tracked, swPressed, monLatch, latched, true, dest);
+  // Mirror baseline into prev* so first deltas are consistent
+  prevPressed      = mergeMasked(prevPressed, swPressed, tracked);
+  prevLatchedState = mergeMasked(prevLatchedState, latched, tracked);
+}
+
+// Protocol task: one received frame, in arrival order
+static void handleFrame(const RxItem &item) {
+  if (isZeroMac(item.mac)) {
     Serial.println("WARN: ignoring frame from zero-MAC sender");
     return;
   }
   // update sender atomically
   portENTER_CRITICAL(&g_senderMux);
-  memcpy(lastSender, info->src_addr, 6);
+  memcpy(lastSender, item.mac, 6);
   haveSender = true;
   portEXIT_CRITICAL(&g_senderMux);
 
-  // Safe copy of RX for parsing
-  char rxb[256];
-  int n = min(len, (int)sizeof(rxb) - 1);
-  memcpy(rxb, data, n); rxb[n] = '\0';
-  // Trim simple trailing/leading spaces in-place (basic)
+  // Binary frames: the station only sends ACKs this way; commands stay text
+  kfb::Header h;
+  if (kfb::parseHeader((const uint8_t*)item.data, item.len, h)) {
+    Serial.printf("WARN: unexpected binary frame type=%u\n", h.type);
+    return;
+  }
+  if (kfb::isBinary((const uint8_t*)item.data, item.len)) {
+    Serial.println("WARN: binary frame with unknown version");
+    return;
+  }
+
+  // Trim simple trailing/leading spaces (basic)
+  char rxb[sizeof(item.data)];
+  memcpy(rxb, item.data, item.len + 1);
   auto ltrim = [](char* s){ while (*s==' '||*s=='\t' || *s=='\r') ++s; return s; };
   auto rtrim = [](char* s){ size_t L=strlen(s); while(L&& (s[L-1]==' '||s[L-1]=='\t'||s[L-1]=='\r')) s[--L]='\0'; return s; };
   char* rx = ltrim(rxb); rtrim(rx);
   Serial.printf("Recv: %s\n", rx);
 
-  // Process ACK replies
-  if (strncmp(rx, "ACK ", 4) == 0) {
-    uint32_t id = strtoul(rx + 4, nullptr, 10);
-    if (hubAckActive && id == hubAckId && memcmp(info->src_addr, hubAckMac, 6) == 0) {
-      hubAckActive = false; // mark complete
-    }
-    return; // ACKs carry no content
-  }
-
-  // Auto-ACK any frame that contains an ID token — only for the active session peer
-  uint32_t incomingId = 0;
-  if (extractIdToken(rxb, n, incomingId)) {
-    bool ok; uint8_t sess[6];
-    portENTER_CRITICAL(&g_senderMux);
-    ok = haveSender; if (ok) memcpy(sess, lastSender, 6);
-    portEXIT_CRITICAL(&g_senderMux);
-    if (ok && memcmp(info->src_addr, sess, 6) == 0) {
-      char ackBuf[24];
-      int m = snprintf(ackBuf, sizeof(ackBuf), "ACK %lu", (unsigned long)incomingId);
-      if (m > 0 && m < (int)sizeof(ackBuf)) {
-        // Send ACK without adding our own ID, reply to src directly
-        sendCmdRaw(ackBuf, info->src_addr);
-      }
-    }
-  }
-
   if (strncmp(rx, "WELCOME", 7) == 0) {
-    { uint8_t dest[6]; bool ok = getTarget(dest); if (ok) sendCmdRaw("WELCOME", dest); }
-    { uint8_t dest[6]; bool ok = getTarget(dest); if (ok) sendCmd("READY", dest); }
+    stopAnimation();
+    { uint8_t dest[6]; bool ok = getTarget(dest); if (ok) sendReply(kfb::RC_WELCOME, dest, false); }
+    { uint8_t dest[6]; bool ok = getTarget(dest); if (ok) sendReply(kfb::RC_READY, dest, true); }
     state = State::WELCOME;
     welcomeEdgeCount = 0;
     return;
@@ -828,58 +1859,36 @@ static void onRecv(const esp_now_recv_info_t *info, const uint8_t *data, int len
 
   if (strncmp(rx, "PING", 4) == 0) {
     // One-shot reply; keep it simple and avoid competing with other ACKs
-    { uint8_t dest[6]; bool ok = getTarget(dest); if (ok) sendCmdRaw("PING-OK", dest); }
+    { uint8_t dest[6]; bool ok = getTarget(dest); if (ok) sendReply(kfb::RC_PING_OK, dest, false); }
     return;
   }
 
   if (strncmp(rx, "BLINK", 5) == 0) {
-    int times = 3;
-    const char* sp = strchr(rx, ' ');
-    if (sp && *(sp+1)) times = max(1, atoi(sp+1));
-    uint8_t dest[6]; bool haveDest = getTarget(dest);
-    portENTER_CRITICAL(&pendingMux);
-    pending.kind = PendingCmd::Blink;
-    pending.n = times;
-    pending.hasMac = haveDest;
-    if (haveDest) memcpy(pending.mac, dest, 6); else memset(pending.mac, 0, sizeof(pending.mac));
-    havePending = true;
-    portEXIT_CRITICAL(&pendingMux);
-    { uint8_t dest[6]; bool ok = getTarget(dest); if (ok) sendCmd("BLINK-OK", dest); }
+    const int times = animCount(rx, 3, BLINK_MAX_TIMES);
+    { uint8_t dest[6]; bool ok = getTarget(dest); if (ok) sendReply(kfb::RC_BLINK_OK, dest, true); }
+    startAnimation(Anim::BLINK, times);
     return;
   }
 
   if (strncmp(rx, "CHASE", 5) == 0) {
-    int rounds = 1;
-    const char* sp = strchr(rx, ' ');
-    if (sp && *(sp+1)) rounds = max(1, atoi(sp+1));
-    uint8_t dest[6]; bool haveDest = getTarget(dest);
-    portENTER_CRITICAL(&pendingMux);
-    pending.kind = PendingCmd::Chase;
-    pending.n = rounds;
-    pending.hasMac = haveDest;
-    if (haveDest) memcpy(pending.mac, dest, 6); else memset(pending.mac, 0, sizeof(pending.mac));
-    havePending = true;
-    portEXIT_CRITICAL(&pendingMux);
-    { uint8_t dest[6]; bool ok = getTarget(dest); if (ok) sendCmd("CHASE-OK", dest); }
+    const int rounds = animCount(rx, 1, CHASE_MAX_ROUNDS);
+    { uint8_t dest[6]; bool ok = getTarget(dest); if (ok) sendReply(kfb::RC_CHASE_OK, dest, true); }
+    startAnimation(Anim::CHASE, rounds);
     return;
   }
+
+  // Session commands (and WELCOME above) take the LEDs back from BLINK/CHASE
+  stopAnimation();
+
   if (strncmp(rx, "MONITOR", 7) == 0) {
-    parseMonitorPayload((const char*)data, len);
+    parseMonitorPayload(item.data, item.len);
     state = State::MONITORING;
 
-    { uint8_t dest[6]; bool ok = getTarget(dest); if (ok) { ensurePeer(dest); sendCmd("MONITOR-OK", dest); } }
-
-    // Defer MONITOR-START and baseline snapshot to loop()
     uint8_t dest[6]; bool haveDest = getTarget(dest);
-    portENTER_CRITICAL(&pendingMux);
-    pending.kind = PendingCmd::MonitorBaseline;
-    pending.n = 0;
-    pending.hasMac = haveDest;
-    if (haveDest) memcpy(pending.mac, dest, 6); else memset(pending.mac, 0, sizeof(pending.mac));
-    havePending = true;
-    portEXIT_CRITICAL(&pendingMux);
-
+    if (haveDest) { ensurePeer(dest); sendReply(kfb::RC_MONITOR_OK, dest, true); }
     Serial.println(">> MONITORING");
+
+    if (haveDest) sendMonitorBaseline(dest);
     return;
   }
 
@@ -887,13 +1896,12 @@ static void onRecv(const esp_now_recv_info_t *info, const uint8_t *data, int len
     parseCheckSelection(rx, strlen(rx));
     const bool restrict = checkActive ? true : false;
     if (!hasWorkToCheck(restrict)) {
-      char out[64];
-      snprintf(out, sizeof(out), "RESULT SUCCESS %s", BOARD_MAC);
-      uint8_t dest[6]; if (getTarget(dest)) sendCmd(out, dest);
+      uint8_t dest[6]; if (getTarget(dest)) sendResult(true);
       goDarkAndIdle();              // <<< keep LEDs dark
       return;
     }
     state = State::FINAL_CHECK;
+    finalCheck.running = false;   // a CHECK during FINAL_CHECK starts over
     Serial.println(">> FINAL_CHECK");
     return;
   }
@@ -904,39 +1912,108 @@ static void onRecv(const esp_now_recv_info_t *info, const uint8_t *data, int len
     cleanAll();
     state = State::WAIT_FOR_TARGET;
     // Avoid guard in serviceAckTx() that bails in WAIT_FOR_TARGET
-    { uint8_t dest[6]; bool ok = getTarget(dest); if (ok) sendCmdRaw("CLEAN-OK", dest); }
+    { uint8_t dest[6]; bool ok = getTarget(dest); if (ok) sendReply(kfb::RC_CLEAN_OK, dest, false); }
     return;
   }
 }
 
 static void cleanAll() {
-  memset(monNormal, 0, sizeof(monNormal));
-  memset(monLatch, 0, sizeof(monLatch));
-  memset(latched, 0, sizeof(latched));
-  memset(ignoredCh, 0, sizeof(ignoredCh));
-  memset(checkSelect, 0, sizeof(checkSelect));
+  monNormal.clear();
+  monLatch.clear();
+  setDebounceClass(monLatch);
+  latched.clear();
+  ignoredCh.clear();
+  checkSelect.clear();
   checkActive = false;
-  unsigned long now = millis();
-  for (int ch = 0; ch < CHANNEL_COUNT; ++ch) {
-    rawPrev[ch] = isPressedRaw(ch);
-    rawChangedAt[ch] = now;
-    lastPressed[ch] = rawPrev[ch];
-    setLed(ch, false);
-  }
+  policy = DEFAULT_POLICY;
+  rebaseDebounce(ChannelSet::all());
+  allLeds(false);
   needReleaseGate = false;
 }
 
-static uint8_t lastTxMac[6]; static bool lastTxMacValid=false;
+// Send-callback outcomes, counted in the Wi-Fi task and reported by protocolLoop
+static std::atomic<uint32_t> txDoneOk{0}, txDoneFail{0};
+
+// Every esp_now_send() goes through here so onSent can match its stamp
+static esp_err_t espNowSend(const uint8_t* mac, const uint8_t* data, size_t len, uint32_t originUs) {
+  portENTER_CRITICAL(&txStampMux);
+  if (txStampCount == TX_STAMPS) { txStampHead = (txStampHead + 1) % TX_STAMPS; --txStampCount; }
+  const uint32_t seq = ++txStampSeq;
+  txStamps[(txStampHead + txStampCount++) % TX_STAMPS] = {seq, (uint32_t)micros(), originUs, false};
+  portEXIT_CRITICAL(&txStampMux);
+  const esp_err_t err = esp_now_send(mac, data, len);
+  if (err != ESP_OK) {
+    portENTER_CRITICAL(&txStampMux);
+    for (int i = 0; i < txStampCount; ++i) {
+      TxStamp &t = txStamps[(txStampHead + i) % TX_STAMPS];
+      if (t.seq == seq) { t.dead = true; break; }
+    }
+    portEXIT_CRITICAL(&txStampMux);
+  }
+  return err;
+}
 
-static bool sendCmdRaw(const char* msg, const uint8_t* dest) {
+// Send callback side: oldest live stamp → tx-done (and edge-to-air for EVs)
+static void recordTxDone() {
+  const uint32_t us = micros();
+  TxStamp t{};
+  bool have = false;
+  portENTER_CRITICAL(&txStampMux);
+  while (txStampCount && !have) {
+    t = txStamps[txStampHead];
+    txStampHead = (txStampHead + 1) % TX_STAMPS; --txStampCount;
+    have = !t.dead;
+  }
+  portEXIT_CRITICAL(&txStampMux);
+  if (!have) return;
+  latency[LAT_TX_DONE].record(us - t.sentUs);
+  if (t.originUs) latency[LAT_EDGE_TO_AIR].record(us - t.originUs);
+}
+
+// One raw text frame per stage: "STATS <stage> n=.. p50=.. p99=.. max=.." (µs)
+// Then the I2C health: "STATS i2c bus=<b> hz=.. fallbacks=.. nack=.. timeout=.. mismatch=.. cmd-full=.."
+// per bus, plus "STATS i2c 0x<addr>/<bus> nack=.. timeout=.. mismatch=.." per faulty expander
+static void sendStats(const uint8_t* dest) {
+  char line[128];
+  for (int i = 0; i < LAT_COUNT; ++i) {
+    latency[i].format(LAT_NAMES[i], line, sizeof(line));
+    sendCmdRaw(line, dest);
+  }
+  for (int bus = 0; bus < kfb::BUSES; ++bus) {
+    if (!kfb::layoutUsesBus(BOARD, bus)) continue;
+    uint32_t nack = 0, timeout = 0, mismatch = 0;
+    for (size_t i = 0; i < EXPANDER_COUNT; ++i) {
+      if (BOARD.expanders[i].bus != bus) continue;
+      const ExpanderFaults &c = i2cFaults[i];
+      const uint32_t n = c.nack.load(std::memory_order_relaxed), t = c.timeout.load(std::memory_order_relaxed),
+                     m = c.mismatch.load(std::memory_order_relaxed);
+      nack += n; timeout += t; mismatch += m;
+      if (!(n | t | m)) continue;
+      snprintf(line, sizeof(line), "STATS i2c 0x%02X/%d nack=%lu timeout=%lu mismatch=%lu", BOARD.expanders[i].addr,
+               bus, (unsigned long)n, (unsigned long)t, (unsigned long)m);
+      sendCmdRaw(line, dest);
+    }
+    snprintf(line, sizeof(line), "STATS i2c bus=%d hz=%lu fallbacks=%lu nack=%lu timeout=%lu mismatch=%lu cmd-full=%lu",
+             bus, (unsigned long)I2C_CLOCKS[busClock[bus].step.load(std::memory_order_relaxed)],
+             (unsigned long)busClock[bus].fallbacks.load(std::memory_order_relaxed), (unsigned long)nack,
+             (unsigned long)timeout, (unsigned long)mismatch,
+             (unsigned long)i2cRingFull[bus].load(std::memory_order_relaxed));
+    sendCmdRaw(line, dest);
+  }
+}
+
+static bool sendBytesRaw(const uint8_t* data, size_t len, const uint8_t* dest, uint32_t originUs = 0) {
   uint8_t target[6];
   if (!resolveTarget(dest, target)) {
     Serial.println("WARN: sendCmdRaw: no valid target");
     return false;
   }
   if (!ensurePeer(target)) return false;
-  memcpy(lastTxMac, target, 6); lastTxMacValid = true;
-  return esp_now_send(target, (const uint8_t*)msg, strlen(msg)+1) == ESP_OK;
+  return espNowSend(target, data, len, originUs) == ESP_OK;
+}
+
+static bool sendCmdRaw(const char* msg, const uint8_t* dest) {
+  return sendBytesRaw((const uint8_t*)msg, strlen(msg)+1, dest);
 }
 
 static bool sendCmd(const char* msg, const uint8_t* dest) {
@@ -951,35 +2028,97 @@ static bool sendCmd(const char* msg, const uint8_t* dest) {
     return sendCmdRaw(msg, target);
   }
   // Frame with ID and schedule resend
-  // Cancel any in-flight ACK to avoid mixing transactions
-  hubAckActive = false;
-  hubAckTimeoutMs = 240; // reset backoff for the new transaction
-  uint32_t id = nextSeqId();
-  snprintf(hubAckMsg, sizeof(hubAckMsg), "%s ID=%lu", msg, (unsigned long)id);
-  memcpy(hubAckMac, target, 6);
-  hubAckId = id;
-  hubAckRetriesLeft = 4; // a bit more robust
-  hubAckLastSend = 0;
-  hubAckActive = true;
-  // Immediate first send
-  serviceAckTx();
+  uint32_t id;
+  int idx = ackClaim(target, id);
+  if (idx < 0) return false;
+  AckSlot &s = ackSlots[idx];
+  int m = snprintf((char*)s.buf, sizeof(s.buf), "%s ID=%lu", msg, (unsigned long)id);
+  s.len = (m < 0) ? 1 : ((size_t)m < sizeof(s.buf) ? (size_t)m + 1 : sizeof(s.buf));
+  ackArm(idx);
   return true;
 }
 
+// Binary counterpart of sendCmd/sendCmdRaw; the ID is patched in here
+static bool sendFrame(uint8_t* frame, size_t len, const uint8_t* dest, bool reliable, uint32_t originUs) {
+  static const uint8_t bcast[6] = {0xFF,0xFF,0xFF,0xFF,0xFF,0xFF};
+  uint8_t target[6];
+  if (len > kfb::MAX_FRAME) {
+    Serial.printf("WARN: sendFrame: frame too long (%u B > %u B)\n", (unsigned)len, (unsigned)kfb::MAX_FRAME);
+    return false;
+  }
+  if (!resolveTarget(dest, target)) {
+    Serial.println("WARN: sendFrame: no valid target");
+    return false;
+  }
+  if (!reliable || memcmp(target, bcast, 6) == 0) {
+    kfb::setId(frame, 0);
+    return sendBytesRaw(frame, len, target, originUs);
+  }
+  uint32_t id;
+  int idx = ackClaim(target, id);
+  if (idx < 0) return false;
+  kfb::setId(frame, (uint16_t)id);
+  memcpy(ackSlots[idx].buf, frame, len);
+  ackSlots[idx].len = len;
+  ackArm(idx);
+  return true;
+}
+
+static bool sendReply(uint8_t code, const uint8_t* dest, bool reliable) {
+  if (USE_BINARY_FRAMES) {
+    uint8_t f[kfb::HEADER_LEN + 1];
+    size_t n = kfb::putHeader(f, kfb::FT_REPLY, 0);
+    f[n++] = code;
+    return sendFrame(f, n, dest, reliable);
+  }
+  char out[48];
+  if (kfb::replyHasMac(code)) snprintf(out, sizeof(out), "%s %s", kfb::replyText(code), BOARD_MAC);
+  else snprintf(out, sizeof(out), "%s", kfb::replyText(code));
+  return reliable ? sendCmd(out, dest) : sendCmdRaw(out, dest);
+}
+
+// RESULT to the session peer; FAILURE content comes from the last checkAll()
+static void sendResult(bool ok) {
+  uint8_t dest[6];
+  if (!getTarget(dest)) return;
+  const ChannelSet missing = ok ? ChannelSet() : lastMissing;
+  const ChannelSet extra   = ok ? ChannelSet() : lastExtra;
+  if (USE_BINARY_FRAMES) {
+    // Complete sets plus the final state of every tracked channel; at 128
+    // channels that is 82 payload bytes, always one frame
+    const ChannelSet tracked = monNormal | monLatch;
+    uint8_t f[kfb::HEADER_LEN + 2 + kfb::RESULT_SETS * ChannelSet::BYTES];
+    static_assert(sizeof(f) <= kfb::MAX_FRAME, "RESULT must fit one ESP-NOW frame");
+    size_t n = kfb::putHeader(f, kfb::FT_RESULT, 0);
+    f[n++] = ok ? 1 : 0;
+    f[n++] = uint8_t(ChannelSet::BYTES);
+    missing.toBytes(f + n);                n += ChannelSet::BYTES;
+    extra.toBytes(f + n);                  n += ChannelSet::BYTES;
+    (missing & monLatch).toBytes(f + n);   n += ChannelSet::BYTES;
+    (lastPressed & tracked).toBytes(f + n); n += ChannelSet::BYTES;
+    (latched & monLatch).toBytes(f + n);   n += ChannelSet::BYTES;
+    sendFrame(f, n, dest, true);
+    return;
+  }
+  // Legacy text: one frame, " ID=n" appended by sendCmd
+  char pkt[kfb::MAX_FRAME - 12];
+  size_t pos = size_t(snprintf(pkt, sizeof(pkt), "RESULT %s", ok ? "SUCCESS" : "FAILURE"));
+  bool fits = true;
+  if (missing.any()) fits = fits && appendChannels(pkt, pos, sizeof(pkt), " MISSING ", missing);
+  if (extra.any())   fits = fits && appendChannels(pkt, pos, sizeof(pkt), missing.any() ? ";EXTRA " : " EXTRA ", extra);
+  if (!fits) Serial.println("WARN: text RESULT truncated; USE_BINARY_FRAMES carries every channel");
+  snprintf(pkt + pos, sizeof(pkt) - pos, " %s", BOARD_MAC);
+  sendCmd(pkt, dest);
+}
+
 #if ESP_ARDUINO_VERSION_MAJOR >= 3
 static void onSent(const esp_now_send_info_t* /*tx_info*/, esp_now_send_status_t status) {
-  if (lastTxMacValid)
-    Serial.printf("→ sent to %02X:%02X:%02X:%02X:%02X:%02X status=%d\n",
-      lastTxMac[0],lastTxMac[1],lastTxMac[2],lastTxMac[3],lastTxMac[4],lastTxMac[5], (int)status);
-  else
-    Serial.printf("→ sent status=%d\n", (int)status);
-}
 #else
-static void onSent(const uint8_t* mac, esp_now_send_status_t status) {
-  Serial.printf("→ sent to %02X:%02X:%02X:%02X:%02X:%02X status=%d\n",
-    mac[0],mac[1],mac[2],mac[3],mac[4],mac[5], (int)status);
-}
+static void onSent(const uint8_t* /*mac*/, esp_now_send_status_t status) {
 #endif
+  recordTxDone();
+  (status == ESP_NOW_SEND_SUCCESS ? txDoneOk : txDoneFail).fetch_add(1, std::memory_order_relaxed);
+}
 
 // === Setup / Loop ===
 void setup() {
@@ -991,38 +2130,15 @@ void setup() {
 
   pinMode(BTN_PIN, INPUT_PULLUP);
 
-  Wire.begin(21, 22);
-  Wire.setClock(400000);
-  // Create I2C mutex
-  i2cMutex = xSemaphoreCreateMutex();
-  if (!i2cMutex) {
-    Serial.println("FATAL: i2cMutex alloc failed");
+  if (!initExpanders()) {
     while (true) delay(1000);
   }
-  for (uint8_t i = 0; i < EXPANDER_COUNT; ++i) {
-    i2cLock();
-    bool ok = mcp[i].begin_I2C(MCP_I2C_ADDR[i]);
-    i2cUnlock();
-    if (!ok) {
-      Serial.printf("MCP@0x%02X init failed\n", MCP_I2C_ADDR[i]);
-      while (true) delay(1000);
-    }
-  }
-  buildPins();
-  const unsigned long bootNow = millis();
-  for (int ch = 0; ch < CHANNEL_COUNT; ++ch) {
-    auto &p = pinsMap[ch];
-    i2cLock();
-    mcp[p.mcpIndex].pinMode(p.ledPin, OUTPUT);
-    mcp[p.mcpIndex].digitalWrite(p.ledPin, LOW);
-    mcp[p.mcpIndex].pinMode(p.swPin, INPUT_PULLUP);
-    i2cUnlock();
-    rawPrev[ch] = isPressedRaw(ch);       // avoid phantom first-edge
-    rawChangedAt[ch] = bootNow;
-    lastPressed[ch] = rawPrev[ch];
-  }
+  scanInputs(); // baseline as stable: avoid phantom first-edge
 
-  for (int i = 0; i < 3; i++) { allLeds(true); delay(120); allLeds(false); delay(120); }
+  for (int i = 0; i < 3; i++) {
+    allLeds(true);  flushLeds(); delay(120);
+    allLeds(false); flushLeds(); delay(120);
+  }
 
   WiFi.mode(WIFI_STA);
   WiFi.disconnect(true, true);
@@ -1038,20 +2154,34 @@ void setup() {
     Serial.println("ESP-NOW init failed");
     while (true) delay(1000);
   }
+  rxQueue = xQueueCreate(RX_QUEUE_LEN, sizeof(RxItem));
+  if (!rxQueue) {
+    Serial.println("FATAL: rx queue alloc failed");
+    while (true) delay(1000);
+  }
   esp_now_register_recv_cb(onRecv);
   esp_now_register_send_cb(onSent);
 
-  memset(monNormal, 0, sizeof(monNormal));
-  memset(monLatch, 0, sizeof(monLatch));
-  memset(latched, 0, sizeof(latched));
-  memset(ignoredCh, 0, sizeof(ignoredCh));
-  memset(checkSelect, 0, sizeof(checkSelect));
+  monNormal.clear();
+  monLatch.clear();
+  latched.clear();
+  ignoredCh.clear();
+  checkSelect.clear();
 
   state = State::SELF_CHECK;
+  startScanTask();
+  if (xTaskCreatePinnedToCore(protocolTask, "proto", 8192, nullptr, PROTO_TASK_PRIO,
+                              &protoTaskHandle, PROTO_TASK_CORE) != pdPASS) {
+    Serial.println("FATAL: protocol task create failed");
+    while (true) delay(1000);
+  }
   Serial.println("READY");
 }
 
-void loop() {
+// All work runs in the scanner and protocol tasks
+void loop() { vTaskDelete(nullptr); }
+
+static void protocolLoop() {
   unsigned long now = millis();
 
   if (now - lastBlinkTick >= BLINK_INTERVAL_MS) {
@@ -1079,14 +2209,15 @@ void loop() {
     }
   }
 
+  // Latest scanner sample for the raw-state consumers below
+  refreshInputs();
+
   switch (state) {
     case State::SELF_CHECK:    doSelfCheck();    break;
     case State::WAIT_FOR_TARGET: {
       // Surface any switches held during idle by blinking stuck channels.
-      for (int ch = 0; ch < CHANNEL_COUNT; ++ch) {
-        bool pressed = isPressedRaw(ch);
-        setLed(ch, pressed ? blinkState : false);
-      }
+      setLeds(blinkState ? swPressed : ChannelSet());
+      retuneI2cIdle();
       break;
     }
     case State::MONITORING:    doMonitoring();   break;
@@ -1096,70 +2227,41 @@ void loop() {
   // Drive ACK resend state machine
   serviceAckTx();
 
-  // Handle any pending heavy actions scheduled from RX callback
-  if (havePending) {
-    PendingCmd pc;
-    portENTER_CRITICAL(&pendingMux);
-    pc = pending; havePending = false; pending.kind = PendingCmd::None; pending.hasMac = false; pending.n = 0; memset(pending.mac, 0, sizeof(pending.mac));
-    portEXIT_CRITICAL(&pendingMux);
-    switch (pc.kind) {
-      case PendingCmd::Blink: {
-        for (int i = 0; i < pc.n; ++i) {
-          allLeds(true);  vTaskDelay(pdMS_TO_TICKS(120)); serviceAckTx();
-          allLeds(false); vTaskDelay(pdMS_TO_TICKS(120)); serviceAckTx();
-        }
-        break;
-      }
-      case PendingCmd::Chase: {
-        int rounds = max(1, pc.n);
-        while (rounds--) {
-          for (int ch = 0; ch < CHANNEL_COUNT; ++ch) {
-            setLed(ch, true);  vTaskDelay(pdMS_TO_TICKS(40));  serviceAckTx();
-            setLed(ch, false); vTaskDelay(pdMS_TO_TICKS(1));   serviceAckTx();
-          }
-        }
-        break;
-      }
-      case PendingCmd::MonitorBaseline: {
-        // Start streaming and send MONITOR-START + baseline snapshot via RAW
-        startStreaming();
-        char startPkt[48];
-        snprintf(startPkt, sizeof(startPkt), "MONITOR-START %s", BOARD_MAC);
-        uint8_t destBuf[6];
-        bool haveDest = false;
-        if (pc.hasMac) { memcpy(destBuf, pc.mac, sizeof(destBuf)); haveDest = true; }
-        else haveDest = getTarget(destBuf);
-        if (!haveDest) break;
-        sendCmdRaw(startPkt, destBuf);
-        for (int ch = 0; ch < CHANNEL_COUNT; ++ch) {
-          if (monNormal[ch] || monLatch[ch]) {
-            bool p = isPressedRaw(ch);
-            char pkt[48]; snprintf(pkt, sizeof(pkt), "EV P %d %d %s", ch+1, p?1:0, BOARD_MAC);
-            sendCmdRaw(pkt, destBuf);
-            // small yield to avoid bursting 80 frames back-to-back
-            vTaskDelay(pdMS_TO_TICKS(1));
-            if (monLatch[ch]) {
-              char pkt2[48]; snprintf(pkt2, sizeof(pkt2), "EV L %d %d %s", ch+1, latched[ch]?1:0, BOARD_MAC);
-              sendCmdRaw(pkt2, destBuf);
-              vTaskDelay(pdMS_TO_TICKS(1));
-            }
-          }
-        }
-        // Mirror baseline into prev* so first deltas are consistent
-        for (int i = 0; i < CHANNEL_COUNT; ++i) {
-          if (monNormal[i] || monLatch[i]) {
-            bool p = isPressedRaw(i);
-            prevPressed[i] = p;
-            prevLatchedState[i] = latched[i];
-          }
-        }
-        break;
-      }
-      default: break;
-    }
+  // Received commands, in order; BLINK/CHASE only arm the animation below
+  RxItem item;
+  while (xQueueReceive(rxQueue, &item, 0) == pdTRUE) handleFrame(item);
+  static uint32_t reportedDrops = 0;
+  const uint32_t drops = rxDropped.load(std::memory_order_relaxed);
+  if (drops != reportedDrops) {
+    Serial.printf("WARN: RX queue full, %lu frame(s) dropped\n", (unsigned long)(drops - reportedDrops));
+    reportedDrops = drops;
   }
+  static uint32_t reportedOk = 0, reportedFail = 0;
+  const uint32_t sentOk = txDoneOk.load(std::memory_order_relaxed);
+  const uint32_t sentFail = txDoneFail.load(std::memory_order_relaxed);
+  if (sentOk != reportedOk || sentFail != reportedFail) {
+    Serial.printf("→ sent ok=%lu fail=%lu\n", (unsigned long)(sentOk - reportedOk), (unsigned long)(sentFail - reportedFail));
+    reportedOk = sentOk;
+    reportedFail = sentFail;
+  }
+
+  stepAnimation();
+  // Single LED write per dirty expander for everything decided this iteration
+  flushLeds();
+  // Housekeeping period; the scanner cuts it short on every debounced change,
+  // and a running animation or FINAL_CHECK on its next step
+  TickType_t wait = pdMS_TO_TICKS(10);
+  auto until = [&wait](unsigned long at) {
+    const long left = (long)(at - millis());
+    wait = left <= 0 ? 0 : min(wait, pdMS_TO_TICKS(left));
+  };
+  if (anim != Anim::NONE) until(animAt);
+  if (state == State::FINAL_CHECK && finalCheck.running) until(finalCheck.at);
+  ulTaskNotifyTake(pdTRUE, wait);
+}
 
-  vTaskDelay(pdMS_TO_TICKS(10));
+static void protocolTask(void *) {
+  for (;;) protocolLoop();
 }
 
 /*
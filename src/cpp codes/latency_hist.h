@@ -0,0 +1,74 @@
+#pragma once
+// Fixed-bucket latency histograms shared by hub.cpp and station.cpp.
+//
+// Samples are microseconds. Buckets are exact below 4 µs, then four per
+// power of two (at most 25 % wide), so 124 buckets cover the whole uint32_t
+// range. record() is a few instructions plus relaxed atomics and may run on
+// any task, core or callback; percentiles report the upper bound of the bucket.
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <atomic>
+
+namespace kfb {
+
+struct LatencyHist {
+  static constexpr int SUB_BITS = 2;
+  static constexpr int BUCKETS = ((32 - SUB_BITS) << SUB_BITS) + (1 << SUB_BITS);
+
+  std::atomic<uint32_t> count{0};
+  std::atomic<uint32_t> maxUs{0};
+  std::atomic<uint32_t> bucket[BUCKETS] = {};
+
+  static int index(uint32_t us) {
+    if (us < (1u << SUB_BITS)) return int(us);
+    const int msb = 31 - __builtin_clz(us);
+    return ((msb - SUB_BITS + 1) << SUB_BITS) + int((us >> (msb - SUB_BITS)) & ((1u << SUB_BITS) - 1));
+  }
+
+  // Largest value that lands in bucket i
+  static uint32_t upper(int i) {
+    if (i < (1 << SUB_BITS)) return uint32_t(i);
+    const int msb = (i >> SUB_BITS) + SUB_BITS - 1;
+    const uint32_t lo = (1u << msb) | (uint32_t(i & ((1 << SUB_BITS) - 1)) << (msb - SUB_BITS));
+    return lo + ((1u << (msb - SUB_BITS)) - 1);
+  }
+
+  void record(uint32_t us) {
+    bucket[index(us)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    uint32_t m = maxUs.load(std::memory_order_relaxed);
+    while (us > m && !maxUs.compare_exchange_weak(m, us, std::memory_order_relaxed)) {}
+  }
+
+  void reset() {
+    for (auto &b : bucket) b.store(0, std::memory_order_relaxed);
+    count.store(0, std::memory_order_relaxed);
+    maxUs.store(0, std::memory_order_relaxed);
+  }
+
+  // q in (0, 1]; 0 when empty
+  uint32_t percentile(double q) const {
+    const uint32_t n = count.load(std::memory_order_relaxed);
+    if (!n) return 0;
+    const uint32_t rank = uint32_t(q * n + 0.999999);
+    uint32_t seen = 0;
+    for (int i = 0; i < BUCKETS; ++i) {
+      seen += bucket[i].load(std::memory_order_relaxed);
+      if (seen >= rank) {
+        const uint32_t m = maxUs.load(std::memory_order_relaxed);
+        return upper(i) < m ? upper(i) : m;
+      }
+    }
+    return maxUs.load(std::memory_order_relaxed);
+  }
+
+  // "STATS <stage> n=<count> p50=<us> p99=<us> max=<us>"
+  int format(const char *stage, char *out, size_t cap) const {
+    return snprintf(out, cap, "STATS %s n=%lu p50=%lu p99=%lu max=%lu", stage,
+                    (unsigned long)count.load(std::memory_order_relaxed), (unsigned long)percentile(0.50),
+                    (unsigned long)percentile(0.99), (unsigned long)maxUs.load(std::memory_order_relaxed));
+  }
+};
+
+} // namespace kfb
@@ -0,0 +1,27 @@
+#pragma once
+// kfb_bench: the hub's evaluation code replayed against switch traces on the
+// virtual clock. hub_bench.cpp implements these on top of hub.cpp's own
+// functions; bench_main.cpp owns traces, scenarios and baselines.
+#include <stddef.h>
+#include <stdint.h>
+
+namespace bench {
+
+// Hardware and state as after setup(), bound to the calling thread, which
+// acts as the protocol task. No scanner task and no radio bring-up.
+void hubBoot();
+// ESP-NOW receive callback for a frame from `mac`
+void hubReceive(const uint8_t mac[6], const uint8_t *data, size_t len);
+// One poll-mode scanner tick: scanStep() on the current switch levels.
+// Wakes the protocol task on a debounced change; returns scanStep()'s CPU ns.
+uint64_t hubScan();
+// One protocol task iteration (protocolLoop(), at most 10 ms of virtual time)
+void hubProtocol();
+bool hubWaitingForMonitor();
+uint32_t hubScanPeriodUs();
+int hubChannels();
+
+// CPU time of the calling thread
+uint64_t cpuNs();
+
+} // namespace bench
@@ -0,0 +1,576 @@
+// kfb_bench: replays switch traces through hub.cpp's scanner and protocol
+// code on the virtual clock and compares the outcome with stored baselines.
+//
+// A trace is a list of timed actions, one per line ('#' starts a comment):
+//   <us> press <ch>      switch of 1-based channel ch closes
+//   <us> release <ch>    ... and opens again
+//   <us> cmd <text>      frame from the station, e.g. "MONITOR 1,2,3" or "CHECK"
+// Times are microseconds from the start of the trace. Built-in scenarios
+// generate synthetic traces (--dump prints one); --trace replays a file.
+//
+// Each scenario runs in a forked child on a freshly booted hub. The scanner
+// step runs every SCAN_RATE_HZ period, the protocol loop whenever the
+// firmware would run it, and reliable frames are ACKed one period later.
+// Everything reported except CPU time is deterministic.
+#include "bench.h"
+#include "sim.h"
+#include "../espnow_proto.h"
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Action {
+  enum Kind { PRESS, RELEASE, CMD };
+  uint64_t at;
+  Kind kind;
+  int ch;            // 1-based
+  std::string text;  // CMD
+};
+
+struct Trace {
+  std::string name;
+  std::vector<Action> actions;
+};
+
+struct Options {
+  std::vector<std::string> scenarios;  // built-ins to run; empty = all
+  std::vector<std::string> traces;
+  bool builtins = true;
+  std::string baseline, writeBaseline, dump;
+  double cpuTolerancePct = -1;         // < 0: CPU time is reported, never compared
+  uint64_t latencyToleranceUs = 0;
+  uint64_t timeoutUs = 3000000;        // after the last action
+  bool list = false, echo = false;
+};
+
+// Key/value record per scenario: what is printed, stored and compared
+using Metrics = std::map<std::string, std::string>;
+
+// ===== Synthetic traces =====
+class Gen {
+ public:
+  Gen(const std::string &name, unsigned seed) : rng_(seed) { t_.name = name; }
+
+  uint64_t us(uint64_t lo, uint64_t hi) { return std::uniform_int_distribution<uint64_t>(lo, hi)(rng_); }
+  int pick(int n) { return std::uniform_int_distribution<int>(1, n)(rng_); }
+  void cmd(uint64_t at, const std::string &s) { t_.actions.push_back({at, Action::CMD, 0, s}); }
+  void press(uint64_t at, int ch) { t_.actions.push_back({at, Action::PRESS, ch, {}}); }
+  void release(uint64_t at, int ch) { t_.actions.push_back({at, Action::RELEASE, ch, {}}); }
+
+  // Contact chatter: `bounces` short closures before the switch stays closed
+  uint64_t insert(uint64_t at, int ch, int bounces) {
+    for (int b = 0; b < bounces; ++b) {
+      press(at, ch);
+      at += us(200, 3000);
+      release(at, ch);
+      at += us(200, 3000);
+    }
+    press(at, ch);
+    return at;
+  }
+
+  Trace done() {
+    std::stable_sort(t_.actions.begin(), t_.actions.end(),
+                     [](const Action &a, const Action &b) { return a.at < b.at; });
+    return t_;
+  }
+
+ private:
+  std::mt19937 rng_;
+  Trace t_;
+};
+
+std::string chList(int from, int to) {
+  std::string s;
+  for (int ch = from; ch <= to; ++ch) s += (s.empty() ? "" : ",") + std::to_string(ch);
+  return s;
+}
+
+// MONITOR of channels 1..n; past 40 channels as the range the station
+// compacts such a list to (the full list no longer fits one frame)
+std::string monitorAll(int n) {
+  return "MONITOR " + (n > 40 ? "1-" + std::to_string(n) : chList(1, n));
+}
+
+// MONITOR 1..n, then insert every channel gapUs apart; `check` (if any) is
+// sent before the auto-final hold expires
+Trace insertScenario(const std::string &name, int n, uint64_t gapUs, int bounces, const char *check) {
+  Gen g(name, 1);
+  g.cmd(0, monitorAll(n));
+  uint64_t at = 50000, last = 0;
+  for (int ch = 1; ch <= n; ++ch, at += gapUs) last = g.insert(at, ch, bounces);
+  if (check) g.cmd(last + 30000, check);
+  return g.done();
+}
+
+// MONITOR 1..40, insert 1..20, CHECK those once they have been quiet for idleUs
+Trace checkSubsetScenario(const std::string &name, uint64_t idleUs) {
+  Gen g(name, 4);
+  g.cmd(0, "MONITOR " + chList(1, 40));
+  uint64_t at = 50000, last = 0;
+  for (int ch = 1; ch <= 20; ++ch, at += 10000) last = g.insert(at, ch, 2);
+  g.cmd(last + idleUs, "CHECK " + chList(1, 20));
+  return g.done();
+}
+
+// Normals 1..4 held, contactless 5..8 pulsed for pulseUs each
+Trace latchScenario(const std::string &name, uint64_t pulseUs) {
+  Gen g(name, 2);
+  g.cmd(0, "MONITOR 1,2,3,4 LATCH(4)=[5,6,7,8]");
+  uint64_t at = 50000;
+  for (int ch = 1; ch <= 4; ++ch, at += 20000) g.insert(at, ch, 1);
+  for (int ch = 5; ch <= 8; ++ch, at += 20000) {
+    g.press(at, ch);
+    g.release(at + pulseUs, ch);
+  }
+  return g.done();
+}
+
+// Random toggles (some with chatter) on n monitored channels, then insert all
+Trace stormScenario(const std::string &name, int n, uint64_t durationUs) {
+  Gen g(name, 3);
+  g.cmd(0, monitorAll(n));
+  std::vector<bool> closed(n + 1, false);
+  std::vector<uint64_t> busyUntil(n + 1, 0);
+  uint64_t at = 50000;
+  for (const uint64_t end = at + durationUs; at < end; at += g.us(200, 2000)) {
+    const int ch = g.pick(n);
+    if (busyUntil[ch] > at) continue;
+    uint64_t t = at;
+    if (g.pick(4) == 1) {  // chatter before the new level
+      closed[ch] ? g.release(t, ch) : g.press(t, ch);
+      t += 300;
+      closed[ch] ? g.press(t, ch) : g.release(t, ch);
+      t += 300;
+    }
+    closed[ch] = !closed[ch];
+    closed[ch] ? g.press(t, ch) : g.release(t, ch);
+    busyUntil[ch] = t + 1;
+  }
+  for (int ch = 1; ch <= n; ++ch) {
+    if (closed[ch]) continue;
+    at = std::max(at, busyUntil[ch]) + 2000;
+    g.press(at, ch);
+  }
+  return g.done();
+}
+
+struct Scenario {
+  const char *name;
+  const char *what;
+  int channels;  // highest channel used; skipped on smaller boards
+  Trace (*make)();
+};
+
+const Scenario kScenarios[] = {
+    {"insert8", "8 channels, clean contacts, 20 ms apart", 8,
+     [] { return insertScenario("insert8", 8, 20000, 0, nullptr); }},
+    {"insert40-bounce", "40 channels, 4 chatter pulses each, 10 ms apart", 40,
+     [] { return insertScenario("insert40-bounce", 40, 10000, 4, nullptr); }},
+    {"check40", "40 channels with chatter, then CHECK (FINAL_CHECK sampling)", 40,
+     [] { return insertScenario("check40", 40, 10000, 2, "CHECK"); }},
+    {"check40-fast", "as check40, with a 2x25 ms FINAL_CHECK policy on the CHECK", 40,
+     [] { return insertScenario("check40-fast", 40, 10000, 2, "CHECK SAMPLES=2 SPACING=25"); }},
+    {"check20-settled", "20 of 40 channels inserted, CHECK of those 500 ms later (no sampling needed)", 40,
+     [] { return checkSubsetScenario("check20-settled", 500000); }},
+    {"latch8", "4 normals + 4 contactless pulsed for 60 ms", 8,
+     [] { return latchScenario("latch8", 60000); }},
+    {"latch8-short", "4 normals + 4 contactless pulsed for 12 ms (below CH_DEBOUNCE_MS)", 8,
+     [] { return latchScenario("latch8-short", 12000); }},
+    {"storm40", "3 s of random toggles with chatter on 40 channels, then all inserted", 40,
+     [] { return stormScenario("storm40", 40, 3000000); }},
+    {"insert128-bounce", "128 channels, 2 chatter pulses each, 5 ms apart", 128,
+     [] { return insertScenario("insert128-bounce", 128, 5000, 2, nullptr); }},
+    {"check128", "128 channels with chatter, then CHECK 1-128", 128,
+     [] { return insertScenario("check128", 128, 5000, 2, "CHECK 1-128"); }},
+    {"storm128", "3 s of random toggles with chatter on 128 channels, then all inserted", 128,
+     [] { return stormScenario("storm128", 128, 3000000); }},
+};
+
+// ===== Trace files =====
+bool parseTrace(const std::string &path, Trace &t, std::string &err) {
+  std::ifstream in(path);
+  if (!in) { err = path + ": " + strerror(errno); return false; }
+  const size_t slash = path.find_last_of('/');
+  t.name = path.substr(slash == std::string::npos ? 0 : slash + 1);
+  t.name = t.name.substr(0, t.name.find('.'));
+  std::string line;
+  for (int no = 1; std::getline(in, line); ++no) {
+    line = line.substr(0, line.find('#'));
+    std::istringstream ls(line);
+    uint64_t at;
+    std::string verb;
+    if (!(ls >> at)) {
+      if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+      err = path + ":" + std::to_string(no) + ": expected a time in microseconds";
+      return false;
+    }
+    ls >> verb;
+    if (verb == "press" || verb == "release") {
+      int ch = 0;
+      if (!(ls >> ch) || ch < 1 || ch > bench::hubChannels()) {
+        err = path + ":" + std::to_string(no) + ": bad channel";
+        return false;
+      }
+      t.actions.push_back({at, verb == "press" ? Action::PRESS : Action::RELEASE, ch, {}});
+    } else if (verb == "cmd") {
+      std::string text;
+      std::getline(ls >> std::ws, text);
+      while (!text.empty() && (text.back() == '\r' || text.back() == ' ')) text.pop_back();
+      t.actions.push_back({at, Action::CMD, 0, text});
+    } else {
+      err = path + ":" + std::to_string(no) + ": unknown action '" + verb + "'";
+      return false;
+    }
+  }
+  std::stable_sort(t.actions.begin(), t.actions.end(), [](const Action &a, const Action &b) { return a.at < b.at; });
+  return true;
+}
+
+void dumpTrace(const Trace &t) {
+  printf("# %s\n", t.name.c_str());
+  for (const Action &a : t.actions) {
+    if (a.kind == Action::CMD) printf("%llu cmd %s\n", (unsigned long long)a.at, a.text.c_str());
+    else printf("%llu %s %d\n", (unsigned long long)a.at, a.kind == Action::PRESS ? "press" : "release", a.ch);
+  }
+}
+
+// ===== Replay (runs in the forked child) =====
+Metrics replay(const Trace &t, const Options &o) {
+  sim::Config cfg;
+  cfg.virtualClock = true;
+  cfg.echo = o.echo;
+  sim::configure(cfg);
+  const int hub = sim::addNode(sim::Kind::HUB);
+  sim::attach(hub);
+  static const uint8_t station[6] = {0x02, 0x5A, 0x53, 0x00, 0x00, 0x00};
+
+  std::vector<std::vector<uint8_t>> acks;
+  uint64_t evFrames = 0, evChannels = 0, frames = 0;
+  int64_t resultAt = -1;
+  std::string result = "NONE";
+  bool counting = false;
+  auto bits = [](const uint8_t *m, size_t n) {
+    uint64_t c = 0;
+    for (size_t i = 0; i < n; ++i) c += __builtin_popcount(m[i]);
+    return c;
+  };
+  sim::onFrame([&](int, const uint8_t *, const uint8_t *d, size_t len) {
+    if (!counting) return;
+    frames++;
+    kfb::Header h;
+    if (kfb::parseHeader(d, int(len), h)) {
+      if (h.id) {
+        uint8_t ack[kfb::HEADER_LEN];
+        kfb::putHeader(ack, kfb::FT_ACK, h.id);
+        acks.emplace_back(ack, ack + sizeof(ack));
+      }
+      const uint8_t *p = d + kfb::HEADER_LEN;
+      const size_t plen = len - kfb::HEADER_LEN;
+      if (h.type == kfb::FT_EVENTS && plen >= 2 && plen >= 2 + 4 * size_t(p[1]) && !(p[0] & kfb::EVF_SNAPSHOT)) {
+        evFrames++;
+        evChannels += bits(p + 2, p[1]) + bits(p + 2 + 2 * p[1], p[1]);
+      } else if (h.type == kfb::FT_EVENT) {
+        evFrames++;
+        evChannels++;
+      } else if (h.type == kfb::FT_RESULT && plen >= 1 && resultAt < 0) {
+        resultAt = int64_t(sim::nowUs());
+        result = p[0] ? "SUCCESS" : "FAILURE";
+      }
+      return;
+    }
+    const std::string s(reinterpret_cast<const char *>(d), strnlen(reinterpret_cast<const char *>(d), len));
+    const size_t id = s.find(" ID=");
+    if (id != std::string::npos) {
+      const std::string ack = "ACK " + std::to_string(strtoul(s.c_str() + id + 4, nullptr, 10));
+      acks.emplace_back(ack.begin(), ack.end());
+    }
+    if (s.compare(0, 3, "EV ") == 0) { evFrames++; evChannels++; }
+    if (s.compare(0, 7, "RESULT ") == 0 && resultAt < 0) {
+      resultAt = int64_t(sim::nowUs());
+      result = s.compare(7, 7, "SUCCESS") == 0 ? "SUCCESS" : "FAILURE";
+    }
+  });
+
+  uint64_t base = 0, scans = 0, scanNs = 0, hookNs = 0;
+  size_t next = 0;
+  auto apply = [&](const Action &a) {
+    if (a.kind == Action::CMD) bench::hubReceive(station, reinterpret_cast<const uint8_t *>(a.text.data()), a.text.size());
+    else sim::setSwitch(hub, a.ch - 1, a.kind == Action::PRESS);
+  };
+  sim::onClockStep(bench::hubScanPeriodUs(), [&] {
+    const uint64_t c0 = bench::cpuNs();
+    std::vector<std::vector<uint8_t>> due;
+    due.swap(acks);
+    for (const auto &f : due) bench::hubReceive(station, f.data(), f.size());
+    const uint64_t now = sim::nowUs();
+    for (; counting && next < t.actions.size() && base + t.actions[next].at <= now; ++next) apply(t.actions[next]);
+    scanNs += bench::hubScan();
+    scans++;
+    hookNs += bench::cpuNs() - c0;
+  });
+
+  bench::hubBoot();
+  while (!bench::hubWaitingForMonitor()) bench::hubProtocol();
+  base = sim::nowUs();
+  scans = scanNs = 0;
+  counting = true;
+
+  uint64_t lastAt = 0, lastSwitchAt = 0;
+  for (const Action &a : t.actions) {
+    lastAt = std::max(lastAt, a.at);
+    if (a.kind != Action::CMD) lastSwitchAt = std::max(lastSwitchAt, a.at);
+  }
+  uint64_t protoIters = 0, protoNs = 0;
+  while (resultAt < 0 && sim::nowUs() < base + lastAt + o.timeoutUs) {
+    const uint64_t c0 = bench::cpuNs(), h0 = hookNs;
+    bench::hubProtocol();
+    protoNs += (bench::cpuNs() - c0) - (hookNs - h0);
+    protoIters++;
+  }
+
+  char buf[32];
+  Metrics m;
+  m["result"] = result;
+  m["t_result_us"] = resultAt < 0 ? "-" : std::to_string(resultAt - int64_t(base + lastSwitchAt));
+  m["ev_frames"] = std::to_string(evFrames);
+  m["ev_channels"] = std::to_string(evChannels);
+  m["frames"] = std::to_string(frames);
+  m["scans"] = std::to_string(scans);
+  m["proto_iters"] = std::to_string(protoIters);
+  snprintf(buf, sizeof(buf), "%.1f", scans ? double(scanNs) / scans : 0.0);
+  m["scan_ns"] = buf;
+  snprintf(buf, sizeof(buf), "%.1f", protoIters ? double(protoNs) / protoIters : 0.0);
+  m["proto_ns"] = buf;
+  return m;
+}
+
+std::string serialize(const std::string &name, const Metrics &m) {
+  std::string s = name;
+  for (const auto &kv : m) s += " " + kv.first + "=" + kv.second;
+  return s;
+}
+
+bool deserialize(const std::string &line, std::string &name, Metrics &m) {
+  std::istringstream ls(line);
+  if (!(ls >> name)) return false;
+  for (std::string kv; ls >> kv;) {
+    const size_t eq = kv.find('=');
+    if (eq == std::string::npos) return false;
+    m[kv.substr(0, eq)] = kv.substr(eq + 1);
+  }
+  return true;
+}
+
+// Fresh process per scenario: the firmware globals and the clock start from zero
+bool runIsolated(const Trace &t, const Options &o, Metrics &m) {
+  int fd[2];
+  if (pipe(fd) != 0) return false;
+  fflush(stdout);
+  const pid_t pid = fork();
+  if (pid < 0) return false;
+  if (pid == 0) {
+    close(fd[0]);
+    const std::string line = serialize(t.name, replay(t, o)) + "\n";
+    fflush(stdout);
+    ssize_t w = write(fd[1], line.data(), line.size());
+    _exit(w == ssize_t(line.size()) ? 0 : 1);
+  }
+  close(fd[1]);
+  std::string out;
+  char buf[512];
+  for (ssize_t n; (n = read(fd[0], buf, sizeof(buf))) > 0;) out.append(buf, size_t(n));
+  close(fd[0]);
+  int status = 0;
+  waitpid(pid, &status, 0);
+  std::string name;
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0 && deserialize(out, name, m);
+}
+
+// ===== Baselines =====
+bool loadBaseline(const std::string &path, std::map<std::string, Metrics> &out) {
+  std::ifstream in(path);
+  if (!in) return false;
+  std::string line, name;
+  while (std::getline(in, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    Metrics m;
+    if (deserialize(line, name, m)) out[name] = m;
+  }
+  return true;
+}
+
+bool writeBaseline(const std::string &path, const std::vector<std::pair<std::string, Metrics>> &runs) {
+  FILE *f = fopen(path.c_str(), "w");
+  if (!f) return false;
+  fprintf(f, "# kfb_bench baseline; regenerate with: kfb_bench --write-baseline <this file>\n");
+  fprintf(f, "# scan_ns/proto_ns are host CPU times and only compared with --cpu-tolerance\n");
+  for (const auto &r : runs) fprintf(f, "%s\n", serialize(r.first, r.second).c_str());
+  return fclose(f) == 0;
+}
+
+double num(const Metrics &m, const char *key) {
+  auto it = m.find(key);
+  return it == m.end() || it->second == "-" ? -1 : atof(it->second.c_str());
+}
+
+// Regression rules: a different verdict or event stream, a slower RESULT,
+// more frames on air, and (opt-in) more CPU per scan or protocol iteration
+int compare(const std::string &name, const Metrics &was, const Metrics &now, const Options &o) {
+  int regressions = 0;
+  auto report = [&](bool bad, const char *key, const std::string &detail) {
+    printf("  %-10s %-16s %-12s %s\n", bad ? "REGRESSION" : "improved", name.c_str(), key, detail.c_str());
+    regressions += bad;
+  };
+  auto fmt = [](double a, double b) {
+    char s[96];
+    snprintf(s, sizeof(s), "%.10g -> %.10g", a, b);
+    return std::string(s);
+  };
+  if (was.at("result") != now.at("result")) report(true, "result", was.at("result") + " -> " + now.at("result"));
+  const double tWas = num(was, "t_result_us"), tNow = num(now, "t_result_us");
+  if (tWas >= 0 && tNow >= 0 && tNow != tWas) report(tNow > tWas + double(o.latencyToleranceUs), "t_result_us", fmt(tWas, tNow));
+  if (num(was, "ev_channels") != num(now, "ev_channels"))
+    report(true, "ev_channels", fmt(num(was, "ev_channels"), num(now, "ev_channels")));
+  for (const char *key : {"ev_frames", "frames"})
+    if (num(now, key) != num(was, key)) report(num(now, key) > num(was, key), key, fmt(num(was, key), num(now, key)));
+  if (o.cpuTolerancePct >= 0) {
+    for (const char *key : {"scan_ns", "proto_ns"}) {
+      const double a = num(was, key), b = num(now, key);
+      if (a > 0 && b > a * (1 + o.cpuTolerancePct / 100)) report(true, key, fmt(a, b));
+    }
+  }
+  return regressions;
+}
+
+void usage() {
+  fprintf(stderr,
+          "usage: kfb_bench [--scenario NAME]... [--trace FILE]... [--no-builtin]\n"
+          "                 [--baseline FILE] [--write-baseline FILE] [--cpu-tolerance PCT]\n"
+          "                 [--latency-tolerance-us US] [--timeout-ms MS] [--dump NAME] [--list] [--echo]\n");
+}
+
+bool parseArgs(int argc, char **argv, Options &o) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string a = argv[i];
+    auto next = [&]() -> const char * { return i + 1 < argc ? argv[++i] : nullptr; };
+    const char *v = nullptr;
+    if (a == "--list") { o.list = true; continue; }
+    if (a == "--echo") { o.echo = true; continue; }
+    if (a == "--no-builtin") { o.builtins = false; continue; }
+    if (a == "--help" || a == "-h" || !(v = next())) return false;
+    if (a == "--scenario") o.scenarios.push_back(v);
+    else if (a == "--trace") o.traces.push_back(v);
+    else if (a == "--baseline") o.baseline = v;
+    else if (a == "--write-baseline") o.writeBaseline = v;
+    else if (a == "--cpu-tolerance") o.cpuTolerancePct = atof(v);
+    else if (a == "--latency-tolerance-us") o.latencyToleranceUs = strtoull(v, nullptr, 10);
+    else if (a == "--timeout-ms") o.timeoutUs = strtoull(v, nullptr, 10) * 1000;
+    else if (a == "--dump") o.dump = v;
+    else return false;
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options o;
+  if (!parseArgs(argc, argv, o)) { usage(); return 2; }
+
+  if (o.list) {
+    for (const Scenario &s : kScenarios)
+      printf("%-16s %s%s\n", s.name, s.what, s.channels > bench::hubChannels() ? " (needs a larger board)" : "");
+    return 0;
+  }
+  std::vector<Trace> traces;
+  for (const Scenario &s : kScenarios) {
+    const bool named = std::find(o.scenarios.begin(), o.scenarios.end(), s.name) != o.scenarios.end();
+    const bool wanted = o.scenarios.empty() ? o.builtins : named;
+    if (!(wanted || o.dump == s.name)) continue;
+    if (s.channels > bench::hubChannels()) {
+      if (!named && o.dump != s.name) continue;
+      fprintf(stderr, "kfb_bench: %s needs %d channels, the hub has %d\n", s.name, s.channels, bench::hubChannels());
+      return 2;
+    }
+    traces.push_back(s.make());
+  }
+  if (!o.dump.empty()) {
+    for (const Trace &t : traces)
+      if (t.name == o.dump) { dumpTrace(t); return 0; }
+    fprintf(stderr, "kfb_bench: unknown scenario %s\n", o.dump.c_str());
+    return 2;
+  }
+  for (const std::string &name : o.scenarios) {
+    if (std::none_of(std::begin(kScenarios), std::end(kScenarios), [&](const Scenario &s) { return name == s.name; })) {
+      fprintf(stderr, "kfb_bench: unknown scenario %s (see --list)\n", name.c_str());
+      return 2;
+    }
+  }
+  for (const std::string &path : o.traces) {
+    Trace t;
+    std::string err;
+    if (!parseTrace(path, t, err)) { fprintf(stderr, "kfb_bench: %s\n", err.c_str()); return 2; }
+    traces.push_back(t);
+  }
+
+  std::map<std::string, Metrics> baseline;
+  if (!o.baseline.empty() && !loadBaseline(o.baseline, baseline)) {
+    fprintf(stderr, "kfb_bench: cannot read baseline %s\n", o.baseline.c_str());
+    return 2;
+  }
+
+  printf("%-16s %-8s %11s %9s %11s %7s %7s %8s %8s\n", "scenario", "result", "t_result_ms", "ev_frames",
+         "ev_channels", "frames", "scans", "scan_ns", "proto_ns");
+  std::vector<std::pair<std::string, Metrics>> runs;
+  bool failed = false;
+  for (const Trace &t : traces) {
+    Metrics m;
+    if (!runIsolated(t, o, m)) {
+      printf("%-16s replay failed\n", t.name.c_str());
+      failed = true;
+      continue;
+    }
+    const double tr = num(m, "t_result_us");
+    char tms[16];
+    if (tr < 0) snprintf(tms, sizeof(tms), "-");
+    else snprintf(tms, sizeof(tms), "%.1f", tr / 1000);
+    printf("%-16s %-8s %11s %9s %11s %7s %7s %8s %8s\n", t.name.c_str(), m["result"].c_str(), tms,
+           m["ev_frames"].c_str(), m["ev_channels"].c_str(), m["frames"].c_str(), m["scans"].c_str(),
+           m["scan_ns"].c_str(), m["proto_ns"].c_str());
+    runs.emplace_back(t.name, m);
+  }
+
+  int regressions = 0;
+  if (!o.baseline.empty()) {
+    printf("\nvs %s:\n", o.baseline.c_str());
+    for (const auto &r : runs) {
+      auto it = baseline.find(r.first);
+      if (it == baseline.end()) { printf("  %-10s %s\n", "new", r.first.c_str()); continue; }
+      regressions += compare(r.first, it->second, r.second, o);
+    }
+    printf("bench: %zu scenario(s), %d regression(s)\n", runs.size(), regressions);
+  }
+  if (!o.writeBaseline.empty()) {
+    if (!writeBaseline(o.writeBaseline, runs)) {
+      fprintf(stderr, "kfb_bench: cannot write %s\n", o.writeBaseline.c_str());
+      return 2;
+    }
+    printf("baseline written to %s\n", o.writeBaseline.c_str());
+  }
+  return (failed || regressions) ? 1 : 0;
+}
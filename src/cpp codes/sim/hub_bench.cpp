@@ -0,0 +1,80 @@
+// hub.cpp for kfb_bench: compiled into namespace hub_bench and driven
+// directly by the bench thread instead of the scanner and protocol tasks.
+#include "sim_firmware.h"
+#include "bench.h"
+
+#include <time.h>
+
+namespace hub_bench {
+
+#include "../hub.cpp"
+
+static bool simSwitchPin(int ch, sim::SwitchPin &out) {
+  if (ch < 0 || ch >= CHANNEL_COUNT) return false;
+  const ChannelPins &p = pinsMap[ch];
+  const kfb::ExpanderDesc &e = BOARD.expanders[p.mcpIndex];
+  out = {e.bus, e.addr, p.swPin};
+  return true;
+}
+
+static sim::Firmware simFirmware() {
+  sim::Firmware fw{sim::Kind::HUB, 0, nullptr, nullptr, CHANNEL_COUNT, &simSwitchPin, {}, -1};
+  for (size_t i = 0; i < EXPANDER_COUNT; ++i) fw.expanders.push_back({BOARD.expanders[i].bus, BOARD.expanders[i].addr, 0});
+  return fw;
+}
+
+static const sim::Registrar simRegistrar(simFirmware());
+
+} // namespace hub_bench
+
+namespace bench {
+
+using namespace hub_bench;
+
+// setup() without the LED self-test, Wi-Fi/ESP-NOW callbacks and tasks
+void hubBoot() {
+  Serial.begin(115200);
+  String mac = WiFi.macAddress();
+  mac.toCharArray(BOARD_MAC, sizeof(BOARD_MAC));
+  pinMode(BTN_PIN, INPUT_PULLUP);
+  initExpanders();
+  scanInputs();
+  busOwnersRunning = true;  // hubScan() plays every bus owner
+  esp_now_init();
+  rxQueue = xQueueCreate(RX_QUEUE_LEN, sizeof(RxItem));
+  state = State::SELF_CHECK;
+  protoTaskHandle = xTaskGetCurrentTaskHandle();
+}
+
+void hubReceive(const uint8_t mac[6], const uint8_t *data, size_t len) {
+  uint8_t src[6], des[6];
+  memcpy(src, mac, 6);
+  memcpy(des, sim::macOf(0), 6);
+  wifi_pkt_rx_ctrl_t ctrl{-50, ESPNOW_CHANNEL};
+  esp_now_recv_info_t info{src, des, &ctrl};
+  onRecv(&info, data, int(len));
+}
+
+// SW_IRQ_MODE is not modelled: the bench always polls at SCAN_RATE_HZ
+uint64_t hubScan() {
+  for (int bus = 0; bus < kfb::BUSES; ++bus) serviceBusCommands(bus);
+  const ChannelSet raw = readPorts();  // bus access is not part of the measured cost
+  const uint64_t t0 = cpuNs();
+  const ScanResult r = scanStep(raw, ChannelSet(), millis());
+  const uint64_t spent = cpuNs() - t0;
+  if (r.stableChanged && protoTaskHandle) xTaskNotifyGive(protoTaskHandle);
+  return spent;
+}
+
+void hubProtocol() { protocolLoop(); }
+bool hubWaitingForMonitor() { return state == State::WAIT_FOR_TARGET; }
+uint32_t hubScanPeriodUs() { return uint32_t(SCAN_PERIOD_TICKS * 1000000ull / configTICK_RATE_HZ); }
+int hubChannels() { return CHANNEL_COUNT; }
+
+uint64_t cpuNs() {
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return uint64_t(ts.tv_sec) * 1000000000ull + uint64_t(ts.tv_nsec);
+}
+
+} // namespace bench
@@ -0,0 +1,25 @@
+// One simulated hub: hub.cpp compiled into namespace hub_<SIM_SLOT>
+#include "sim_firmware.h"
+
+namespace SIM_CAT(hub_, SIM_SLOT) {
+
+#include "../hub.cpp"
+
+static bool simSwitchPin(int ch, sim::SwitchPin &out) {
+  if (ch < 0 || ch >= CHANNEL_COUNT) return false;
+  const ChannelPins &p = pinsMap[ch];
+  const kfb::ExpanderDesc &e = BOARD.expanders[p.mcpIndex];
+  out = {e.bus, e.addr, p.swPin};
+  return true;
+}
+
+static sim::Firmware simFirmware() {
+  sim::Firmware fw{sim::Kind::HUB, SIM_SLOT, &setup, &loop, CHANNEL_COUNT, &simSwitchPin, {},
+                   SW_IRQ_MODE ? SW_INT_PIN : -1};
+  for (size_t i = 0; i < EXPANDER_COUNT; ++i) fw.expanders.push_back({BOARD.expanders[i].bus, BOARD.expanders[i].addr, 0});
+  return fw;
+}
+
+static const sim::Registrar simRegistrar(simFirmware());
+
+} // namespace
@@ -0,0 +1,37 @@
+#pragma once
+// Host simulation: register-level MCP23017 model behind the board's TwoWire bus
+#include "Wire.h"
+
+#define MCP23XXX_INT_ERR 255
+
+class Adafruit_MCP23X17 {
+ public:
+  bool begin_I2C(uint8_t addr = 0x20, TwoWire *wire = &Wire);
+
+  void pinMode(uint8_t pin, uint8_t mode);
+  uint8_t digitalRead(uint8_t pin);
+  void digitalWrite(uint8_t pin, uint8_t value);
+
+  uint8_t readGPIOA();
+  uint8_t readGPIOB();
+  uint16_t readGPIOAB();
+  void writeGPIOA(uint8_t value);
+  void writeGPIOB(uint8_t value);
+  void writeGPIOAB(uint16_t value);
+
+  void setupInterrupts(bool mirroring, bool openDrain, uint8_t polarity);
+  void setupInterruptPin(uint8_t pin, uint8_t mode = CHANGE);
+  void disableInterruptPin(uint8_t pin);
+  void clearInterrupts();
+  uint8_t getLastInterruptPin();
+  uint16_t getCapturedInterrupt();
+
+ private:
+  uint8_t readReg(uint8_t reg);
+  void writeReg(uint8_t reg, uint8_t value);
+  uint16_t readReg16(uint8_t reg);
+  void writeReg16(uint8_t reg, uint16_t value);
+
+  TwoWire *wire_ = nullptr;
+  uint8_t addr_ = 0;
+};
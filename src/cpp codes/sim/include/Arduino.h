@@ -0,0 +1,144 @@
+#pragma once
+// Host simulation of the Arduino-ESP32 core subset used by hub.cpp and
+// station.cpp. Every board runs in the same process, so the global objects
+// (Serial, WiFi, Wire, ESP) route each call to the board of the calling thread.
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <algorithm>
+#include <string>
+#include "esp_idf_version.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define ESP_ARDUINO_VERSION_MAJOR 3
+#define ESP_ARDUINO_VERSION_MINOR 0
+#define ESP_ARDUINO_VERSION_PATCH 0
+
+#define HIGH 0x1
+#define LOW  0x0
+#define INPUT        0x01
+#define OUTPUT       0x03
+#define PULLUP       0x04
+#define INPUT_PULLUP 0x05
+#define RISING  0x01
+#define FALLING 0x02
+#define CHANGE  0x03
+#define DEC 10
+#define HEX 16
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+using std::min;
+using std::max;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t val);
+void attachInterrupt(uint8_t pin, void (*isr)(), int mode);
+void detachInterrupt(uint8_t pin);
+inline int digitalPinToInterrupt(uint8_t pin) { return pin; }
+
+class String {
+ public:
+  String() = default;
+  String(const char *s) : s_(s ? s : "") {}
+  String(const std::string &s) : s_(s) {}
+  explicit String(char c) : s_(1, c) {}
+  explicit String(int v) : s_(std::to_string(v)) {}
+  explicit String(unsigned v) : s_(std::to_string(v)) {}
+  explicit String(long v) : s_(std::to_string(v)) {}
+  explicit String(unsigned long v) : s_(std::to_string(v)) {}
+
+  const char *c_str() const { return s_.c_str(); }
+  unsigned length() const { return (unsigned)s_.size(); }
+  bool isEmpty() const { return s_.empty(); }
+  char operator[](unsigned i) const { return i < s_.size() ? s_[i] : '\0'; }
+  bool operator==(const String &o) const { return s_ == o.s_; }
+  bool operator==(const char *o) const { return s_ == (o ? o : ""); }
+  String &operator+=(const String &o) { s_ += o.s_; return *this; }
+  String &operator+=(const char *o) { s_ += o ? o : ""; return *this; }
+  String &operator+=(char c) { s_ += c; return *this; }
+  String operator+(const String &o) const { return String(s_ + o.s_); }
+  String operator+(const char *o) const { return String(s_ + (o ? o : "")); }
+  int indexOf(char c, unsigned from = 0) const { auto p = s_.find(c, from); return p == std::string::npos ? -1 : (int)p; }
+  int indexOf(const char *t, unsigned from = 0) const { auto p = s_.find(t, from); return p == std::string::npos ? -1 : (int)p; }
+  String substring(unsigned from, unsigned to = ~0u) const {
+    if (from >= s_.size()) return String();
+    return String(s_.substr(from, to == ~0u ? std::string::npos : to - from));
+  }
+  bool startsWith(const char *p) const { return s_.rfind(p, 0) == 0; }
+  void trim() {
+    const auto b = s_.find_first_not_of(" \t\r\n");
+    const auto e = s_.find_last_not_of(" \t\r\n");
+    s_ = b == std::string::npos ? std::string() : s_.substr(b, e - b + 1);
+  }
+  void toUpperCase() { for (auto &c : s_) c = (char)toupper((unsigned char)c); }
+  void toCharArray(char *buf, unsigned n) const {
+    if (!n) return;
+    strncpy(buf, s_.c_str(), n - 1);
+    buf[n - 1] = '\0';
+  }
+  long toInt() const { return strtol(s_.c_str(), nullptr, 10); }
+
+ private:
+  std::string s_;
+};
+
+class HardwareSerial {
+ public:
+  void begin(unsigned long baud, uint32_t config = 0, int8_t rx = -1, int8_t tx = -1);
+  void end() {}
+  void updateBaudRate(unsigned long baud);
+  void setTimeout(unsigned long ms) { (void)ms; }
+  void setRxBufferSize(size_t n) { (void)n; }
+  void setTxBufferSize(size_t n) { (void)n; }
+  operator bool() const { return true; }
+
+  int available();
+  int read();
+  int peek();
+  int availableForWrite() { return 256; }
+  void flush() {}
+  String readStringUntil(char term);
+
+  size_t write(uint8_t b) { return write(&b, 1); }
+  size_t write(const uint8_t *buf, size_t n);
+  size_t write(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+
+  size_t print(const char *s) { return write(s); }
+  size_t print(const String &s) { return write(s.c_str()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int v, int base = DEC) { return print((long)v, base); }
+  size_t print(unsigned v, int base = DEC) { return print((unsigned long)v, base); }
+  size_t print(long v, int base = DEC);
+  size_t print(unsigned long v, int base = DEC);
+  size_t print(double v, int digits = 2);
+
+  size_t println() { return write("\r\n"); }
+  template <class T> size_t println(const T &v) { size_t n = print(v); return n + println(); }
+  template <class T> size_t println(const T &v, int fmt) { size_t n = print(v, fmt); return n + println(); }
+
+  size_t printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+};
+extern HardwareSerial Serial;
+
+class EspClass {
+ public:
+  uint32_t getCycleCount();
+  uint32_t getCpuFreqMHz() { return 240; }
+  uint32_t getFreeHeap() { return 200 * 1024; }
+  void restart();
+};
+extern EspClass ESP;
@@ -0,0 +1,13 @@
+#pragma once
+#include "Arduino.h"
+#include "esp_wifi.h"
+
+typedef enum { WIFI_OFF, WIFI_STA, WIFI_AP, WIFI_AP_STA } wifi_mode_t;
+
+class WiFiClass {
+ public:
+  bool mode(wifi_mode_t m) { (void)m; return true; }
+  bool disconnect(bool wifiOff = false, bool eraseAp = false) { (void)wifiOff; (void)eraseAp; return true; }
+  String macAddress();
+};
+extern WiFiClass WiFi;
@@ -0,0 +1,28 @@
+#pragma once
+// Host simulation: each board has its own I2C buses with simulated MCP23017s
+#include "Arduino.h"
+
+class TwoWire {
+ public:
+  explicit TwoWire(uint8_t bus) : bus_(bus) {}
+  bool begin(int sda = -1, int scl = -1, uint32_t freq = 0);
+  bool end() { return true; }
+  bool setClock(uint32_t freq);
+  uint32_t getClock();
+  void setTimeOut(uint16_t ms) { (void)ms; }
+
+  void beginTransmission(uint8_t addr);
+  size_t write(uint8_t b);
+  size_t write(const uint8_t *buf, size_t n);
+  uint8_t endTransmission(bool sendStop = true);
+  uint8_t requestFrom(uint8_t addr, uint8_t n, bool sendStop = true);
+  int available();
+  int read();
+
+  uint8_t bus() const { return bus_; }
+
+ private:
+  uint8_t bus_;
+};
+extern TwoWire Wire;
+extern TwoWire Wire1;
@@ -0,0 +1,5 @@
+#pragma once
+// Host simulation mirrors Arduino-ESP32 v3 / ESP-IDF v5 callback signatures
+#define ESP_IDF_VERSION_MAJOR 5
+#define ESP_IDF_VERSION_MINOR 1
+#define ESP_IDF_VERSION_PATCH 0
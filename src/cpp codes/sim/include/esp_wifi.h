@@ -0,0 +1,10 @@
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum { WIFI_PS_NONE, WIFI_PS_MIN_MODEM, WIFI_PS_MAX_MODEM } wifi_ps_type_t;
+typedef enum { WIFI_SECOND_CHAN_NONE, WIFI_SECOND_CHAN_ABOVE, WIFI_SECOND_CHAN_BELOW } wifi_second_chan_t;
+typedef enum { WIFI_IF_STA, WIFI_IF_AP } wifi_interface_t;
+
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t type);
+esp_err_t esp_wifi_set_channel(uint8_t primary, wifi_second_chan_t second);
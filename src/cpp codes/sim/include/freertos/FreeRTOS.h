@@ -0,0 +1,35 @@
+#pragma once
+// Host simulation of the FreeRTOS subset the firmware uses. Tasks are
+// std::threads, ticks are milliseconds of the simulation clock and critical
+// sections are spinlocks (mutual exclusion only, interrupts keep running).
+#include <stdint.h>
+#include <atomic>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+
+#define pdTRUE  1
+#define pdFALSE 0
+#define pdPASS  pdTRUE
+#define pdFAIL  pdFALSE
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define configTICK_RATE_HZ 1000
+#define portTICK_PERIOD_MS (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+#define tskNO_AFFINITY 0x7FFFFFFF
+
+struct portMUX_TYPE {
+  std::atomic<bool> locked;
+};
+#define portMUX_INITIALIZER_UNLOCKED {false}
+
+void vPortEnterCritical(portMUX_TYPE *mux);
+void vPortExitCritical(portMUX_TYPE *mux);
+#define portENTER_CRITICAL(mux)     vPortEnterCritical(mux)
+#define portEXIT_CRITICAL(mux)      vPortExitCritical(mux)
+#define portENTER_CRITICAL_ISR(mux) vPortEnterCritical(mux)
+#define portEXIT_CRITICAL_ISR(mux)  vPortExitCritical(mux)
+#define portYIELD_FROM_ISR(woken)   ((void)(woken))
+
+BaseType_t xPortGetCoreID();
@@ -0,0 +1,12 @@
+#pragma once
+#include "FreeRTOS.h"
+
+typedef void *QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+void vQueueDelete(QueueHandle_t q);
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t wait);
+BaseType_t xQueueSendFromISR(QueueHandle_t q, const void *item, BaseType_t *woken);
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t wait);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q);
+#define xQueueSendToBack xQueueSend
@@ -0,0 +1,111 @@
+#pragma once
+// Host-native simulation of hub.cpp / station.cpp boards.
+//
+// The firmware sources are compiled unchanged against the fake SDK headers in
+// sim/include. CMake builds hub_node.cpp SIM_MAX_HUBS times and
+// station_node.cpp SIM_MAX_STATIONS times, each wrapping the firmware in its
+// own namespace, so every simulated board has its own copy of the globals.
+// Boards run on real threads against one wall clock; ESP-NOW frames travel
+// through an in-process radio with loss, latency and shared airtime.
+//
+// With Config::virtualClock a single driver thread attach()es to a board and
+// calls firmware code directly; time only moves when that thread sleeps, so
+// runs are deterministic (kfb_bench).
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace sim {
+
+enum class Kind { HUB, STATION };
+
+struct SwitchPin {
+  uint8_t bus;   // 0 = Wire, 1 = Wire1
+  uint8_t addr;  // expander I2C address
+  uint8_t pin;   // 0..15, GPA0 = 0
+};
+
+// One compiled firmware instance; registered from the *_node.cpp wrappers
+struct Firmware {
+  Kind kind;
+  int slot;
+  void (*setup)();
+  void (*loop)();
+  int channels;                                 // hub: switch channels, station: 0
+  bool (*switchPin)(int ch, SwitchPin &out);    // hub: 0-based channel -> expander pin
+  std::vector<SwitchPin> expanders;             // MCP23017s present on the board (pin unused)
+  int intPin;                                   // GPIO wired to the expanders' INT, -1 = none
+};
+
+struct Registrar {
+  explicit Registrar(const Firmware &fw);
+};
+
+struct RadioConfig {
+  double lossRate = 0.0;          // per attempt and receiver
+  int macRetries = 0;             // extra link-layer attempts for unicast
+  uint32_t latencyUs = 300;       // end of airtime -> receive callback
+  uint32_t jitterUs = 0;          // uniform 0..jitterUs on top of latencyUs
+  uint32_t airtimeBaseUs = 100;   // preamble, MAC header and ACK per attempt
+  uint32_t airtimeUsPerByte = 8;  // 1 Mbps
+  uint32_t txQueueDepth = 16;     // frames in flight per board before ESP_ERR_ESPNOW_NO_MEM
+  uint64_t seed = 1;
+};
+
+struct RadioStats {
+  uint64_t frames = 0;       // esp_now_send() calls accepted
+  uint64_t attempts = 0;     // on-air attempts including link-layer retries
+  uint64_t delivered = 0;    // receive callbacks scheduled
+  uint64_t lost = 0;         // attempts lost (per receiver for broadcast)
+  uint64_t rejected = 0;     // esp_now_send() errors
+  uint64_t bytes = 0;        // payload bytes accepted
+  uint64_t airtimeUs = 0;    // medium busy time
+  uint64_t maxWaitUs = 0;    // longest wait for the medium
+};
+
+struct Config {
+  RadioConfig radio;
+  bool i2cTiming = true;     // I2C transactions take 9 bit times per byte
+  uint32_t i2cMaxHz = 0;     // wiring limit: faster transfers alternately NACK and flip a data bit; 0 = none
+  bool serialTiming = true;  // Serial output drains at the configured baud rate
+  bool echo = false;         // copy every serial line to stdout
+  bool virtualClock = false; // time advances only through sleeps (single driver thread, no start())
+};
+
+// Serial line from a board; atUs = when its last byte left the UART
+using LineFn = std::function<void(int node, uint64_t atUs, const std::string &line)>;
+// Frame accepted by esp_now_send() on a board
+using FrameFn = std::function<void(int node, const uint8_t *dest, const uint8_t *data, size_t len)>;
+
+void configure(const Config &cfg);
+const Config &config();
+void onLine(LineFn fn);
+void onFrame(FrameFn fn);
+
+// Virtual clock: fn runs each time a sleep crosses a multiple of stepUs.
+// Sleeps made from inside fn only move the clock.
+void onClockStep(uint64_t stepUs, std::function<void()> fn);
+
+// Claims the next free firmware slot of that kind; -1 when all are in use.
+// A slot boots once per process: the firmware globals are never reset.
+int addNode(Kind kind);
+int nodeCount();
+Kind kindOf(int node);
+const uint8_t *macOf(int node);
+std::string macString(int node);
+int channelsOf(int node);
+
+void start(int node);  // setup() then loop() on the board's loop task
+void attach(int node); // run firmware code on the calling thread as that board's task
+void stopAll();        // stop every task and the radio, join all threads
+
+void serialInput(int node, const std::string &line);  // host -> board, "\n" appended
+void setSwitch(int node, int ch, bool pressed);       // hub harness, 0-based channel
+void setPin(int node, int pin, bool high);            // board GPIO driven from outside
+
+RadioStats radioStats();
+uint64_t nowUs();
+void sleepUs(uint64_t us);
+
+} // namespace sim
@@ -0,0 +1,1293 @@
+// Simulation runtime: board registry, fake Arduino/FreeRTOS/ESP-NOW/I2C
+// implementations and the virtual radio.
+#include "sim.h"
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <Wire.h>
+#include <Adafruit_MCP23X17.h>
+#include <esp_now.h>
+#include <esp_wifi.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <thread>
+
+namespace sim {
+
+// Thrown from blocking calls once the board is stopping; unwinds its task
+struct TaskExit {};
+
+struct Node;
+
+struct Task {
+  Node *node = nullptr;
+  std::string name;
+  int core = 0;
+  std::thread th;
+  std::mutex m;
+  std::condition_variable cv;
+  uint32_t notify = 0;
+};
+
+// MCP23017, IOCON.BANK = 0 register layout
+enum : uint8_t {
+  R_IODIR = 0x00, R_IPOL = 0x02, R_GPINTEN = 0x04, R_DEFVAL = 0x06, R_INTCON = 0x08,
+  R_IOCON = 0x0A, R_GPPU = 0x0C, R_INTF = 0x0E, R_INTCAP = 0x10, R_GPIO = 0x12, R_OLAT = 0x14,
+  R_COUNT = 0x16,
+};
+
+struct Mcp23017 {
+  uint8_t reg[R_COUNT] = {};
+  uint16_t closed = 0;  // switches pulling a pin to GND
+  uint8_t ptr = 0;
+
+  Mcp23017() { reg[R_IODIR] = reg[R_IODIR + 1] = 0xFF; }
+  uint16_t get16(uint8_t r) const { return uint16_t(reg[r] | (reg[r + 1] << 8)); }
+  void set16(uint8_t r, uint16_t v) { reg[r] = uint8_t(v); reg[r + 1] = uint8_t(v >> 8); }
+  uint16_t levels() const {
+    const uint16_t in = get16(R_IODIR);
+    return uint16_t((get16(R_OLAT) & ~in) | (~closed & in));  // inputs idle high (pull-up)
+  }
+  bool intActive() const { return get16(R_INTF) != 0; }
+
+  uint8_t read(uint8_t r) {
+    if (r == R_GPIO || r == R_GPIO + 1) {
+      const uint16_t v = uint16_t(levels() ^ (get16(R_IPOL) & get16(R_IODIR)));
+      reg[R_INTF + (r - R_GPIO)] = 0;
+      return uint8_t(r == R_GPIO ? v : v >> 8);
+    }
+    if (r == R_INTCAP || r == R_INTCAP + 1) {
+      const uint8_t v = reg[r];
+      reg[R_INTF + (r - R_INTCAP)] = 0;
+      return v;
+    }
+    return reg[r];
+  }
+  void write(uint8_t r, uint8_t v) {
+    if (r == R_GPIO || r == R_GPIO + 1) r = uint8_t(R_OLAT + (r - R_GPIO));
+    if (r == R_INTF || r == R_INTF + 1 || r == R_INTCAP || r == R_INTCAP + 1) return;  // read-only
+    if (r == R_IOCON || r == R_IOCON + 1) { reg[R_IOCON] = reg[R_IOCON + 1] = v; return; }
+    reg[r] = v;
+  }
+  // Input change: raise INTF/INTCAP per port like the part does (first change wins)
+  void inputsChanged(uint16_t before) {
+    const uint16_t now = levels();
+    const uint16_t en = get16(R_GPINTEN) & get16(R_IODIR);
+    const uint16_t cmp = get16(R_INTCON);
+    const uint16_t hit = en & (uint16_t(~cmp & (before ^ now)) | uint16_t(cmp & (now ^ get16(R_DEFVAL))));
+    for (int port = 0; port < 2; ++port) {
+      const uint8_t bits = uint8_t(hit >> (port * 8));
+      if (!bits || reg[R_INTF + port]) continue;
+      reg[R_INTF + port] = bits;
+      reg[R_INTCAP + port] = uint8_t(now >> (port * 8));
+    }
+  }
+};
+
+struct I2cBus {
+  uint32_t clock = 100000;
+  std::map<uint8_t, Mcp23017> devices;
+  uint8_t addr = 0;
+  std::vector<uint8_t> tx;
+  std::deque<uint8_t> rx;
+  uint32_t overspeed = 0;  // transfers above Config::i2cMaxHz
+};
+
+struct WifiEvent {
+  bool status;  // true: send callback, false: receive callback
+  bool ok;
+  uint8_t src[6], des[6];
+  std::vector<uint8_t> data;
+};
+
+struct Node {
+  int id = 0;
+  const Firmware *fw = nullptr;
+  uint8_t mac[6] = {};
+  std::string macStr;
+  std::atomic<bool> stop{false};
+  bool started = false;
+
+  // Serial
+  std::mutex inMu, outMu;
+  std::deque<uint8_t> serIn;
+  std::string outLine;
+  unsigned long baud = 115200;
+  uint64_t txFreeAt = 0;
+
+  // GPIO and I2C; hwMu guards both (harness thread vs board tasks)
+  std::mutex hwMu;
+  std::map<int, bool> gpio;
+  std::map<int, std::pair<void (*)(), int>> isr;
+  bool intLine = true;
+  I2cBus i2c[2];
+
+  // ESP-NOW
+  std::mutex nowMu;
+  bool nowInit = false;
+  uint8_t channel = 1;
+  std::vector<std::array<uint8_t, 6>> peers;
+  esp_now_recv_cb_t recvCb = nullptr;
+  esp_now_send_cb_t sendCb = nullptr;
+  uint32_t txPending = 0;
+
+  // Wi-Fi task: delivers radio callbacks in order
+  std::mutex wifiMu;
+  std::condition_variable wifiCv;
+  std::deque<WifiEvent> wifiQ;
+  std::thread wifiTh;
+
+  std::mutex tasksMu;
+  std::vector<std::unique_ptr<Task>> tasks;
+  std::vector<std::shared_ptr<void>> objects;  // queues and semaphores
+};
+
+struct RadioEvent {
+  uint64_t at, seq;
+  int node;
+  WifiEvent ev;
+  bool operator>(const RadioEvent &o) const { return at != o.at ? at > o.at : seq > o.seq; }
+};
+
+namespace {
+
+const auto epoch = std::chrono::steady_clock::now();
+
+std::vector<const Firmware *> &registry() {
+  static std::vector<const Firmware *> r;
+  return r;
+}
+
+Config cfg;
+LineFn lineFn;
+FrameFn frameFn;
+std::mutex nodesMu;
+std::vector<std::unique_ptr<Node>> nodes;
+
+thread_local Node *tlNode = nullptr;
+thread_local Task *tlTask = nullptr;
+
+// Virtual clock (Config::virtualClock); only the attached driver thread moves it
+std::atomic<uint64_t> vNow{0};
+uint64_t vStepUs = 1000;
+std::function<void()> vStepFn;
+bool vInStep = false;
+
+void advanceTo(uint64_t t) {
+  while (vNow.load() < t) {
+    const uint64_t next = (vNow.load() / vStepUs + 1) * vStepUs;
+    if (next > t) { vNow = t; return; }
+    vNow = next;
+    if (vStepFn && !vInStep) {
+      vInStep = true;
+      vStepFn();
+      vInStep = false;
+    }
+  }
+}
+
+struct Radio {
+  std::mutex m;
+  std::condition_variable cv;
+  std::priority_queue<RadioEvent, std::vector<RadioEvent>, std::greater<RadioEvent>> q;
+  uint64_t seq = 0;
+  uint64_t mediumFreeAt[15] = {};
+  std::mt19937_64 rng{1};
+  RadioStats stats;
+  std::thread th;
+  bool running = false, stop = false;
+} radio;
+
+Node *node(int id) {
+  std::lock_guard<std::mutex> lk(nodesMu);
+  return id >= 0 && id < (int)nodes.size() ? nodes[id].get() : nullptr;
+}
+
+Node *self() {
+  if (!tlNode) { fprintf(stderr, "sim: firmware call outside a board thread\n"); abort(); }
+  return tlNode;
+}
+
+void checkStop() {
+  if (tlNode && tlNode->stop.load(std::memory_order_relaxed)) throw TaskExit{};
+}
+
+// Sleep in short slices so a stopping board unwinds promptly
+void sleepUntilUs(uint64_t t) {
+  if (cfg.virtualClock) { advanceTo(t); return; }
+  for (;;) {
+    checkStop();
+    const uint64_t now = nowUs();
+    if (now >= t) return;
+    std::this_thread::sleep_for(std::chrono::microseconds(std::min<uint64_t>(t - now, 5000)));
+  }
+}
+
+// Wait on cv until pred() or the tick timeout; false on timeout
+template <class Pred>
+bool waitTicks(std::unique_lock<std::mutex> &lk, std::condition_variable &cv, TickType_t ticks, Pred pred) {
+  const bool forever = ticks == portMAX_DELAY;
+  const uint64_t deadline = nowUs() + uint64_t(ticks) * 1000000 / configTICK_RATE_HZ;
+  if (cfg.virtualClock) {
+    // Step the clock; the step hook may satisfy pred (it takes this lock itself)
+    while (!pred()) {
+      if ((!forever && vNow.load() >= deadline) || vInStep) return false;
+      const uint64_t next = (vNow.load() / vStepUs + 1) * vStepUs;
+      lk.unlock();
+      advanceTo(forever ? next : std::min(next, deadline));
+      lk.lock();
+    }
+    return true;
+  }
+  while (!pred()) {
+    if (tlNode && tlNode->stop.load(std::memory_order_relaxed)) throw TaskExit{};
+    const uint64_t now = nowUs();
+    if (!forever && now >= deadline) return false;
+    const uint64_t slice = forever ? 5000 : std::min<uint64_t>(deadline - now, 5000);
+    cv.wait_for(lk, std::chrono::microseconds(slice));
+  }
+  return true;
+}
+
+void emitLine(Node *n, uint64_t at, const std::string &line) {
+  if (cfg.echo) printf("[%s%d] %s\n", n->fw->kind == Kind::HUB ? "hub" : "sta", n->fw->slot, line.c_str());
+  if (lineFn) lineFn(n->id, at, line);
+}
+
+// Lines are timestamped when their last byte leaves the UART (10 bit times
+// per byte); write() blocks once more than the 256-byte TX FIFO is queued.
+// Under the virtual clock UART and I2C time run in parallel and cost nothing.
+void serialOut(Node *n, const uint8_t *d, size_t len) {
+  uint64_t now = nowUs(), blockUntil = 0;
+  {
+    std::lock_guard<std::mutex> lk(n->outMu);
+    uint64_t at = now;
+    if (cfg.serialTiming && !cfg.virtualClock && n->baud) {
+      const uint64_t byteUs = 10000000ull / n->baud;
+      n->txFreeAt = std::max(now, n->txFreeAt) + len * byteUs;
+      at = n->txFreeAt;
+      if (n->txFreeAt > now + 256 * byteUs) blockUntil = n->txFreeAt - 256 * byteUs;
+    }
+    for (size_t i = 0; i < len; ++i) {
+      const char c = char(d[i]);
+      if (c != '\n') { n->outLine += c; continue; }
+      if (!n->outLine.empty() && n->outLine.back() == '\r') n->outLine.pop_back();
+      emitLine(n, at, n->outLine);
+      n->outLine.clear();
+    }
+  }
+  if (blockUntil) sleepUntilUs(blockUntil);
+}
+
+void i2cWait(I2cBus &bus, size_t bytes) {
+  if (!cfg.i2cTiming || cfg.virtualClock || !bus.clock) return;
+  sleepUntilUs(nowUs() + (bytes * 9 * 1000000ull + bus.clock - 1) / bus.clock);
+}
+
+// Above Config::i2cMaxHz every other transfer NACKs and the rest flip bit 0
+// of their first data byte. Caller holds hwMu.
+enum class I2cFault { NONE, NACK, CORRUPT };
+I2cFault i2cFault(I2cBus &bus) {
+  if (!cfg.i2cMaxHz || bus.clock <= cfg.i2cMaxHz) return I2cFault::NONE;
+  return bus.overspeed++ % 2 ? I2cFault::CORRUPT : I2cFault::NACK;
+}
+
+// INT of every expander is wired-OR onto fw->intPin (active low)
+void updateIntLine(Node *n, std::vector<void (*)()> &fire) {
+  if (n->fw->intPin < 0) return;
+  bool active = false;
+  for (auto &bus : n->i2c)
+    for (auto &d : bus.devices) active |= d.second.intActive();
+  const bool level = !active;
+  if (level == n->intLine) return;
+  n->intLine = level;
+  auto it = n->isr.find(n->fw->intPin);
+  if (it == n->isr.end()) return;
+  const int mode = it->second.second;
+  if (mode == CHANGE || (mode == FALLING && !level) || (mode == RISING && level)) fire.push_back(it->second.first);
+}
+
+// ISRs run on the caller's thread with the board as context
+void runIsrs(Node *n, const std::vector<void (*)()> &fire) {
+  if (fire.empty()) return;
+  Node *prev = tlNode;
+  tlNode = n;
+  for (auto f : fire) f();
+  tlNode = prev;
+}
+
+void wifiTask(Node *n) {
+  tlNode = n;
+  for (;;) {
+    WifiEvent ev;
+    {
+      std::unique_lock<std::mutex> lk(n->wifiMu);
+      n->wifiCv.wait_for(lk, std::chrono::milliseconds(5), [&] { return !n->wifiQ.empty() || n->stop.load(); });
+      if (n->stop.load()) return;
+      if (n->wifiQ.empty()) continue;
+      ev = std::move(n->wifiQ.front());
+      n->wifiQ.pop_front();
+    }
+    esp_now_recv_cb_t rcb;
+    esp_now_send_cb_t scb;
+    {
+      std::lock_guard<std::mutex> lk(n->nowMu);
+      if (ev.status && n->txPending) --n->txPending;
+      rcb = n->recvCb;
+      scb = n->sendCb;
+    }
+    try {
+      if (ev.status) {
+        wifi_tx_info_t info{n->mac, ev.des};
+        if (scb) scb(&info, ev.ok ? ESP_NOW_SEND_SUCCESS : ESP_NOW_SEND_FAIL);
+      } else if (rcb) {
+        wifi_pkt_rx_ctrl_t ctrl{-50, n->channel};
+        esp_now_recv_info_t info{ev.src, ev.des, &ctrl};
+        rcb(&info, ev.data.data(), (int)ev.data.size());
+      }
+    } catch (const TaskExit &) {
+      return;
+    }
+  }
+}
+
+void radioTask() {
+  std::unique_lock<std::mutex> lk(radio.m);
+  while (!radio.stop) {
+    if (radio.q.empty()) { radio.cv.wait(lk); continue; }
+    const uint64_t now = nowUs();
+    const uint64_t at = radio.q.top().at;
+    if (at > now) { radio.cv.wait_for(lk, std::chrono::microseconds(at - now)); continue; }
+    RadioEvent e = radio.q.top();
+    radio.q.pop();
+    lk.unlock();
+    Node *n = node(e.node);
+    {
+      std::lock_guard<std::mutex> wl(n->wifiMu);
+      n->wifiQ.push_back(std::move(e.ev));
+    }
+    n->wifiCv.notify_one();
+    lk.lock();
+  }
+}
+
+void schedule(uint64_t at, int node, WifiEvent ev) {
+  radio.q.push({at, radio.seq++, node, std::move(ev)});
+}
+
+bool lost() {
+  return cfg.radio.lossRate > 0 && std::uniform_real_distribution<double>(0, 1)(radio.rng) < cfg.radio.lossRate;
+}
+
+uint64_t latency() {
+  uint64_t us = cfg.radio.latencyUs;
+  if (cfg.radio.jitterUs) us += std::uniform_int_distribution<uint32_t>(0, cfg.radio.jitterUs)(radio.rng);
+  return us;
+}
+
+// Runs under radio.m. One attempt occupies the channel for its airtime;
+// attempts from every board on the channel are serialized.
+uint64_t transmit(Node *from, size_t len) {
+  const uint64_t now = nowUs();
+  uint64_t &freeAt = radio.mediumFreeAt[from->channel % 15];
+  const uint64_t start = std::max(now, freeAt);
+  const uint64_t air = cfg.radio.airtimeBaseUs + uint64_t(cfg.radio.airtimeUsPerByte) * len;
+  freeAt = start + air;
+  radio.stats.attempts++;
+  radio.stats.airtimeUs += air;
+  radio.stats.maxWaitUs = std::max(radio.stats.maxWaitUs, start - now);
+  return freeAt;
+}
+
+bool isBroadcast(const uint8_t *mac) {
+  static const uint8_t b[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+  return memcmp(mac, b, 6) == 0;
+}
+
+std::string formatMac(const uint8_t *m) {
+  char b[18];
+  snprintf(b, sizeof(b), "%02X:%02X:%02X:%02X:%02X:%02X", m[0], m[1], m[2], m[3], m[4], m[5]);
+  return b;
+}
+
+void taskMain(Task *t, TaskFunction_t fn, void *arg) {
+  tlNode = t->node;
+  tlTask = t;
+  try {
+    fn(arg);
+  } catch (const TaskExit &) {
+  }
+}
+
+Task *spawn(Node *n, const char *name, int core, TaskFunction_t fn, void *arg) {
+  auto t = std::make_unique<Task>();
+  Task *raw = t.get();
+  raw->node = n;
+  raw->name = name ? name : "";
+  raw->core = core == tskNO_AFFINITY ? 0 : core;
+  {
+    std::lock_guard<std::mutex> lk(n->tasksMu);
+    n->tasks.push_back(std::move(t));
+  }
+  raw->th = std::thread(taskMain, raw, fn, arg);
+  return raw;
+}
+
+void loopTask(void *arg) {
+  const Firmware *fw = static_cast<Node *>(arg)->fw;
+  fw->setup();
+  for (;;) {
+    fw->loop();
+    checkStop();
+  }
+}
+
+struct SimQueue {
+  std::mutex m;
+  std::condition_variable cv;
+  size_t itemSize, cap;
+  std::deque<std::vector<uint8_t>> items;
+};
+
+struct SimSem {
+  std::mutex m;
+  std::condition_variable cv;
+  int count, max;
+};
+
+template <class T, class... A>
+T *makeObject(A &&...a) {
+  auto p = std::make_shared<T>(std::forward<A>(a)...);
+  if (tlNode) {
+    std::lock_guard<std::mutex> lk(tlNode->tasksMu);
+    tlNode->objects.push_back(p);
+  } else {
+    static std::vector<std::shared_ptr<void>> orphans;
+    orphans.push_back(p);
+  }
+  return p.get();
+}
+
+} // namespace
+
+// ===== Public harness API =====
+Registrar::Registrar(const Firmware &fw) { registry().push_back(new Firmware(fw)); }
+
+void configure(const Config &c) {
+  cfg = c;
+  std::lock_guard<std::mutex> lk(radio.m);
+  radio.rng.seed(cfg.radio.seed);
+}
+const Config &config() { return cfg; }
+void onLine(LineFn fn) { lineFn = std::move(fn); }
+void onFrame(FrameFn fn) { frameFn = std::move(fn); }
+
+void onClockStep(uint64_t stepUs, std::function<void()> fn) {
+  vStepUs = stepUs ? stepUs : 1;
+  vStepFn = std::move(fn);
+}
+
+uint64_t nowUs() {
+  if (cfg.virtualClock) return vNow.load();
+  return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+void sleepUs(uint64_t us) {
+  if (cfg.virtualClock) { advanceTo(vNow.load() + us); return; }
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+int addNode(Kind kind) {
+  std::lock_guard<std::mutex> lk(nodesMu);
+  for (const Firmware *fw : registry()) {
+    if (fw->kind != kind) continue;
+    bool used = false;
+    for (auto &n : nodes) used |= n->fw == fw;
+    if (used) continue;
+    auto n = std::make_unique<Node>();
+    n->id = (int)nodes.size();
+    n->fw = fw;
+    // Locally administered, unique per board: 02:5A:<kind>:00:<slot>
+    const uint8_t mac[6] = {0x02, 0x5A, uint8_t(kind == Kind::HUB ? 0x48 : 0x53), 0x00,
+                            uint8_t(fw->slot >> 8), uint8_t(fw->slot)};
+    memcpy(n->mac, mac, 6);
+    n->macStr = formatMac(mac);
+    for (const SwitchPin &e : fw->expanders) n->i2c[e.bus & 1].devices[e.addr];
+    nodes.push_back(std::move(n));
+    return nodes.back()->id;
+  }
+  return -1;
+}
+
+int nodeCount() { std::lock_guard<std::mutex> lk(nodesMu); return (int)nodes.size(); }
+Kind kindOf(int id) { return node(id)->fw->kind; }
+const uint8_t *macOf(int id) { return node(id)->mac; }
+std::string macString(int id) { return node(id)->macStr; }
+int channelsOf(int id) { return node(id)->fw->channels; }
+
+void start(int id) {
+  {
+    std::lock_guard<std::mutex> lk(radio.m);
+    if (!radio.running) { radio.running = true; radio.th = std::thread(radioTask); }
+  }
+  Node *n = node(id);
+  if (!n || n->started) return;
+  n->started = true;
+  n->wifiTh = std::thread(wifiTask, n);
+  spawn(n, "loopTask", 1, loopTask, n);
+}
+
+void attach(int id) {
+  Node *n = node(id);
+  if (!n) return;
+  auto t = std::make_unique<Task>();
+  t->node = n;
+  t->name = "attached";
+  tlNode = n;
+  tlTask = t.get();
+  std::lock_guard<std::mutex> lk(n->tasksMu);
+  n->tasks.push_back(std::move(t));
+}
+
+void stopAll() {
+  std::vector<Node *> all;
+  {
+    std::lock_guard<std::mutex> lk(nodesMu);
+    for (auto &n : nodes) all.push_back(n.get());
+  }
+  for (Node *n : all) n->stop = true;
+  for (Node *n : all) {
+    if (n->wifiTh.joinable()) n->wifiTh.join();
+    // Tasks may spawn tasks while stopping; join until none are left
+    for (size_t i = 0;; ++i) {
+      Task *t;
+      {
+        std::lock_guard<std::mutex> lk(n->tasksMu);
+        if (i >= n->tasks.size()) break;
+        t = n->tasks[i].get();
+      }
+      if (t->th.joinable()) t->th.join();
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lk(radio.m);
+    radio.stop = true;
+  }
+  radio.cv.notify_all();
+  if (radio.th.joinable()) radio.th.join();
+}
+
+void serialInput(int id, const std::string &line) {
+  Node *n = node(id);
+  std::lock_guard<std::mutex> lk(n->inMu);
+  n->serIn.insert(n->serIn.end(), line.begin(), line.end());
+  n->serIn.push_back('\n');
+}
+
+void setSwitch(int id, int ch, bool pressed) {
+  Node *n = node(id);
+  SwitchPin sp;
+  if (!n || !n->fw->switchPin || !n->fw->switchPin(ch, sp)) return;
+  std::vector<void (*)()> fire;
+  {
+    std::lock_guard<std::mutex> lk(n->hwMu);
+    auto it = n->i2c[sp.bus & 1].devices.find(sp.addr);
+    if (it == n->i2c[sp.bus & 1].devices.end()) return;
+    Mcp23017 &d = it->second;
+    const uint16_t before = d.levels();
+    const uint16_t bit = uint16_t(1u << sp.pin);
+    d.closed = pressed ? uint16_t(d.closed | bit) : uint16_t(d.closed & ~bit);
+    d.inputsChanged(before);
+    updateIntLine(n, fire);
+  }
+  runIsrs(n, fire);
+}
+
+void setPin(int id, int pin, bool high) {
+  Node *n = node(id);
+  std::vector<void (*)()> fire;
+  {
+    std::lock_guard<std::mutex> lk(n->hwMu);
+    auto g = n->gpio.find(pin);
+    const bool before = g == n->gpio.end() ? true : g->second;
+    n->gpio[pin] = high;
+    auto it = n->isr.find(pin);
+    if (it != n->isr.end() && before != high) {
+      const int mode = it->second.second;
+      if (mode == CHANGE || (mode == FALLING && !high) || (mode == RISING && high)) fire.push_back(it->second.first);
+    }
+  }
+  runIsrs(n, fire);
+}
+
+RadioStats radioStats() {
+  std::lock_guard<std::mutex> lk(radio.m);
+  return radio.stats;
+}
+
+} // namespace sim
+
+using namespace sim;
+
+// ===== Arduino core =====
+HardwareSerial Serial;
+WiFiClass WiFi;
+TwoWire Wire(0);
+TwoWire Wire1(1);
+EspClass ESP;
+
+unsigned long millis() { return (unsigned long)(nowUs() / 1000); }
+unsigned long micros() { return (unsigned long)nowUs(); }
+void delay(unsigned long ms) { sleepUntilUs(nowUs() + uint64_t(ms) * 1000); }
+void delayMicroseconds(unsigned int us) { sleepUntilUs(nowUs() + us); }
+void yield() { checkStop(); std::this_thread::yield(); }
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  Node *n = self();
+  std::lock_guard<std::mutex> lk(n->hwMu);
+  if (mode == OUTPUT) n->gpio[pin] = false;
+  else if (!n->gpio.count(pin)) n->gpio[pin] = true;  // unconnected inputs read high
+}
+
+int digitalRead(uint8_t pin) {
+  Node *n = self();
+  std::lock_guard<std::mutex> lk(n->hwMu);
+  if (pin == n->fw->intPin) return n->intLine ? HIGH : LOW;
+  auto it = n->gpio.find(pin);
+  return it == n->gpio.end() || it->second ? HIGH : LOW;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  Node *n = self();
+  std::lock_guard<std::mutex> lk(n->hwMu);
+  n->gpio[pin] = val != LOW;
+}
+
+void attachInterrupt(uint8_t pin, void (*isr)(), int mode) {
+  Node *n = self();
+  std::lock_guard<std::mutex> lk(n->hwMu);
+  n->isr[pin] = {isr, mode};
+}
+
+void detachInterrupt(uint8_t pin) {
+  Node *n = self();
+  std::lock_guard<std::mutex> lk(n->hwMu);
+  n->isr.erase(pin);
+}
+
+void HardwareSerial::begin(unsigned long baud, uint32_t, int8_t, int8_t) { self()->baud = baud; }
+void HardwareSerial::updateBaudRate(unsigned long baud) {
+  Node *n = self();
+  std::lock_guard<std::mutex> lk(n->outMu);
+  n->baud = baud;
+}
+
+int HardwareSerial::available() {
+  Node *n = self();
+  std::lock_guard<std::mutex> lk(n->inMu);
+  return (int)n->serIn.size();
+}
+
+int HardwareSerial::read() {
+  Node *n = self();
+  std::lock_guard<std::mutex> lk(n->inMu);
+  if (n->serIn.empty()) return -1;
+  const int c = n->serIn.front();
+  n->serIn.pop_front();
+  return c;
+}
+
+int HardwareSerial::peek() {
+  Node *n = self();
+  std::lock_guard<std::mutex> lk(n->inMu);
+  return n->serIn.empty() ? -1 : n->serIn.front();
+}
+
+String HardwareSerial::readStringUntil(char term) {
+  std::string s;
+  for (int c; (c = read()) >= 0 && c != term;) s += char(c);
+  return String(s);
+}
+
+size_t HardwareSerial::write(const uint8_t *buf, size_t n) {
+  if (!tlNode) { fwrite(buf, 1, n, stdout); return n; }
+  serialOut(tlNode, buf, n);
+  return n;
+}
+
+size_t HardwareSerial::print(long v, int base) {
+  char b[24];
+  snprintf(b, sizeof(b), base == HEX ? "%lX" : "%ld", v);
+  return write(b);
+}
+
+size_t HardwareSerial::print(unsigned long v, int base) {
+  char b[24];
+  snprintf(b, sizeof(b), base == HEX ? "%lX" : "%lu", v);
+  return write(b);
+}
+
+size_t HardwareSerial::print(double v, int digits) {
+  char b[48];
+  snprintf(b, sizeof(b), "%.*f", digits, v);
+  return write(b);
+}
+
+size_t HardwareSerial::printf(const char *fmt, ...) {
+  char stackBuf[256];
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(stackBuf, sizeof(stackBuf), fmt, ap);
+  va_end(ap);
+  if (n < 0) return 0;
+  if ((size_t)n < sizeof(stackBuf)) return write((const uint8_t *)stackBuf, n);
+  std::string big(size_t(n) + 1, '\0');
+  va_start(ap, fmt);
+  vsnprintf(&big[0], big.size(), fmt, ap);
+  va_end(ap);
+  return write((const uint8_t *)big.data(), n);
+}
+
+uint32_t EspClass::getCycleCount() { return uint32_t(nowUs() * getCpuFreqMHz()); }
+void EspClass::restart() { throw TaskExit{}; }
+
+String WiFiClass::macAddress() { return String(self()->macStr.c_str()); }
+
+// ===== I2C =====
+bool TwoWire::begin(int, int, uint32_t freq) {
+  if (freq) setClock(freq);
+  return true;
+}
+
+bool TwoWire::setClock(uint32_t freq) {
+  Node *n = self();
+  std::lock_guard<std::mutex> lk(n->hwMu);
+  n->i2c[bus_ & 1].clock = freq;
+  return true;
+}
+
+uint32_t TwoWire::getClock() {
+  Node *n = self();
+  std::lock_guard<std::mutex> lk(n->hwMu);
+  return n->i2c[bus_ & 1].clock;
+}
+
+void TwoWire::beginTransmission(uint8_t addr) {
+  Node *n = self();
+  std::lock_guard<std::mutex> lk(n->hwMu);
+  I2cBus &b = n->i2c[bus_ & 1];
+  b.addr = addr;
+  b.tx.clear();
+}
+
+size_t TwoWire::write(uint8_t v) {
+  Node *n = self();
+  std::lock_guard<std::mutex> lk(n->hwMu);
+  n->i2c[bus_ & 1].tx.push_back(v);
+  return 1;
+}
+
+size_t TwoWire::write(const uint8_t *buf, size_t len) {
+  for (size_t i = 0; i < len; ++i) write(buf[i]);
+  return len;
+}
+
+// 0 = ACK, 2 = address NACK (Arduino convention)
+uint8_t TwoWire::endTransmission(bool) {
+  Node *n = self();
+  std::vector<void (*)()> fire;
+  size_t bytes;
+  {
+    std::lock_guard<std::mutex> lk(n->hwMu);
+    I2cBus &b = n->i2c[bus_ & 1];
+    bytes = 1 + b.tx.size();
+    auto it = b.devices.find(b.addr);
+    if (it == b.devices.end()) return 2;
+    const I2cFault f = i2cFault(b);
+    if (f == I2cFault::NACK) return 2;
+    if (f == I2cFault::CORRUPT && b.tx.size() > 1) b.tx[1] ^= 1;
+    Mcp23017 &d = it->second;
+    if (!b.tx.empty()) {
+      d.ptr = b.tx[0] % R_COUNT;
+      for (size_t i = 1; i < b.tx.size(); ++i) {
+        d.write(d.ptr, b.tx[i]);
+        d.ptr = uint8_t((d.ptr + 1) % R_COUNT);
+      }
+    }
+    updateIntLine(n, fire);
+  }
+  i2cWait(n->i2c[bus_ & 1], bytes);
+  runIsrs(n, fire);
+  return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t addr, uint8_t len, bool) {
+  Node *n = self();
+  std::vector<void (*)()> fire;
+  {
+    std::lock_guard<std::mutex> lk(n->hwMu);
+    I2cBus &b = n->i2c[bus_ & 1];
+    b.rx.clear();
+    auto it = b.devices.find(addr);
+    if (it == b.devices.end()) return 0;
+    const I2cFault f = i2cFault(b);
+    if (f == I2cFault::NACK) return 0;
+    Mcp23017 &d = it->second;
+    for (uint8_t i = 0; i < len; ++i) {
+      b.rx.push_back(d.read(d.ptr));
+      d.ptr = uint8_t((d.ptr + 1) % R_COUNT);
+    }
+    if (f == I2cFault::CORRUPT && len) b.rx[0] ^= 1;
+    updateIntLine(n, fire);
+  }
+  i2cWait(n->i2c[bus_ & 1], 1 + len);
+  runIsrs(n, fire);
+  return len;
+}
+
+int TwoWire::available() {
+  Node *n = self();
+  std::lock_guard<std::mutex> lk(n->hwMu);
+  return (int)n->i2c[bus_ & 1].rx.size();
+}
+
+int TwoWire::read() {
+  Node *n = self();
+  std::lock_guard<std::mutex> lk(n->hwMu);
+  auto &rx = n->i2c[bus_ & 1].rx;
+  if (rx.empty()) return -1;
+  const int v = rx.front();
+  rx.pop_front();
+  return v;
+}
+
+// ===== MCP23017 driver (register access over TwoWire, like the real library) =====
+bool Adafruit_MCP23X17::begin_I2C(uint8_t addr, TwoWire *wire) {
+  addr_ = addr;
+  wire_ = wire;
+  wire_->beginTransmission(addr_);
+  return wire_->endTransmission() == 0;
+}
+
+uint8_t Adafruit_MCP23X17::readReg(uint8_t reg) {
+  wire_->beginTransmission(addr_);
+  wire_->write(reg);
+  wire_->endTransmission(false);
+  wire_->requestFrom(addr_, (uint8_t)1);
+  return uint8_t(wire_->read());
+}
+
+uint16_t Adafruit_MCP23X17::readReg16(uint8_t reg) {
+  wire_->beginTransmission(addr_);
+  wire_->write(reg);
+  wire_->endTransmission(false);
+  wire_->requestFrom(addr_, (uint8_t)2);
+  const int lo = wire_->read();
+  const int hi = wire_->read();
+  return uint16_t((lo & 0xFF) | ((hi & 0xFF) << 8));
+}
+
+void Adafruit_MCP23X17::writeReg(uint8_t reg, uint8_t value) {
+  const uint8_t b[2] = {reg, value};
+  wire_->beginTransmission(addr_);
+  wire_->write(b, 2);
+  wire_->endTransmission();
+}
+
+void Adafruit_MCP23X17::writeReg16(uint8_t reg, uint16_t value) {
+  const uint8_t b[3] = {reg, uint8_t(value), uint8_t(value >> 8)};
+  wire_->beginTransmission(addr_);
+  wire_->write(b, 3);
+  wire_->endTransmission();
+}
+
+void Adafruit_MCP23X17::pinMode(uint8_t pin, uint8_t mode) {
+  const uint8_t port = pin >> 3, bit = uint8_t(1u << (pin & 7));
+  uint8_t iodir = readReg(uint8_t(R_IODIR + port));
+  uint8_t gppu = readReg(uint8_t(R_GPPU + port));
+  iodir = mode == OUTPUT ? uint8_t(iodir & ~bit) : uint8_t(iodir | bit);
+  gppu = mode == INPUT_PULLUP ? uint8_t(gppu | bit) : uint8_t(gppu & ~bit);
+  writeReg(uint8_t(R_IODIR + port), iodir);
+  writeReg(uint8_t(R_GPPU + port), gppu);
+}
+
+uint8_t Adafruit_MCP23X17::digitalRead(uint8_t pin) {
+  return (readReg(uint8_t(R_GPIO + (pin >> 3))) >> (pin & 7)) & 1u;
+}
+
+void Adafruit_MCP23X17::digitalWrite(uint8_t pin, uint8_t value) {
+  const uint8_t port = pin >> 3, bit = uint8_t(1u << (pin & 7));
+  uint8_t olat = readReg(uint8_t(R_OLAT + port));
+  olat = value ? uint8_t(olat | bit) : uint8_t(olat & ~bit);
+  writeReg(uint8_t(R_GPIO + port), olat);
+}
+
+uint8_t Adafruit_MCP23X17::readGPIOA() { return readReg(R_GPIO); }
+uint8_t Adafruit_MCP23X17::readGPIOB() { return readReg(R_GPIO + 1); }
+uint16_t Adafruit_MCP23X17::readGPIOAB() { return readReg16(R_GPIO); }
+void Adafruit_MCP23X17::writeGPIOA(uint8_t v) { writeReg(R_GPIO, v); }
+void Adafruit_MCP23X17::writeGPIOB(uint8_t v) { writeReg(R_GPIO + 1, v); }
+void Adafruit_MCP23X17::writeGPIOAB(uint16_t v) { writeReg16(R_GPIO, v); }
+
+void Adafruit_MCP23X17::setupInterrupts(bool mirroring, bool openDrain, uint8_t polarity) {
+  uint8_t iocon = readReg(R_IOCON);
+  iocon = mirroring ? uint8_t(iocon | 0x40) : uint8_t(iocon & ~0x40);
+  iocon = openDrain ? uint8_t(iocon | 0x04) : uint8_t(iocon & ~0x04);
+  iocon = polarity == HIGH ? uint8_t(iocon | 0x02) : uint8_t(iocon & ~0x02);
+  writeReg(R_IOCON, iocon);
+}
+
+void Adafruit_MCP23X17::setupInterruptPin(uint8_t pin, uint8_t mode) {
+  const uint8_t port = pin >> 3, bit = uint8_t(1u << (pin & 7));
+  uint8_t intcon = readReg(uint8_t(R_INTCON + port));
+  uint8_t defval = readReg(uint8_t(R_DEFVAL + port));
+  if (mode == CHANGE) {
+    intcon = uint8_t(intcon & ~bit);
+  } else {
+    intcon = uint8_t(intcon | bit);
+    defval = mode == FALLING ? uint8_t(defval | bit) : uint8_t(defval & ~bit);
+  }
+  writeReg(uint8_t(R_INTCON + port), intcon);
+  writeReg(uint8_t(R_DEFVAL + port), defval);
+  writeReg(uint8_t(R_GPINTEN + port), uint8_t(readReg(uint8_t(R_GPINTEN + port)) | bit));
+}
+
+void Adafruit_MCP23X17::disableInterruptPin(uint8_t pin) {
+  const uint8_t port = pin >> 3, bit = uint8_t(1u << (pin & 7));
+  writeReg(uint8_t(R_GPINTEN + port), uint8_t(readReg(uint8_t(R_GPINTEN + port)) & ~bit));
+}
+
+void Adafruit_MCP23X17::clearInterrupts() { (void)readReg16(R_INTCAP); }
+
+uint8_t Adafruit_MCP23X17::getLastInterruptPin() {
+  const uint16_t intf = readReg16(R_INTF);
+  for (uint8_t p = 0; p < 16; ++p)
+    if (intf & (1u << p)) return p;
+  return MCP23XXX_INT_ERR;
+}
+
+uint16_t Adafruit_MCP23X17::getCapturedInterrupt() { return readReg16(R_INTCAP); }
+
+// ===== FreeRTOS =====
+void vPortEnterCritical(portMUX_TYPE *mux) {
+  for (int spins = 0; mux->locked.exchange(true, std::memory_order_acquire); ++spins)
+    if (spins > 64) std::this_thread::yield();
+}
+void vPortExitCritical(portMUX_TYPE *mux) { mux->locked.store(false, std::memory_order_release); }
+BaseType_t xPortGetCoreID() { return tlTask ? tlTask->core : 0; }
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t, void *arg,
+                                   UBaseType_t, TaskHandle_t *created, BaseType_t core) {
+  Task *t = spawn(self(), name, core, fn, arg);
+  if (created) *created = t;
+  return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                       UBaseType_t prio, TaskHandle_t *created) {
+  return xTaskCreatePinnedToCore(fn, name, stack, arg, prio, created, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  if (!task || task == tlTask) throw TaskExit{};
+  // Deleting another task is not used by the firmware; it keeps running
+}
+
+void vTaskDelay(TickType_t ticks) {
+  if (!ticks) { yield(); return; }
+  sleepUntilUs(nowUs() + uint64_t(ticks) * 1000000 / configTICK_RATE_HZ);
+}
+
+void vTaskDelayUntil(TickType_t *prevWake, TickType_t period) {
+  *prevWake += period;
+  const TickType_t now = xTaskGetTickCount();
+  if (TickType_t(*prevWake - now) <= period)  // not already late
+    sleepUntilUs(uint64_t(*prevWake) * 1000000 / configTICK_RATE_HZ);
+  else
+    yield();
+}
+
+TickType_t xTaskGetTickCount() { return TickType_t(nowUs() * configTICK_RATE_HZ / 1000000); }
+TaskHandle_t xTaskGetCurrentTaskHandle() { return tlTask; }
+
+void xTaskNotifyGive(TaskHandle_t task) {
+  Task *t = static_cast<Task *>(task);
+  {
+    std::lock_guard<std::mutex> lk(t->m);
+    ++t->notify;
+  }
+  t->cv.notify_one();
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken) {
+  xTaskNotifyGive(task);
+  if (woken) *woken = pdTRUE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t wait) {
+  Task *t = tlTask;
+  std::unique_lock<std::mutex> lk(t->m);
+  if (!waitTicks(lk, t->cv, wait, [&] { return t->notify > 0; })) return 0;
+  const uint32_t v = t->notify;
+  t->notify = clearOnExit ? 0 : v - 1;
+  return v;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  SimQueue *q = makeObject<SimQueue>();
+  q->itemSize = itemSize;
+  q->cap = length;
+  return q;
+}
+
+void vQueueDelete(QueueHandle_t) {}
+
+BaseType_t xQueueSend(QueueHandle_t h, const void *item, TickType_t wait) {
+  SimQueue *q = static_cast<SimQueue *>(h);
+  std::unique_lock<std::mutex> lk(q->m);
+  if (!waitTicks(lk, q->cv, wait, [&] { return q->items.size() < q->cap; })) return pdFALSE;
+  const uint8_t *p = static_cast<const uint8_t *>(item);
+  q->items.emplace_back(p, p + q->itemSize);
+  q->cv.notify_all();
+  return pdTRUE;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t h, const void *item, BaseType_t *woken) {
+  if (woken) *woken = pdFALSE;
+  return xQueueSend(h, item, 0);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t h, void *item, TickType_t wait) {
+  SimQueue *q = static_cast<SimQueue *>(h);
+  std::unique_lock<std::mutex> lk(q->m);
+  if (!waitTicks(lk, q->cv, wait, [&] { return !q->items.empty(); })) return pdFALSE;
+  memcpy(item, q->items.front().data(), q->itemSize);
+  q->items.pop_front();
+  q->cv.notify_all();
+  return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t h) {
+  SimQueue *q = static_cast<SimQueue *>(h);
+  std::lock_guard<std::mutex> lk(q->m);
+  return (UBaseType_t)q->items.size();
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+  SimSem *s = makeObject<SimSem>();
+  s->count = s->max = 1;
+  return s;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+  SimSem *s = makeObject<SimSem>();
+  s->count = 0;
+  s->max = 1;
+  return s;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t h, TickType_t wait) {
+  SimSem *s = static_cast<SimSem *>(h);
+  std::unique_lock<std::mutex> lk(s->m);
+  if (!waitTicks(lk, s->cv, wait, [&] { return s->count > 0; })) return pdFALSE;
+  --s->count;
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t h) {
+  SimSem *s = static_cast<SimSem *>(h);
+  {
+    std::lock_guard<std::mutex> lk(s->m);
+    if (s->count >= s->max) return pdFALSE;
+    ++s->count;
+  }
+  s->cv.notify_one();
+  return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t) {}
+
+// ===== Wi-Fi / ESP-NOW =====
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t) { return ESP_OK; }
+
+esp_err_t esp_wifi_set_channel(uint8_t primary, wifi_second_chan_t) {
+  if (primary < 1 || primary > 14) return ESP_ERR_INVALID_ARG;
+  Node *n = self();
+  std::lock_guard<std::mutex> lk(n->nowMu);
+  n->channel = primary;
+  return ESP_OK;
+}
+
+esp_err_t esp_now_init() {
+  Node *n = self();
+  std::lock_guard<std::mutex> lk(n->nowMu);
+  n->nowInit = true;
+  return ESP_OK;
+}
+
+esp_err_t esp_now_deinit() {
+  Node *n = self();
+  std::lock_guard<std::mutex> lk(n->nowMu);
+  n->nowInit = false;
+  n->peers.clear();
+  n->recvCb = nullptr;
+  n->sendCb = nullptr;
+  return ESP_OK;
+}
+
+esp_err_t esp_now_register_recv_cb(esp_now_recv_cb_t cb) {
+  Node *n = self();
+  std::lock_guard<std::mutex> lk(n->nowMu);
+  if (!n->nowInit) return ESP_ERR_ESPNOW_NOT_INIT;
+  n->recvCb = cb;
+  return ESP_OK;
+}
+
+esp_err_t esp_now_register_send_cb(esp_now_send_cb_t cb) {
+  Node *n = self();
+  std::lock_guard<std::mutex> lk(n->nowMu);
+  if (!n->nowInit) return ESP_ERR_ESPNOW_NOT_INIT;
+  n->sendCb = cb;
+  return ESP_OK;
+}
+
+static bool hasPeer(Node *n, const uint8_t *mac) {
+  for (auto &p : n->peers)
+    if (memcmp(p.data(), mac, 6) == 0) return true;
+  return false;
+}
+
+bool esp_now_is_peer_exist(const uint8_t *mac) {
+  Node *n = self();
+  std::lock_guard<std::mutex> lk(n->nowMu);
+  return mac && hasPeer(n, mac);
+}
+
+esp_err_t esp_now_add_peer(const esp_now_peer_info_t *peer) {
+  Node *n = self();
+  std::lock_guard<std::mutex> lk(n->nowMu);
+  if (!n->nowInit) return ESP_ERR_ESPNOW_NOT_INIT;
+  if (!peer) return ESP_ERR_ESPNOW_ARG;
+  if (hasPeer(n, peer->peer_addr)) return ESP_ERR_ESPNOW_EXIST;
+  if (n->peers.size() >= ESP_NOW_MAX_TOTAL_PEER_NUM) return ESP_ERR_ESPNOW_FULL;
+  std::array<uint8_t, 6> a;
+  memcpy(a.data(), peer->peer_addr, 6);
+  n->peers.push_back(a);
+  return ESP_OK;
+}
+
+esp_err_t esp_now_del_peer(const uint8_t *mac) {
+  Node *n = self();
+  std::lock_guard<std::mutex> lk(n->nowMu);
+  for (auto it = n->peers.begin(); it != n->peers.end(); ++it)
+    if (memcmp(it->data(), mac, 6) == 0) { n->peers.erase(it); return ESP_OK; }
+  return ESP_ERR_ESPNOW_NOT_FOUND;
+}
+
+esp_err_t esp_now_send(const uint8_t *peer, const uint8_t *data, size_t len) {
+  Node *n = self();
+  uint8_t channel;
+  {
+    std::lock_guard<std::mutex> lk(n->nowMu);
+    esp_err_t err = ESP_OK;
+    if (!n->nowInit) err = ESP_ERR_ESPNOW_NOT_INIT;
+    else if (!peer || !data || !len || len > ESP_NOW_MAX_DATA_LEN) err = ESP_ERR_ESPNOW_ARG;
+    else if (!isBroadcast(peer) && !hasPeer(n, peer)) err = ESP_ERR_ESPNOW_NOT_FOUND;
+    else if (!cfg.virtualClock && n->txPending >= cfg.radio.txQueueDepth) err = ESP_ERR_ESPNOW_NO_MEM;
+    if (err != ESP_OK) {
+      std::lock_guard<std::mutex> rl(radio.m);
+      radio.stats.rejected++;
+      return err;
+    }
+    if (!cfg.virtualClock) n->txPending++;
+    channel = n->channel;
+  }
+  // Virtual clock: no radio and no send callbacks, the frame tap is the air
+  if (cfg.virtualClock) {
+    {
+      std::lock_guard<std::mutex> rl(radio.m);
+      radio.stats.frames++;
+      radio.stats.bytes += len;
+    }
+    if (frameFn) frameFn(n->id, peer, data, len);
+    return ESP_OK;
+  }
+
+  std::vector<Node *> receivers;
+  {
+    std::lock_guard<std::mutex> lk(nodesMu);
+    for (auto &o : nodes) {
+      if (o.get() == n || !o->started) continue;
+      if (!isBroadcast(peer) && memcmp(o->mac, peer, 6) != 0) continue;
+      std::lock_guard<std::mutex> ol(o->nowMu);
+      if (o->nowInit && o->channel == channel) receivers.push_back(o.get());
+    }
+  }
+
+  WifiEvent rx{false, true, {}, {}, std::vector<uint8_t>(data, data + len)};
+  memcpy(rx.src, n->mac, 6);
+  memcpy(rx.des, peer, 6);
+  WifiEvent status{true, false, {}, {}, {}};
+  memcpy(status.src, n->mac, 6);
+  memcpy(status.des, peer, 6);
+
+  {
+    std::lock_guard<std::mutex> lk(radio.m);
+    radio.stats.frames++;
+    radio.stats.bytes += len;
+    uint64_t end;
+    if (isBroadcast(peer)) {
+      // One attempt, no link-layer ACK: every listener draws its own loss
+      end = transmit(n, len);
+      for (Node *o : receivers) {
+        if (lost()) { radio.stats.lost++; continue; }
+        radio.stats.delivered++;
+        schedule(end + latency(), o->id, rx);
+      }
+      status.ok = true;
+    } else {
+      end = 0;
+      for (int attempt = 0; attempt <= cfg.radio.macRetries; ++attempt) {
+        end = transmit(n, len);
+        if (receivers.empty() || lost()) { radio.stats.lost++; continue; }
+        radio.stats.delivered++;
+        schedule(end + latency(), receivers[0]->id, rx);
+        status.ok = true;
+        break;
+      }
+    }
+    schedule(end, n->id, std::move(status));
+  }
+  radio.cv.notify_one();
+  if (frameFn) frameFn(n->id, peer, data, len);
+  return ESP_OK;
+}
+
+const char *esp_err_to_name(esp_err_t code) {
+  switch (code) {
+    case ESP_OK:                   return "ESP_OK";
+    case ESP_FAIL:                 return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:           return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:      return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_ESPNOW_NOT_INIT:  return "ESP_ERR_ESPNOW_NOT_INIT";
+    case ESP_ERR_ESPNOW_ARG:       return "ESP_ERR_ESPNOW_ARG";
+    case ESP_ERR_ESPNOW_NO_MEM:    return "ESP_ERR_ESPNOW_NO_MEM";
+    case ESP_ERR_ESPNOW_FULL:      return "ESP_ERR_ESPNOW_FULL";
+    case ESP_ERR_ESPNOW_NOT_FOUND: return "ESP_ERR_ESPNOW_NOT_FOUND";
+    case ESP_ERR_ESPNOW_INTERNAL:  return "ESP_ERR_ESPNOW_INTERNAL";
+    case ESP_ERR_ESPNOW_EXIST:     return "ESP_ERR_ESPNOW_EXIST";
+    case ESP_ERR_ESPNOW_IF:        return "ESP_ERR_ESPNOW_IF";
+    default:                       return "UNKNOWN ERROR";
+  }
+}
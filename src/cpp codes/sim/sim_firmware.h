@@ -0,0 +1,34 @@
+#pragma once
+// Included by hub_node.cpp / station_node.cpp before the firmware source is
+// pulled into a per-slot namespace. Everything the firmware includes must be
+// included here first, at global scope, so its include guards keep the
+// declarations out of that namespace.
+#include <Arduino.h>
+#include <WiFi.h>
+#include <Wire.h>
+#include <Adafruit_MCP23X17.h>
+#include <esp_now.h>
+#include <esp_wifi.h>
+#include <esp_err.h>
+#include <esp_idf_version.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/portmacro.h>
+#include <atomic>
+#include <cctype>
+#include <cstring>
+#include <ctype.h>
+#include <stdarg.h>
+#include "../espnow_proto.h"
+#include "../latency_hist.h"
+#include "../board_layout.h"
+#include "sim.h"
+
+#define SIM_CAT2(a, b) a##b
+#define SIM_CAT(a, b) SIM_CAT2(a, b)
+
+#ifndef SIM_SLOT
+#error "SIM_SLOT must be defined by the build"
+#endif
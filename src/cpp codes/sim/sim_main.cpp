@@ -0,0 +1,359 @@
+// kfb_sim: N hubs and M stations on the virtual radio.
+//
+// Session workload (default), per hub and round: the station sends MONITOR
+// for --pins, the harness inserts them one by one (optionally bouncing) and
+// the hub auto-finalizes; time-to-RESULT runs from the last insertion to the
+// RESULT line leaving the station's UART. --storm-ms instead toggles random
+// monitored switches for that long and counts the EV lines that reach the host.
+// --stats then asks every station and hub for its STATS latency report.
+#include "sim.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Options {
+  int hubs = 4, stations = 1, rounds = 3;
+  std::vector<int> pins{1, 2, 3, 4, 5, 6, 7, 8};
+  int insertGapMs = 20;
+  int bounces = 0;            // extra open/close pairs per insertion, 1 ms apart
+  int stormMs = 0;
+  int toggleMs = 5;           // storm: one random switch flips this often per hub
+  int timeoutMs = 5000;
+  bool stats = false;
+  sim::Config sim;
+};
+
+struct Line {
+  int node;
+  uint64_t at;
+  std::string text;
+};
+
+class LineLog {
+ public:
+  void add(int node, uint64_t at, const std::string &text) {
+    {
+      std::lock_guard<std::mutex> lk(m_);
+      lines_.push_back({node, at, text});
+    }
+    cv_.notify_all();
+  }
+
+  size_t size() {
+    std::lock_guard<std::mutex> lk(m_);
+    return lines_.size();
+  }
+
+  // First line of `node` at or after `from` that satisfies pred; from moves past it
+  template <class F>
+  bool wait(int node, size_t &from, uint64_t deadlineUs, F pred, Line *out = nullptr) {
+    std::unique_lock<std::mutex> lk(m_);
+    for (;;) {
+      for (; from < lines_.size(); ++from) {
+        const Line &l = lines_[from];
+        if (l.node != node || !pred(l.text)) continue;
+        if (out) *out = l;
+        ++from;
+        return true;
+      }
+      const uint64_t now = sim::nowUs();
+      if (now >= deadlineUs) return false;
+      cv_.wait_for(lk, std::chrono::microseconds(std::min<uint64_t>(deadlineUs - now, 20000)));
+    }
+  }
+
+  template <class F>
+  int count(int node, size_t from, size_t to, F pred) {
+    std::lock_guard<std::mutex> lk(m_);
+    int n = 0;
+    for (size_t i = from; i < std::min(to, lines_.size()); ++i)
+      if ((node < 0 || lines_[i].node == node) && pred(lines_[i].text)) ++n;
+    return n;
+  }
+
+  std::vector<std::string> texts(int node, size_t from, size_t to, const char *needle) {
+    std::lock_guard<std::mutex> lk(m_);
+    std::vector<std::string> out;
+    for (size_t i = from; i < std::min(to, lines_.size()); ++i)
+      if (lines_[i].node == node && lines_[i].text.find(needle) != std::string::npos) out.push_back(lines_[i].text);
+    return out;
+  }
+
+ private:
+  std::mutex m_;
+  std::condition_variable cv_;
+  std::vector<Line> lines_;
+};
+
+LineLog lineLog;
+
+bool has(const std::string &s, const char *a, const std::string &b = std::string()) {
+  return s.find(a) != std::string::npos && (b.empty() || s.find(b) != std::string::npos);
+}
+
+std::string pinList(const std::vector<int> &pins) {
+  std::string s;
+  for (int p : pins) s += (s.empty() ? "" : ",") + std::to_string(p);
+  return s;
+}
+
+struct HubResult {
+  int ok = 0, fail = 0, timeout = 0;
+  std::vector<double> latencyMs;
+  uint64_t evLines = 0, toggles = 0;
+};
+
+void insert(int hub, int ch, int bounces) {
+  for (int b = 0; b < bounces; ++b) {
+    sim::setSwitch(hub, ch, true);
+    sim::sleepUs(1000);
+    sim::setSwitch(hub, ch, false);
+    sim::sleepUs(1000);
+  }
+  sim::setSwitch(hub, ch, true);
+}
+
+void runHub(const Options &o, int hub, int station, HubResult &r) {
+  const std::string mac = sim::macString(hub);
+  std::mt19937 rng(unsigned(o.sim.radio.seed * 7919 + hub));
+  for (int round = 0; round < o.rounds; ++round) {
+    size_t cur = lineLog.size();
+    sim::serialInput(station, "MONITOR " + pinList(o.pins) + " " + mac);
+    if (!lineLog.wait(station, cur, sim::nowUs() + o.timeoutMs * 1000ull,
+                      [&](const std::string &s) { return has(s, "MONITOR-START", mac); })) {
+      r.timeout++;
+      sim::serialInput(station, "CLEAN " + mac);
+      continue;
+    }
+
+    if (o.stormMs > 0) {
+      const size_t stormFrom = lineLog.size();
+      const uint64_t end = sim::nowUs() + o.stormMs * 1000ull;
+      std::vector<bool> down(o.pins.size(), false);
+      while (sim::nowUs() < end) {
+        const size_t i = rng() % o.pins.size();
+        down[i] = !down[i];
+        sim::setSwitch(hub, o.pins[i] - 1, down[i]);
+        r.toggles++;
+        sim::sleepUs(o.toggleMs * 1000ull);
+      }
+      for (int p : o.pins) sim::setSwitch(hub, p - 1, false);
+      sim::sleepUs(200000);  // let the last edges drain
+      r.evLines += lineLog.count(station, stormFrom, lineLog.size(),
+                                 [&](const std::string &s) { return s.rfind("EV ", 0) == 0 && has(s, "", mac); });
+      cur = lineLog.size();
+      sim::serialInput(station, "CLEAN " + mac);
+      lineLog.wait(station, cur, sim::nowUs() + o.timeoutMs * 1000ull,
+                   [&](const std::string &s) { return has(s, "CLEAN-OK", mac); });
+      continue;
+    }
+
+    for (size_t i = 0; i < o.pins.size(); ++i) {
+      if (i) sim::sleepUs(o.insertGapMs * 1000ull);
+      insert(hub, o.pins[i] - 1, o.bounces);
+    }
+    const uint64_t lastInsert = sim::nowUs();
+    Line res;
+    if (!lineLog.wait(station, cur, lastInsert + o.timeoutMs * 1000ull,
+                      [&](const std::string &s) { return has(s, "RESULT", mac); }, &res)) {
+      r.timeout++;
+    } else {
+      if (has(res.text, "SUCCESS")) r.ok++; else r.fail++;
+      r.latencyMs.push_back(double(int64_t(res.at - lastInsert)) / 1000.0);
+    }
+    for (int p : o.pins) sim::setSwitch(hub, p - 1, false);
+    sim::sleepUs(100000);  // released switches settle before the next MONITOR
+  }
+}
+
+double pct(std::vector<double> v, double p) {
+  if (v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  return v[std::min(v.size() - 1, size_t(p * (v.size() - 1) + 0.5))];
+}
+
+std::vector<int> parsePins(const char *s) {
+  std::vector<int> out;
+  for (const char *p = s; *p;) {
+    char *end;
+    const long v = strtol(p, &end, 10);
+    if (end == p) { ++p; continue; }
+    long hi = v;
+    if (*end == '-' && isdigit((unsigned char)end[1])) hi = strtol(end + 1, &end, 10);  // "A-B"
+    for (long ch = v; ch <= hi; ++ch)
+      if (ch >= 1) out.push_back(int(ch));
+    p = end;
+  }
+  return out;
+}
+
+void usage() {
+  fprintf(stderr,
+          "usage: kfb_sim [--hubs N] [--stations M] [--rounds R] [--pins 1,2,5-8]\n"
+          "               [--insert-gap-ms MS] [--bounces N] [--storm-ms MS] [--toggle-ms MS]\n"
+          "               [--loss P] [--mac-retries N] [--latency-us US] [--jitter-us US]\n"
+          "               [--airtime-base-us US] [--airtime-us-per-byte US] [--tx-queue N]\n"
+          "               [--seed S] [--timeout-ms MS] [--no-i2c-timing] [--no-serial-timing] [--echo]\n"
+          "               [--i2c-max-hz HZ] [--stats]\n");
+}
+
+bool parseArgs(int argc, char **argv, Options &o) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string a = argv[i];
+    auto next = [&]() -> const char * { return i + 1 < argc ? argv[++i] : nullptr; };
+    const char *v = nullptr;
+    if (a == "--echo") { o.sim.echo = true; continue; }
+    if (a == "--stats") { o.stats = true; continue; }
+    if (a == "--no-i2c-timing") { o.sim.i2cTiming = false; continue; }
+    if (a == "--no-serial-timing") { o.sim.serialTiming = false; continue; }
+    if (a == "--help" || a == "-h" || !(v = next())) return false;
+    if (a == "--hubs") o.hubs = atoi(v);
+    else if (a == "--stations") o.stations = atoi(v);
+    else if (a == "--rounds") o.rounds = atoi(v);
+    else if (a == "--pins") o.pins = parsePins(v);
+    else if (a == "--insert-gap-ms") o.insertGapMs = atoi(v);
+    else if (a == "--bounces") o.bounces = atoi(v);
+    else if (a == "--storm-ms") o.stormMs = atoi(v);
+    else if (a == "--toggle-ms") o.toggleMs = std::max(1, atoi(v));
+    else if (a == "--timeout-ms") o.timeoutMs = atoi(v);
+    else if (a == "--loss") o.sim.radio.lossRate = atof(v);
+    else if (a == "--mac-retries") o.sim.radio.macRetries = atoi(v);
+    else if (a == "--latency-us") o.sim.radio.latencyUs = uint32_t(atol(v));
+    else if (a == "--jitter-us") o.sim.radio.jitterUs = uint32_t(atol(v));
+    else if (a == "--airtime-base-us") o.sim.radio.airtimeBaseUs = uint32_t(atol(v));
+    else if (a == "--airtime-us-per-byte") o.sim.radio.airtimeUsPerByte = uint32_t(atol(v));
+    else if (a == "--tx-queue") o.sim.radio.txQueueDepth = uint32_t(atol(v));
+    else if (a == "--seed") o.sim.radio.seed = strtoull(v, nullptr, 10);
+    else if (a == "--i2c-max-hz") o.sim.i2cMaxHz = uint32_t(atol(v));
+    else return false;
+  }
+  return o.hubs > 0 && o.stations > 0 && o.rounds > 0 && !o.pins.empty();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options o;
+  if (!parseArgs(argc, argv, o)) { usage(); return 2; }
+  sim::configure(o.sim);
+  sim::onLine([](int node, uint64_t at, const std::string &s) { lineLog.add(node, at, s); });
+
+  std::vector<int> hubs, stations;
+  for (int i = 0; i < o.hubs; ++i) {
+    const int id = sim::addNode(sim::Kind::HUB);
+    if (id < 0) { fprintf(stderr, "kfb_sim: only %d hub slots built (SIM_MAX_HUBS)\n", i); return 2; }
+    hubs.push_back(id);
+  }
+  for (int i = 0; i < o.stations; ++i) {
+    const int id = sim::addNode(sim::Kind::STATION);
+    if (id < 0) { fprintf(stderr, "kfb_sim: only %d station slots built (SIM_MAX_STATIONS)\n", i); return 2; }
+    stations.push_back(id);
+  }
+  for (int p : o.pins)
+    if (p > sim::channelsOf(hubs[0])) { fprintf(stderr, "kfb_sim: pin %d exceeds hub channels\n", p); return 2; }
+
+  size_t cur = 0;
+  for (int id : stations) sim::start(id);
+  for (int id : hubs) sim::start(id);
+  const uint64_t bootDeadline = sim::nowUs() + 10000000;
+  for (int id : stations) {
+    size_t c = 0;
+    if (!lineLog.wait(id, c, bootDeadline, [](const std::string &s) { return has(s, "Ready."); })) {
+      fprintf(stderr, "kfb_sim: station %s did not boot\n", sim::macString(id).c_str());
+      sim::stopAll();
+      return 1;
+    }
+  }
+  for (int id : hubs) {
+    size_t c = 0;
+    if (!lineLog.wait(id, c, bootDeadline, [](const std::string &s) { return has(s, "waiting for MONITOR") || has(s, "WAIT_FOR_TARGET"); })) {
+      fprintf(stderr, "kfb_sim: hub %s did not boot\n", sim::macString(id).c_str());
+      sim::stopAll();
+      return 1;
+    }
+  }
+  cur = lineLog.size();
+  const sim::RadioStats radio0 = sim::radioStats();
+
+  std::vector<HubResult> results(hubs.size());
+  std::vector<std::thread> drivers;
+  const uint64_t t0 = sim::nowUs();
+  for (size_t i = 0; i < hubs.size(); ++i)
+    drivers.emplace_back(runHub, std::cref(o), hubs[i], stations[i % stations.size()], std::ref(results[i]));
+  for (auto &t : drivers) t.join();
+  const double elapsedS = double(sim::nowUs() - t0) / 1e6;
+  const size_t end = lineLog.size();
+  sim::RadioStats rs = sim::radioStats();
+
+  // Firmware latency reports; hub reports arrive as "← reply from <MAC>: STATS ..."
+  std::vector<std::string> statsLines;
+  if (o.stats) {
+    auto request = [&](int station, const std::string &cmd, const std::string &tag, const std::string &mac) {
+      size_t c = lineLog.size();
+      const size_t from = c;
+      sim::serialInput(station, cmd);
+      lineLog.wait(station, c, sim::nowUs() + o.timeoutMs * 1000ull,
+                   [&](const std::string &s) { return has(s, "STATS-OK", mac); });
+      for (const std::string &s : lineLog.texts(station, from, c, "STATS ")) {
+        const size_t at = s.find("STATS ");
+        if (at == 0 || (at >= 2 && s.compare(at - 2, 2, ": ") == 0)) statsLines.push_back(tag + " " + s.substr(at + 6));
+      }
+    };
+    for (size_t i = 0; i < hubs.size(); ++i) {
+      const std::string mac = sim::macString(hubs[i]);
+      request(stations[i % stations.size()], "STATS " + mac, "hub " + mac, mac);
+    }
+    for (int id : stations) request(id, "STATS", "station " + sim::macString(id), "");
+  }
+  sim::stopAll();
+
+  HubResult all;
+  for (const HubResult &r : results) {
+    all.ok += r.ok; all.fail += r.fail; all.timeout += r.timeout;
+    all.evLines += r.evLines; all.toggles += r.toggles;
+    all.latencyMs.insert(all.latencyMs.end(), r.latencyMs.begin(), r.latencyMs.end());
+  }
+  auto countAll = [&](const std::vector<int> &ids, const char *needle) {
+    int n = 0;
+    for (int id : ids) n += lineLog.count(id, cur, end, [&](const std::string &s) { return has(s, needle); });
+    return n;
+  };
+
+  printf("sim: hubs=%d stations=%d rounds=%d pins=%zu loss=%.3f mac-retries=%d latency=%uus+%uus airtime=%uus+%uus/B\n",
+         o.hubs, o.stations, o.rounds, o.pins.size(), o.sim.radio.lossRate, o.sim.radio.macRetries,
+         o.sim.radio.latencyUs, o.sim.radio.jitterUs, o.sim.radio.airtimeBaseUs, o.sim.radio.airtimeUsPerByte);
+  if (o.stormMs > 0) {
+    printf("storm: toggles=%llu ev-lines=%llu ev-lines/s=%.1f timeouts=%d\n", (unsigned long long)all.toggles,
+           (unsigned long long)all.evLines, all.evLines / elapsedS, all.timeout);
+  } else {
+    printf("results: ok=%d fail=%d timeout=%d results/s=%.2f\n", all.ok, all.fail, all.timeout,
+           (all.ok + all.fail) / elapsedS);
+    printf("time-to-RESULT ms: p50=%.1f p95=%.1f p99=%.1f max=%.1f\n", pct(all.latencyMs, 0.50),
+           pct(all.latencyMs, 0.95), pct(all.latencyMs, 0.99), pct(all.latencyMs, 1.0));
+  }
+  const uint64_t frames = rs.frames - radio0.frames, airUs = rs.airtimeUs - radio0.airtimeUs;
+  printf("radio: frames=%llu attempts=%llu delivered=%llu lost=%llu rejected=%llu bytes=%llu airtime=%.1f%% max-wait=%lluus\n",
+         (unsigned long long)frames, (unsigned long long)(rs.attempts - radio0.attempts),
+         (unsigned long long)(rs.delivered - radio0.delivered), (unsigned long long)(rs.lost - radio0.lost),
+         (unsigned long long)(rs.rejected - radio0.rejected), (unsigned long long)(rs.bytes - radio0.bytes),
+         100.0 * double(airUs) / (elapsedS * 1e6), (unsigned long long)rs.maxWaitUs);
+  printf("station: tx-ok=%d tx-fail=%d no-ack=%d rx-overflow=%d\n", countAll(stations, "TX-OK"),
+         countAll(stations, "TX-FAIL"), countAll(stations, "WARN: no ACK"), countAll(stations, "RX log overflow"));
+  printf("hub: rx-queue-full=%d\n", countAll(hubs, "RX queue full"));
+  for (const std::string &s : statsLines) printf("stats: %s\n", s.c_str());
+
+  if (o.stormMs > 0) return all.timeout ? 1 : 0;
+  return (all.fail || all.timeout) ? 1 : 0;
+}
@@ -0,0 +1,10 @@
+// One simulated station: station.cpp compiled into namespace station_<SIM_SLOT>
+#include "sim_firmware.h"
+
+namespace SIM_CAT(station_, SIM_SLOT) {
+
+#include "../station.cpp"
+
+static const sim::Registrar simRegistrar({sim::Kind::STATION, SIM_SLOT, &setup, &loop, 0, nullptr, {}, -1});
+
+} // namespace
@@ -14,11 +14,17 @@ void station_cpp_requires_esp32_headers() {} // host-side stub when ESP32 SDK he
 #include <esp_now.h>
 #include <esp_wifi.h>
 #include <ctype.h>
+#include <stdarg.h>
+#include <atomic>
 #include "esp_idf_version.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 #include "freertos/portmacro.h"
 #include "esp_err.h"
+#include "espnow_proto.h"
+#include "latency_hist.h"
+#include "board_layout.h"
 
 // ===== Config =====
 static constexpr uint8_t ESPNOW_CHANNEL = 1; // must match hub
@@ -26,14 +32,76 @@ static_assert(ESPNOW_CHANNEL >= 1 && ESPNOW_CHANNEL <= 13, "Bad ESPNOW channel")
 static constexpr unsigned STA_ACK_TIMEOUT_MS = 220;
 static constexpr int      STA_ACK_MAX_RETRIES = 4; // total attempts = retries+1
 static constexpr size_t   STA_MAX_PAYLOAD    = 220; // leave room for ID framing
+static constexpr unsigned STA_ACK_TIMEOUT_MAX_MS = 640;
+static constexpr size_t   LINE_MAX           = 512; // longest host line accepted
+static constexpr unsigned STA_ACK_BACKOFF_MS = 80;
+
+// Async TX: loop() queues commands, txTask sends and retries them
+static constexpr int         TX_QUEUE_LEN  = 16;
+static constexpr int         TX_SLOTS      = 16;  // queued + in flight, all hubs
+static constexpr UBaseType_t TX_TASK_PRIO  = 3;
+
+// RX -> serial: the radio callbacks only fill ring records, serialTask prints them
+static constexpr uint32_t    OUT_RING_SLOTS   = 32; // power of two
+static constexpr UBaseType_t SERIAL_TASK_PRIO = 1;
+
+// Host link: text at SERIAL_BAUD until the host sends "SERIAL BIN <baud>"
+static constexpr unsigned long SERIAL_BAUD          = 115200;
+static constexpr unsigned long SERIAL_FAST_BAUD     = 921600;  // "SERIAL BIN" without a rate
+static constexpr unsigned long SERIAL_FAST_BAUD_MAX = 2000000;
 
 // ===== Station state =====
 enum StationState { IDLE, WAIT_HELLO, WAIT_RESULT };
-static volatile StationState staState = IDLE;
-static volatile bool forwardLive = false; // gate EV forwarding during active sessions
-static uint8_t sessionMac[6];
-static volatile bool haveSessionMac = false;
-static portMUX_TYPE sessionMux = portMUX_INITIALIZER_UNLOCKED;
+
+// ===== Latency =====
+// micros() stamps: host line read → first esp_now_send returned, send →
+// onEspNowSent, first send → hub ACK, and RX callback → line written to the
+// host. "STATS" dumps p50/p99/max per stage, "STATS <MAC>" asks the hub.
+enum LatStage { LAT_CMD_TX, LAT_TX_DONE, LAT_ACK, LAT_RX_TO_SERIAL, LAT_COUNT };
+static const char *const LAT_NAMES[LAT_COUNT] = {"cmd-tx", "tx-done", "ack", "rx-to-serial"};
+static kfb::LatencyHist latency[LAT_COUNT];
+
+// esp_now_send() calls awaiting onEspNowSent, oldest first. Entries are
+// stamped before the call (the callback may beat the return) and voided if it fails.
+struct TxStamp { uint32_t seq, sentUs; bool dead; };
+static constexpr int TX_STAMPS = 16;
+static TxStamp txStamps[TX_STAMPS];
+static int txStampHead = 0, txStampCount = 0;
+static uint32_t txStampSeq = 0;
+static portMUX_TYPE txStampMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Every esp_now_send() goes through here so onEspNowSent can match its stamp
+static esp_err_t espNowSend(const uint8_t *mac, const uint8_t *data, size_t len) {
+  portENTER_CRITICAL(&txStampMux);
+  if (txStampCount == TX_STAMPS) { txStampHead = (txStampHead + 1) % TX_STAMPS; --txStampCount; }
+  const uint32_t seq = ++txStampSeq;
+  txStamps[(txStampHead + txStampCount++) % TX_STAMPS] = {seq, (uint32_t)micros(), false};
+  portEXIT_CRITICAL(&txStampMux);
+  const esp_err_t err = esp_now_send(mac, data, len);
+  if (err != ESP_OK) {
+    portENTER_CRITICAL(&txStampMux);
+    for (int i = 0; i < txStampCount; ++i) {
+      TxStamp &t = txStamps[(txStampHead + i) % TX_STAMPS];
+      if (t.seq == seq) { t.dead = true; break; }
+    }
+    portEXIT_CRITICAL(&txStampMux);
+  }
+  return err;
+}
+
+static void recordTxDone() {
+  const uint32_t us = micros();
+  TxStamp t{};
+  bool have = false;
+  portENTER_CRITICAL(&txStampMux);
+  while (txStampCount && !have) {
+    t = txStamps[txStampHead];
+    txStampHead = (txStampHead + 1) % TX_STAMPS; --txStampCount;
+    have = !t.dead;
+  }
+  portEXIT_CRITICAL(&txStampMux);
+  if (have) latency[LAT_TX_DONE].record(us - t.sentUs);
+}
 
 static inline bool isZeroMac(const uint8_t mac[6]) {
   if (!mac) return true;
@@ -41,34 +109,192 @@ static inline bool isZeroMac(const uint8_t mac[6]) {
   return true;
 }
 
-// ===== Last TX context =====
-static uint8_t expectedMac[6];
-static volatile bool haveExpectedMac = false;
-// (no external EV handler; EV pass-through is handled inline in RX)
+// ===== Host serial link =====
+// Text lines by default. In binary mode every record is
+//   [LinkRec][hub MAC, 6 bytes, zero if none][payload][CRC16-CCITT, LE]
+// COBS-encoded and terminated by 0x00, so the host resyncs on the next zero
+// after a corrupt byte. Host -> station stays text in both modes.
+enum LinkRec : uint8_t {
+  LR_LINE   = 1, // payload: one legacy text line, no newline
+  LR_EV     = 2, // payload: [kind 'P'|'L'][channel, 1-based][value 0|1]
+  LR_EVENTS = 3, // payload: FT_EVENTS payload as received from the hub
+  LR_REPLY  = 4, // payload: reply text as printed after "← reply from <MAC>: "
+};
+static constexpr size_t LINK_MAX_PAYLOAD = LINE_MAX;
+static std::atomic<bool> linkBinary{false};
+
+static uint16_t crc16(const uint8_t *d, size_t n) { // CCITT-FALSE
+  uint16_t crc = 0xFFFF;
+  while (n--) {
+    crc ^= uint16_t(*d++) << 8;
+    for (int b = 0; b < 8; ++b) crc = (crc & 0x8000) ? uint16_t((crc << 1) ^ 0x1021) : uint16_t(crc << 1);
+  }
+  return crc;
+}
+
+// out needs n + n/254 + 1 bytes; no trailing delimiter
+static size_t cobsEncode(const uint8_t *in, size_t n, uint8_t *out) {
+  size_t code = 0, pos = 1;
+  uint8_t run = 1;
+  for (size_t i = 0; i < n; ++i) {
+    if (in[i]) { out[pos++] = in[i]; ++run; }
+    if (!in[i] || run == 0xFF) {
+      out[code] = run; code = pos++; run = 1;
+    }
+  }
+  out[code] = run;
+  return pos;
+}
 
-// ===== Simple ACK/ID support =====
-static volatile bool staAckReceived = false;
-static volatile uint32_t staAckWaitId = 0;
-static volatile uint8_t staAckWaitMac[6] = {0};
-static portMUX_TYPE ackMux = portMUX_INITIALIZER_UNLOCKED;
+static void linkSend(LinkRec type, const uint8_t mac[6], const uint8_t *p, size_t n) {
+  uint8_t rec[1 + 6 + LINK_MAX_PAYLOAD + 2];
+  uint8_t out[sizeof(rec) + sizeof(rec) / 254 + 2];
+  n = min(n, LINK_MAX_PAYLOAD);
+  rec[0] = type;
+  if (mac) memcpy(rec + 1, mac, 6); else memset(rec + 1, 0, 6);
+  memcpy(rec + 7, p, n);
+  const uint16_t crc = crc16(rec, 7 + n);
+  rec[7 + n] = uint8_t(crc & 0xFF);
+  rec[8 + n] = uint8_t(crc >> 8);
+  size_t len = cobsEncode(rec, 9 + n, out);
+  out[len++] = 0;
+  Serial.write(out, len); // one write per record: the driver never interleaves it
+}
 
-static inline void setAckWait(uint32_t id, const uint8_t mac[6]) {
-  portENTER_CRITICAL(&ackMux);
-  staAckWaitId = id;
-  memcpy((void*)staAckWaitMac, mac, 6);
-  staAckReceived = false;
-  portEXIT_CRITICAL(&ackMux);
+// Every runtime station line goes through here so binary mode can frame it
+static void hostLine(const uint8_t mac[6], const char *fmt, ...) {
+  char buf[LINE_MAX + 64];
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(buf, sizeof(buf) - 1, fmt, ap);
+  va_end(ap);
+  if (n < 0) return;
+  n = min(n, (int)sizeof(buf) - 2);
+  if (linkBinary.load(std::memory_order_relaxed)) { linkSend(LR_LINE, mac, (const uint8_t *)buf, n); return; }
+  buf[n++] = '\n';
+  Serial.write((const uint8_t *)buf, n);
 }
 
-// Expected MAC tuple (filtering for directed transactions)
-static portMUX_TYPE expMux = portMUX_INITIALIZER_UNLOCKED;
-static inline void setExpectedMac(const uint8_t mac[6], bool has) {
-  portENTER_CRITICAL(&expMux);
-  if (has && mac) memcpy(expectedMac, mac, 6);
-  haveExpectedMac = has;
-  portEXIT_CRITICAL(&expMux);
+// ===== Per-hub sessions =====
+// One entry per hub MAC, open-addressed on the MAC so the RX callback finds
+// its hub in O(1). Entries outlive their session (state IDLE) and the least
+// recently used idle one is recycled when the table is full. Slots move on
+// recycle, so callers always look up by MAC under sessionMux.
+static constexpr int MAX_SESSIONS = 8; // power of two
+static_assert((MAX_SESSIONS & (MAX_SESSIONS - 1)) == 0, "MAX_SESSIONS must be a power of two");
+
+struct HubSession {
+  bool used;
+  uint8_t mac[6];
+  StationState state;
+  bool forwardLive;   // gate EV/UI forwarding during MONITOR/CHECK
+  bool expecting;     // command in flight: replies from this hub are accepted
+  bool txInFlight;    // reliable send waiting for ACK
+  bool ackReceived;
+  uint32_t ackWaitId;
+  uint32_t ackAtUs;   // micros() when ackReceived was set
+  unsigned long lastUsed;
+};
+static HubSession sessions[MAX_SESSIONS];
+static portMUX_TYPE sessionMux = portMUX_INITIALIZER_UNLOCKED;
+
+static inline int macHash(const uint8_t mac[6]) {
+  // NIC-specific bytes differ most between boards of one vendor
+  return (mac[3] ^ (mac[4] * 7) ^ (mac[5] * 31)) & (MAX_SESSIONS - 1);
 }
-static inline void clearExpectedMac() { setExpectedMac(nullptr, false); }
+
+// Caller holds sessionMux
+static HubSession *sessionFind(const uint8_t mac[6]) {
+  int i = macHash(mac);
+  for (int k = 0; k < MAX_SESSIONS; ++k, i = (i + 1) & (MAX_SESSIONS - 1)) {
+    if (!sessions[i].used) return nullptr;
+    if (memcmp(sessions[i].mac, mac, 6) == 0) return &sessions[i];
+  }
+  return nullptr;
+}
+
+static HubSession *sessionInsert(const HubSession &e) {
+  int i = macHash(e.mac);
+  while (sessions[i].used) i = (i + 1) & (MAX_SESSIONS - 1);
+  sessions[i] = e;
+  return &sessions[i];
+}
+
+// Caller holds sessionMux. Find or create; nullptr when every hub is busy
+static HubSession *sessionOpen(const uint8_t mac[6]) {
+  if (HubSession *s = sessionFind(mac)) return s;
+  int victim = -1, freeSlots = 0;
+  for (int i = 0; i < MAX_SESSIONS; ++i) {
+    const HubSession &e = sessions[i];
+    if (!e.used) { freeSlots++; continue; }
+    bool idle = e.state == IDLE && !e.forwardLive && !e.expecting && !e.txInFlight;
+    if (idle && (victim < 0 || (long)(e.lastUsed - sessions[victim].lastUsed) < 0)) victim = i;
+  }
+  if (!freeSlots) {
+    if (victim < 0) return nullptr;
+    // Drop the victim and rebuild so no probe chain runs through a hole
+    HubSession old[MAX_SESSIONS];
+    memcpy(old, sessions, sizeof sessions);
+    old[victim].used = false;
+    memset(sessions, 0, sizeof sessions);
+    for (const HubSession &e : old) if (e.used) sessionInsert(e);
+  }
+  HubSession e = {};
+  e.used = true;
+  memcpy(e.mac, mac, 6);
+  e.state = IDLE;
+  return sessionInsert(e);
+}
+
+// Session transition of one command, applied when txTask starts sending it
+// so a command queued behind another for the same hub cannot clobber it
+struct SessionOp {
+  bool setState;      // false: PING/STATS leave a running session's state alone
+  StationState state;
+  int8_t live;        // forwardLive: 1 on, 0 off, -1 unchanged
+};
+
+// Make sure `mac` has a session entry; false when every hub is busy
+static bool sessionReserve(const uint8_t mac[6]) {
+  portENTER_CRITICAL(&sessionMux);
+  HubSession *s = sessionOpen(mac);
+  if (s) s->lastUsed = millis();
+  portEXIT_CRITICAL(&sessionMux);
+  return s != nullptr;
+}
+
+// Command for `mac` goes on the air: accept its replies until they arrive
+static bool sessionBegin(const uint8_t mac[6], const SessionOp &op) {
+  portENTER_CRITICAL(&sessionMux);
+  HubSession *s = sessionOpen(mac);
+  if (s) {
+    if (op.setState) s->state = op.state;
+    if (op.live >= 0) s->forwardLive = op.live != 0;
+    s->expecting = true;
+    s->lastUsed = millis();
+  }
+  portEXIT_CRITICAL(&sessionMux);
+  return s != nullptr;
+}
+
+static void sessionEnd(const uint8_t mac[6]) {
+  portENTER_CRITICAL(&sessionMux);
+  if (HubSession *s = sessionFind(mac)) {
+    s->state = IDLE; s->forwardLive = false; s->expecting = false;
+  }
+  portEXIT_CRITICAL(&sessionMux);
+}
+
+// Reply window closed; a pending CHECK keeps waiting for its RESULT
+static void sessionReplied(const uint8_t mac[6]) {
+  portENTER_CRITICAL(&sessionMux);
+  if (HubSession *s = sessionFind(mac)) {
+    s->expecting = false;
+    if (s->state == WAIT_HELLO) s->state = IDLE;
+  }
+  portEXIT_CRITICAL(&sessionMux);
+}
+
 static uint32_t nextSeqId() {
   static uint32_t seq = 1;
   return seq++;
@@ -96,122 +322,479 @@ static void onEspNowRecv(const uint8_t *mac, const uint8_t *data, int len);
 #endif
 
 // ===== Helpers =====
-static String macToString(const uint8_t mac[6]) {
-  char buf[18];
-  sprintf(buf, "%02X:%02X:%02X:%02X:%02X:%02X",
-          mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-  return String(buf);
+static void macToChars(const uint8_t mac[6], char out[18]) {
+  snprintf(out, 18, "%02X:%02X:%02X:%02X:%02X:%02X",
+           mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+}
+
+// ===== RX decoding =====
+// Every frame is classified once; binary frames are rendered into the legacy
+// text line so everything printed on serial stays unchanged for the host.
+enum RxKind : uint8_t {
+  RX_OTHER, RX_ACK, RX_EV, RX_UI, RX_RESULT, RX_READY, RX_WELCOME,
+  RX_ONESHOT_OK, // MONITOR-OK / PING-OK
+  RX_CLEAN_OK,
+};
+
+struct RxFrame {
+  RxKind kind;
+  uint32_t id;  // 0 = no ID / no ACK wanted
+  bool binary;
+};
+
+static RxKind classifyText(const char *s) {
+  if (strncmp(s, "ACK ", 4) == 0) return RX_ACK;
+  if (strncmp(s, "EV ", 3) == 0)  return RX_EV;
+  if (strncmp(s, "UI:", 3) == 0)  return RX_UI;
+  if (strncmp(s, "RESULT ", 7) == 0 || strncmp(s, "SUCCESS", 7) == 0 ||
+      strncmp(s, "FAILURE", 7) == 0) return RX_RESULT;
+  if (strncmp(s, "READY", 5) == 0)   return RX_READY;
+  if (strncmp(s, "WELCOME", 7) == 0) return RX_WELCOME;
+  if (strncmp(s, "MONITOR-OK", 10) == 0 || strncmp(s, "PING-OK", 7) == 0 ||
+      strncmp(s, "STATS-OK", 8) == 0) return RX_ONESHOT_OK;
+  if (strncmp(s, "CLEAN-OK", 8) == 0) return RX_CLEAN_OK;
+  return RX_OTHER;
+}
+
+static RxKind replyKind(uint8_t code) {
+  switch (code) {
+    case kfb::RC_READY:      return RX_READY;
+    case kfb::RC_WELCOME:    return RX_WELCOME;
+    case kfb::RC_MONITOR_OK:
+    case kfb::RC_PING_OK:    return RX_ONESHOT_OK;
+    case kfb::RC_CLEAN_OK:   return RX_CLEAN_OK;
+    default:                 return RX_OTHER;
+  }
+}
+
+// Append 1-based channel numbers of the set bits as "a,b,c"
+static size_t appendBitList(char *out, size_t pos, size_t cap, const uint8_t *bits, size_t n) {
+  bool first = true;
+  for (size_t i = 0; i < n; ++i) {
+    for (uint8_t b = bits[i]; b; b &= uint8_t(b - 1)) {
+      int ch = int(i * 8 + __builtin_ctz(b)) + 1;
+      int w = snprintf(out + pos, cap - pos, first ? "%d" : ",%d", ch);
+      if (w < 0 || size_t(w) >= cap - pos) return cap - 1;
+      pos += size_t(w); first = false;
+    }
+  }
+  return pos;
+}
+
+// Expand a coalesced FT_EVENTS frame into the per-channel EV lines (already validated)
+static void printEventBatch(const uint8_t *p, const uint8_t src[6]) {
+  char mac[18]; macToChars(src, mac);
+  const bool snapshot = p[0] & kfb::EVF_SNAPSHOT;
+  const size_t n = p[1];
+  const uint8_t *pCh = p + 2, *pVal = pCh + n, *lCh = pVal + n, *lVal = lCh + n;
+  auto bit = [](const uint8_t *m, size_t i) -> unsigned { return (m[i >> 3] >> (i & 7)) & 1u; };
+  if (snapshot) { // baseline order: P then L per channel
+    for (size_t i = 0; i < n * 8; ++i) {
+      if (bit(pCh, i)) hostLine(src, "EV P %u %u %s", (unsigned)(i + 1), bit(pVal, i), mac);
+      if (bit(lCh, i)) hostLine(src, "EV L %u %u %s", (unsigned)(i + 1), bit(lVal, i), mac);
+    }
+    return;
+  }
+  for (size_t i = 0; i < n * 8; ++i)
+    if (bit(lCh, i)) hostLine(src, "EV L %u %u %s", (unsigned)(i + 1), bit(lVal, i), mac);
+  for (size_t i = 0; i < n * 8; ++i)
+    if (bit(pCh, i)) hostLine(src, "EV P %u %u %s", (unsigned)(i + 1), bit(pVal, i), mac);
+}
+
+// Validate a binary frame and classify it without rendering anything
+static bool binaryKind(const kfb::Header &h, const uint8_t *d, int len, RxKind &kind) {
+  const uint8_t *p = d + kfb::HEADER_LEN;
+  const int plen = len - (int)kfb::HEADER_LEN;
+  switch (h.type) {
+    case kfb::FT_ACK:    kind = RX_ACK; return true;
+    case kfb::FT_EVENT:  kind = RX_EV;  return plen >= 3;
+    case kfb::FT_EVENTS: kind = RX_EV;  return plen >= 2 && plen >= int(2 + 4 * p[1]);
+    case kfb::FT_REPLY:
+      if (plen < 1 || !kfb::replyText(p[0])) return false;
+      kind = replyKind(p[0]);
+      return true;
+    case kfb::FT_RESULT: kind = RX_RESULT; return plen >= 2 && plen >= int(2 + 2 * p[1]);
+    default:             return false;
+  }
+}
+
+// Validated binary frame -> legacy text in out.
+// FT_EVENTS renders nothing here: printEventBatch() expands it.
+static void renderBinary(const kfb::Header &h, const uint8_t *d, const uint8_t src[6],
+                         char *out, size_t cap) {
+  const uint8_t *p = d + kfb::HEADER_LEN;
+  char mac[18]; macToChars(src, mac);
+  size_t pos = 0;
+  out[0] = '\0';
+  switch (h.type) {
+    case kfb::FT_ACK:
+      snprintf(out, cap, "ACK %u", (unsigned)h.id);
+      return;
+    case kfb::FT_EVENT:
+      snprintf(out, cap, "EV %c %u %u %s", (char)p[0], (unsigned)p[1], (unsigned)(p[2] ? 1 : 0), mac);
+      return;
+    case kfb::FT_REPLY:
+      pos = snprintf(out, cap, kfb::replyHasMac(p[0]) ? "%s %s" : "%s", kfb::replyText(p[0]), mac);
+      break;
+    case kfb::FT_RESULT: {
+      const size_t n = p[1];
+      const uint8_t *missing = p + 2, *extra = p + 2 + n;
+      bool anyMissing = false, anyExtra = false;
+      for (size_t i = 0; i < n; ++i) { anyMissing |= missing[i] != 0; anyExtra |= extra[i] != 0; }
+      pos = snprintf(out, cap, "RESULT %s", p[0] ? "SUCCESS" : "FAILURE");
+      if (anyMissing) {
+        pos += snprintf(out + pos, cap - pos, " MISSING ");
+        if (pos >= cap) pos = cap - 1;
+        pos = appendBitList(out, pos, cap, missing, n);
+      }
+      if (anyExtra && pos < cap - 1) {
+        pos += snprintf(out + pos, cap - pos, anyMissing ? ";EXTRA " : " EXTRA ");
+        if (pos >= cap) pos = cap - 1;
+        pos = appendBitList(out, pos, cap, extra, n);
+      }
+      if (pos < cap - 1) pos += snprintf(out + pos, cap - pos, " %s", mac);
+      if (pos >= cap) pos = cap - 1;
+      break;
+    }
+    default:
+      return;
+  }
+  // Reliable frames printed " ID=n" in the text protocol as well
+  if (h.id && pos < cap - 1) snprintf(out + pos, cap - pos, " ID=%u", (unsigned)h.id);
+}
+
+// ===== RX -> serial pipeline =====
+// The Wi-Fi task (RX and TX-status callbacks) is the only producer and
+// serialTask the only consumer, so the ring needs no lock: the producer owns
+// outHead, the consumer owns outTail. A full ring drops the record and counts
+// it; serialTask reports drops so the host can tell lines went missing.
+enum OutKind : uint8_t {
+  OUT_EV,          // frame: forwarded EV (text, FT_EVENT or FT_EVENTS)
+  OUT_UI,          // frame: "UI:..." text
+  OUT_REPLY,       // frame: "← reply from <MAC>: <text>"
+  OUT_HELLO,       // arg: 1 = READY, 0 = WELCOME
+  OUT_UNEXPECTED,  // mac2: the hub a reply is expected from
+  OUT_BAD_TYPE,    // arg: frame type
+  OUT_BAD_VERSION, // arg: frame version
+  OUT_TX_STATUS,   // arg: 1 = OK
+};
+
+struct OutRec {
+  OutKind kind;
+  uint8_t arg;
+  uint8_t len;
+  uint8_t mac[6];
+  uint8_t mac2[6];
+  uint32_t rxUs;  // micros() at acquire, for rx-to-serial
+  uint8_t data[kfb::MAX_FRAME];
+};
+
+static OutRec outRing[OUT_RING_SLOTS];
+static std::atomic<uint32_t> outHead{0}, outTail{0};
+static std::atomic<uint32_t> outDrops{0}, outHighWater{0};
+static TaskHandle_t serialTaskHandle = nullptr;
+
+// Producer side; nullptr (and a counted drop) when the ring is full
+static OutRec *outAcquire(OutKind kind, const uint8_t mac[6]) {
+  const uint32_t head = outHead.load(std::memory_order_relaxed);
+  const uint32_t used = head - outTail.load(std::memory_order_acquire);
+  if (used >= OUT_RING_SLOTS) { outDrops.fetch_add(1, std::memory_order_relaxed); return nullptr; }
+  if (used + 1 > outHighWater.load(std::memory_order_relaxed)) outHighWater.store(used + 1, std::memory_order_relaxed);
+  OutRec *r = &outRing[head & (OUT_RING_SLOTS - 1)];
+  r->kind = kind; r->arg = 0; r->len = 0;
+  r->rxUs = micros();
+  if (mac) memcpy(r->mac, mac, 6);
+  return r;
+}
+
+static void outCommit() {
+  outHead.store(outHead.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  if (serialTaskHandle) xTaskNotifyGive(serialTaskHandle);
+}
+
+static void outPush(OutKind kind, const uint8_t mac[6], uint8_t arg = 0) {
+  if (OutRec *r = outAcquire(kind, mac)) { r->arg = arg; outCommit(); }
+}
+
+static void outPushFrame(OutKind kind, const uint8_t mac[6], const uint8_t *data, int len) {
+  if (OutRec *r = outAcquire(kind, mac)) {
+    r->len = (uint8_t)min(len, (int)sizeof(r->data));
+    memcpy(r->data, data, r->len);
+    outCommit();
+  }
+}
+
+// Frame record -> the text line it stands for (binary frames rendered)
+static const char *recText(const OutRec &r, char *buf, size_t cap) {
+  kfb::Header h;
+  if (kfb::parseHeader(r.data, r.len, h)) { renderBinary(h, r.data, r.mac, buf, cap); return buf; }
+  size_t n = min((size_t)r.len, cap - 1);
+  memcpy(buf, r.data, n); buf[n] = '\0';
+  return buf;
+}
+
+// "FINAL PRESSED=<hex> LATCHED=<hex> UNLATCHED=<hex> <MAC>" ahead of a RESULT
+// from a hub that sends the final state. Each set is the RESULT bitmask as hex,
+// byte 0 first, bit i = channel i+1, so the line stays short at 128 channels;
+// src/lib/serial.ts parses it.
+static void printFinalState(const OutRec &r) {
+  kfb::Header h;
+  if (!kfb::parseHeader(r.data, r.len, h) || h.type != kfb::FT_RESULT || r.len < kfb::HEADER_LEN + 2) return;
+  const uint8_t *p = r.data + kfb::HEADER_LEN;
+  const size_t n = p[1];
+  if (n == 0 || r.len < kfb::HEADER_LEN + 2 + kfb::RESULT_SETS * n) return;
+  char hex[3][2 * ((kfb::MAX_CHANNELS + 7) / 8) + 1];
+  for (int k = 0; k < 3; ++k) {
+    const uint8_t *set = p + 2 + (2 + k) * n;  // unlatched, pressed, latched
+    const size_t bytes = min(n, sizeof(hex[k]) / 2);
+    for (size_t i = 0; i < bytes; ++i) snprintf(hex[k] + 2 * i, 3, "%02X", set[i]);
+    hex[k][2 * bytes] = '\0';
+  }
+  char mac[18]; macToChars(r.mac, mac);
+  hostLine(r.mac, "FINAL PRESSED=%s LATCHED=%s UNLATCHED=%s %s", hex[1], hex[2], hex[0], mac);
+}
+
+// Binary link: events and replies as fixed records; false = send as a line
+static bool linkRec(const OutRec &r) {
+  char text[512];
+  kfb::Header h;
+  const bool bin = kfb::parseHeader(r.data, r.len, h);
+  if (r.kind == OUT_EV && bin && (h.type == kfb::FT_EVENTS || h.type == kfb::FT_EVENT) && r.len > kfb::HEADER_LEN) {
+    linkSend(h.type == kfb::FT_EVENTS ? LR_EVENTS : LR_EV, r.mac, r.data + kfb::HEADER_LEN, r.len - kfb::HEADER_LEN);
+    return true;
+  }
+  if (r.kind == OUT_REPLY) {
+    recText(r, text, sizeof(text));
+    linkSend(LR_REPLY, r.mac, (const uint8_t *)text, strlen(text));
+    return true;
+  }
+  return false;
+}
+
+static void printRec(const OutRec &r) {
+  if (r.kind == OUT_REPLY) printFinalState(r);
+  if (linkBinary.load(std::memory_order_relaxed) && linkRec(r)) return;
+  char mac[18]; macToChars(r.mac, mac);
+  char text[512];
+  kfb::Header h;
+  switch (r.kind) {
+    case OUT_EV:
+      if (kfb::parseHeader(r.data, r.len, h) && h.type == kfb::FT_EVENTS) printEventBatch(r.data + kfb::HEADER_LEN, r.mac);
+      else hostLine(r.mac, "%s", recText(r, text, sizeof(text)));
+      break;
+    case OUT_UI:
+      hostLine(r.mac, "UI %s %s", recText(r, text, sizeof(text)) + 3, mac);
+      break;
+    case OUT_REPLY:
+      hostLine(r.mac, "← reply from %s: %s", mac, recText(r, text, sizeof(text)));
+      break;
+    case OUT_HELLO:
+      hostLine(r.mac, "%s %s", r.arg ? "READY" : "WELCOME", mac);
+      break;
+    case OUT_UNEXPECTED: {
+      char exp[18]; macToChars(r.mac2, exp);
+      hostLine(r.mac, "ignored: unexpected MAC. expected %s got %s", exp, mac);
+      break;
+    }
+    case OUT_BAD_TYPE:
+      hostLine(r.mac, "ignored: bad binary frame type=%u from %s", r.arg, mac);
+      break;
+    case OUT_BAD_VERSION:
+      hostLine(r.mac, "ignored: binary frame version %u from %s", r.arg, mac);
+      break;
+    case OUT_TX_STATUS:
+      hostLine(r.mac, "→ TX status=%s", r.arg ? "OK" : "FAIL");
+      break;
+  }
+}
+
+static void serialTask(void *) {
+  uint32_t reportedDrops = 0;
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+    uint32_t tail = outTail.load(std::memory_order_relaxed);
+    while (tail != outHead.load(std::memory_order_acquire)) {
+      const OutRec &r = outRing[tail & (OUT_RING_SLOTS - 1)];
+      printRec(r);
+      if (r.kind == OUT_EV || r.kind == OUT_UI || r.kind == OUT_REPLY)
+        latency[LAT_RX_TO_SERIAL].record(micros() - r.rxUs);
+      outTail.store(++tail, std::memory_order_release);
+    }
+    const uint32_t drops = outDrops.load(std::memory_order_relaxed);
+    if (drops != reportedDrops) {
+      hostLine(nullptr, "WARN: RX log overflow dropped=%lu (+%lu) high-water=%lu/%lu",
+                    (unsigned long)drops, (unsigned long)(drops - reportedDrops),
+                    (unsigned long)outHighWater.load(std::memory_order_relaxed), (unsigned long)OUT_RING_SLOTS);
+      reportedDrops = drops;
+    }
+  }
 }
 
-static bool parseMac(const String &s, uint8_t mac[6]) {
-  if (s.length() != 17) return false;
+static inline int hexVal(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  c = (char)toupper((unsigned char)c);
+  return (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+}
+
+// "AA:BB:CC:DD:EE:FF" (exactly 17 chars at s, any case)
+static bool parseMac(const char *s, uint8_t mac[6]) {
   for (int i = 0; i < 6; i++) {
     if (i < 5 && s[i * 3 + 2] != ':') return false;
-    long b = strtol(s.substring(i * 3, i * 3 + 2).c_str(), nullptr, 16);
-    if (b < 0 || b > 255) return false;
-    mac[i] = static_cast<uint8_t>(b);
+    int hi = hexVal(s[i * 3]), lo = hexVal(s[i * 3 + 1]);
+    if (hi < 0 || lo < 0) return false;
+    mac[i] = static_cast<uint8_t>(hi << 4 | lo);
   }
   return true;
 }
 
 // (removed unused handleLiveEvent; EV forwarding handled in RX)
 
-// Validate CHECK pins "N[,N]*" with 1..40 range
-static bool validateCheckPins(const String &payload) {
-  String u = payload; u.trim(); u.toUpperCase();
-  if (!u.startsWith("CHECK")) return true; // not a CHECK, nothing to validate
-  String list = u.substring(5); list.trim();
-  if (list.isEmpty()) return false;
+static inline bool startsWithNoCase(const char *s, const char *pfx) {
+  return strncasecmp(s, pfx, strlen(pfx)) == 0;
+}
 
+static char *trimInPlace(char *s) {
+  while (isspace((unsigned char)*s)) ++s;
+  size_t n = strlen(s);
+  while (n && isspace((unsigned char)s[n - 1])) s[--n] = '\0';
+  return s;
+}
+
+// Validate CHECK pins "N[,N]*" (N or A-B) within 1..kfb::MAX_CHANNELS, each
+// channel at most once; the hub checks them against its own board layout
+static bool validateCheckPins(const char *payload) {
+  while (isspace((unsigned char)*payload)) ++payload;
+  if (!startsWithNoCase(payload, "CHECK")) return true; // not a CHECK, nothing to validate
+  const char *p = payload + 5;
+
+  auto readPin = [&p](long &v) {
+    if (!isdigit((unsigned char)*p)) return false; // no digit
+    v = 0;
+    while (isdigit((unsigned char)*p)) { if (v <= kfb::MAX_CHANNELS) v = v * 10 + (*p - '0'); p++; }
+    return v >= 1 && v <= kfb::MAX_CHANNELS;
+  };
+  uint8_t seen[(kfb::MAX_CHANNELS + 7) / 8] = {};
   int count = 0;
-  for (int i = 0; i < list.length();) {
+  for (;;) {
     // skip spaces
-    while (i < list.length() && isspace((unsigned char)list[i])) i++;
-    if (i >= list.length()) break;
-
-    // read number
-    int start = i;
-    while (i < list.length() && isdigit((unsigned char)list[i])) i++;
-    if (start == i) return false; // no digit
-    long v = strtol(list.substring(start, i).c_str(), nullptr, 10);
-    if (v < 1 || v > 40) return false;
-    count++;
-    if (count > 32) return false; // arbitrary cap
+    while (isspace((unsigned char)*p)) p++;
+    if (!*p) break;
+
+    long first = 0, last = 0;
+    if (!readPin(first)) return false;
+    last = first;
+    if (*p == '-') { p++; if (!readPin(last) || last < first) return false; }
+    for (long ch = first - 1; ch < last; ++ch) {
+      if (seen[ch >> 3] & (1u << (ch & 7))) return false; // duplicate channel
+      seen[ch >> 3] |= uint8_t(1u << (ch & 7));
+    }
+    count += int(last - first + 1);
 
     // skip spaces
-    while (i < list.length() && isspace((unsigned char)list[i])) i++;
+    while (isspace((unsigned char)*p)) p++;
     // optional comma
-    if (i < list.length() && list[i] == ',') i++;
+    if (*p == ',') p++;
   }
   return count > 0;
 }
 
-// Parse a console line. Prefer cmd='…' if present. Require the LAST MAC and it must be at the end.
-// Return payloadOut (without MAC) + macOut.
-static bool parseLineForCommand(const String &lineIn, String &payloadOut, uint8_t macOut[6]) {
-  String s = lineIn;
-  s.trim();
-
-  // Prefer inner command if cmd='…' or cmd="…" present
-  int cmdPos = s.indexOf("cmd='");
-  if (cmdPos >= 0) {
-    int start = cmdPos + 5;
-    int end = s.indexOf('\'', start);
-    if (end > start) s = s.substring(start, end);
-  } else {
-    int cmdPosQ = s.indexOf("cmd=\"");
-    if (cmdPosQ >= 0) {
-      int start = cmdPosQ + 5;
-      int end = s.indexOf('"', start);
-      if (end > start) s = s.substring(start, end);
+// Rewrite runs of three or more consecutive numbers in a channel list
+// ("4,5,6,7") as ranges ("4-7"), in place; output is never longer
+static void compactRuns(char *s) {
+  char *out = s;
+  const char *p = s;
+  char prev = ' ';
+  auto ends = [](char c) { return c == '\0' || c == ',' || c == ']' || c == ' '; };
+  while (*p) {
+    if (isdigit((unsigned char)*p) && (prev == ' ' || prev == ',' || prev == '[' || prev == '=')) {
+      char *end = nullptr;
+      const long a = strtol(p, &end, 10);
+      long b = a;
+      const char *q = end;
+      int n = 1;
+      while (ends(*end) && *q == ',' && isdigit((unsigned char)q[1])) {
+        char *e = nullptr;
+        const long v = strtol(q + 1, &e, 10);
+        if (v != b + 1 || !ends(*e)) break;
+        b = v; q = e; ++n;
+      }
+      if (n >= 3) {
+        char run[24];
+        const int m = snprintf(run, sizeof(run), "%ld-%ld", a, b);
+        memcpy(out, run, size_t(m));
+        out += m; p = q; prev = '0';
+        continue;
+      }
     }
+    prev = *p;
+    *out++ = *p++;
   }
+  *out = '\0';
+}
 
-  // Find last MAC that is the terminal token
-  String up = s;
-  up.trim();
-  up.toUpperCase();
-  auto isHex = [](char c){ return (c>='0'&&c<='9')||(c>='A'&&c<='F'); };
-
-  for (int i = up.length() - 17; i >= 0; --i) {
-    if (up[i + 2] != ':' || up[i + 5] != ':' || up[i + 8] != ':' ||
-        up[i + 11] != ':' || up[i + 14] != ':') continue;
-
-    bool ok = true;
-    for (int k = 0; k < 17; ++k) {
-      if ((k % 3) == 2) continue;
-      if (!isHex(up[i + k])) { ok = false; break; }
-    }
-    if (!ok) continue;
+// Parse a console line in place. Prefer cmd='…' if present. The MAC must be the
+// last token. Returns the payload (without MAC, trimmed) inside `line`, or nullptr.
+static char *parseLineForCommand(char *line, uint8_t macOut[6]) {
+  char *s = trimInPlace(line);
 
-    // must be end of string
-    String tail = up.substring(i + 17);
-    tail.trim();
-    if (!tail.isEmpty()) continue;
+  // Prefer inner command if cmd='…' or cmd="…" present
+  for (const char *key : {"cmd='", "cmd=\""}) {
+    char *q = strstr(s, key);
+    if (!q) continue;
+    char *start = q + 5;
+    char *end = strchr(start, key[4]);
+    if (end && end > start) { *end = '\0'; s = trimInPlace(start); }
+    break;
+  }
 
-    String macStr = up.substring(i, i + 17);
-    if (!parseMac(macStr, macOut) || isZeroMac(macOut)) continue;
+  // Terminal MAC: the last 17 characters
+  size_t n = strlen(s);
+  if (n < 17) return nullptr;
+  char *mac = s + n - 17;
+  if (!parseMac(mac, macOut) || isZeroMac(macOut)) return nullptr;
+  *mac = '\0';
+  return trimInPlace(s);
+}
 
-    payloadOut = s.substring(0, i);
-    payloadOut.trim();
-    return true;
+// ===== Serial line reader =====
+// Accumulates bytes across loop() calls; returns a NUL-terminated line (without
+// '\n') as soon as one is complete, so back-to-back lines never wait on a timeout.
+static char lineBuf[LINE_MAX];
+static size_t lineLen = 0;
+static bool lineOverflow = false;
+
+static char *readLine() {
+  while (Serial.available() > 0) {
+    int c = Serial.read();
+    if (c < 0) break;
+    if (c == '\n') {
+      lineBuf[lineLen] = '\0';
+      lineLen = 0;
+      if (lineOverflow) {
+        lineOverflow = false;
+        hostLine(nullptr, "ERROR: line longer than %u bytes dropped", (unsigned)(LINE_MAX - 1));
+        continue;
+      }
+      return lineBuf;
+    }
+    if (lineLen < LINE_MAX - 1) lineBuf[lineLen++] = (char)c;
+    else lineOverflow = true;
   }
-  return false;
+  return nullptr;
 }
 
 // ===== Send-callback (IDF4 vs IDF5) =====
 #if defined(ESP_IDF_VERSION_MAJOR) && (ESP_IDF_VERSION_MAJOR >= 5)
 static void onEspNowSent(const wifi_tx_info_t *info, esp_now_send_status_t st) {
   (void)info;
-  Serial.print("→ TX status=");
-  Serial.println(st == ESP_NOW_SEND_SUCCESS ? "OK" : "FAIL");
+  recordTxDone();
+  outPush(OUT_TX_STATUS, nullptr, st == ESP_NOW_SEND_SUCCESS);
 }
 #else
 static void onEspNowSent(const uint8_t *mac, esp_now_send_status_t st) {
-  Serial.print("→ TX to ");
-  if (mac) Serial.print(macToString(mac)); else Serial.print("NULL");
-  Serial.print(" status=");
-  Serial.println(st == ESP_NOW_SEND_SUCCESS ? "OK" : "FAIL");
+  (void)mac;
+  recordTxDone();
+  outPush(OUT_TX_STATUS, nullptr, st == ESP_NOW_SEND_SUCCESS);
 }
 #endif
 
@@ -226,52 +809,54 @@ static void onEspNowRecv(const uint8_t *mac, const uint8_t *data, int len) {
   const uint8_t *src = mac;
 #endif
   if (isZeroMac(src)) return;
-  // safe RX copy
+  // Decode once: classify only; text rendering happens in serialTask
   char rxb[256];
-  int n = min(len, (int)sizeof(rxb) - 1);
-  memcpy(rxb, data, n); rxb[n] = '\0';
-  bool isEv = (n >= 3 && rxb[0]=='E' && rxb[1]=='V' && rxb[2]==' ');
-  bool isUi = (n >= 3 && rxb[0]=='U' && rxb[1]=='I' && rxb[2]==':');
-
-  // Handle ACK packets early (C-style to avoid heap churn)
-  if (strncmp(rxb, "ACK ", 4) == 0) {
-    uint32_t id = strtoul(rxb + 4, nullptr, 10);
-    // Snapshot ACK tuple under a tiny critical section
-    uint32_t waitId; uint8_t waitMac[6];
-    portENTER_CRITICAL(&ackMux);
-    waitId = staAckWaitId; memcpy(waitMac, (const void*)staAckWaitMac, 6);
-    portEXIT_CRITICAL(&ackMux);
-    if (id && id == waitId && memcmp(src, waitMac, 6) == 0) {
-      portENTER_CRITICAL(&ackMux);
-      staAckReceived = true;
-      portEXIT_CRITICAL(&ackMux);
-    }
-    return; // ACK frames carry no additional semantics
-  }
-
-  // Auto-ACK any message that carries an ID token — but only for known peers
-  uint32_t incomingId = 0;
-  if (extractIdToken(rxb, n, incomingId)) {
-    // Gate ACKs to the in-flight expected MAC or active session MAC
-    bool allowAck = false;
-    // expected MAC
-    bool expect; uint8_t expMac[6];
-    portENTER_CRITICAL(&expMux);
-    expect = haveExpectedMac; if (expect) memcpy(expMac, expectedMac, 6);
-    portEXIT_CRITICAL(&expMux);
-    if (expect && memcmp(src, expMac, 6) == 0) allowAck = true;
-    // session MAC
-    if (!allowAck && forwardLive) {
-      bool has; uint8_t smac[6];
-      portENTER_CRITICAL(&sessionMux);
-      has = haveSessionMac; if (has) memcpy(smac, sessionMac, 6);
-      portEXIT_CRITICAL(&sessionMux);
-      if (has && memcmp(src, smac, 6) == 0) allowAck = true;
-    }
+  RxFrame fr = {RX_OTHER, 0, false};
+  kfb::Header h;
+  if (kfb::parseHeader(data, len, h)) {
+    if (!binaryKind(h, data, len, fr.kind)) { outPush(OUT_BAD_TYPE, src, h.type); return; }
+    fr.id = h.id; fr.binary = true;
+  } else if (kfb::isBinary(data, len)) {
+    outPush(OUT_BAD_VERSION, src, data[0] & 0x0F);
+    return;
+  } else {
+    int n = min(len, 255);
+    memcpy(rxb, data, n); rxb[n] = '\0';
+    fr.kind = classifyText(rxb);
+    if (fr.kind == RX_ACK) fr.id = strtoul(rxb + 4, nullptr, 10);
+    else if (!extractIdToken(rxb, n, fr.id)) fr.id = 0;
+  }
 
-    if (allowAck) {
-      char ackBuf[24];
-      int m = snprintf(ackBuf, sizeof(ackBuf), "ACK %lu", (unsigned long)incomingId);
+  // Route to the hub's session; snapshot it under one short critical section
+  HubSession sess = {};
+  bool otherExpected = false; uint8_t otherMac[6];
+  portENTER_CRITICAL(&sessionMux);
+  if (HubSession *s = sessionFind(src)) {
+    // Handle ACK packets early; binary ACKs only carry the low 16 bits of the ID
+    if (fr.kind == RX_ACK && s->txInFlight && fr.id &&
+        fr.id == (fr.binary ? (s->ackWaitId & 0xFFFF) : s->ackWaitId) && !s->ackReceived) {
+      s->ackReceived = true;
+      s->ackAtUs = micros();
+    }
+    s->lastUsed = millis();
+    sess = *s;
+  }
+  if (!sess.expecting) {
+    for (const HubSession &e : sessions)
+      if (e.used && e.expecting) { memcpy(otherMac, e.mac, 6); otherExpected = true; break; }
+  }
+  portEXIT_CRITICAL(&sessionMux);
+  if (fr.kind == RX_ACK) return; // ACK frames carry no additional semantics
+
+  // Auto-ACK any message that carries an ID — but only for hubs with an
+  // in-flight command or a live session
+  if (fr.id) {
+    if (sess.expecting || sess.forwardLive) {
+      // ACK in the format the frame came in
+      uint8_t ackBuf[24];
+      int m;
+      if (fr.binary) m = (int)kfb::putHeader(ackBuf, kfb::FT_ACK, (uint16_t)fr.id);
+      else m = snprintf((char*)ackBuf, sizeof(ackBuf), "ACK %lu", (unsigned long)fr.id) + 1;
       // Respond directly without waiting for ACK (ACKs are not acked)
       esp_now_peer_info_t peer = {};
       memcpy(peer.peer_addr, src, 6);
@@ -280,100 +865,58 @@ static void onEspNowRecv(const uint8_t *mac, const uint8_t *data, int len) {
 #ifdef WIFI_IF_STA
       peer.ifidx = WIFI_IF_STA;
 #endif
-      if (m > 0 && m < (int)sizeof(ackBuf)) {
+      if (m > 0 && m <= (int)sizeof(ackBuf)) {
         esp_err_t e = esp_now_add_peer(&peer);
         if (e == ESP_OK || e == ESP_ERR_ESPNOW_EXIST) {
-          esp_now_send(src, reinterpret_cast<const uint8_t*>(ackBuf), m + 1);
+          espNowSend(src, ackBuf, m);
         }
       }
     }
   }
 
   // EV/UI fast paths — no header logging
-  if (isEv) {
-    if (forwardLive) {
-      uint8_t smac[6]; bool has;
-      portENTER_CRITICAL(&sessionMux);
-      has = haveSessionMac; if (has) memcpy(smac, sessionMac, 6);
-      portEXIT_CRITICAL(&sessionMux);
-      if (!has || memcmp(src, smac, 6) == 0) Serial.println(rxb);
-    }
+  if (fr.kind == RX_EV) {
+    if (sess.forwardLive) outPushFrame(OUT_EV, src, data, len);
     return;
   }
-  if (isUi && forwardLive) { Serial.printf("UI %s %s\n", rxb + 3, macToString(src).c_str()); return; }
+  if (fr.kind == RX_UI && sess.forwardLive) { outPushFrame(OUT_UI, src, data, len); return; }
 
   // For all other frames, log once with header
-  {
-    String from = macToString(src);
-    Serial.print("← reply from "); Serial.print(from); Serial.print(": "); Serial.println(rxb);
-  }
-
-  // One-shot OK responses: clear expected MAC to end filtering window
-  if (strncmp(rxb, "MONITOR-OK", 10) == 0 ||
-      strncmp(rxb, "PING-OK", 7) == 0   ||
-      strncmp(rxb, "CLEAN-OK", 8) == 0) {
-    if (strncmp(rxb, "CLEAN-OK", 8) == 0) {
-      forwardLive = false;
-      portENTER_CRITICAL(&sessionMux);
-      haveSessionMac = false;
-       memset(sessionMac, 0, sizeof sessionMac); 
-      portEXIT_CRITICAL(&sessionMux);
-    }
-    clearExpectedMac();
+  outPushFrame(OUT_REPLY, src, data, len);
+
+  if (!sess.used) return; // no command was ever sent to this hub
+
+  // One-shot OK responses end the hub's reply window
+  if (fr.kind == RX_ONESHOT_OK || fr.kind == RX_CLEAN_OK) {
+    if (fr.kind == RX_CLEAN_OK) sessionEnd(src);
+    else sessionReplied(src);
     return;
   }
 
   // (EV frames already handled in fast path above)
 
   // Session end: accept RESULT/SUCCESS/FAILURE in any state
-  if (strncmp(rxb, "RESULT ", 7) == 0 ||
-      strncmp(rxb, "SUCCESS", 7) == 0 ||
-      strncmp(rxb, "FAILURE", 7) == 0) {
-    forwardLive = false;
-    portENTER_CRITICAL(&sessionMux);
-    haveSessionMac = false;
-    memset(sessionMac, 0, sizeof sessionMac);
-    portEXIT_CRITICAL(&sessionMux);
+  if (fr.kind == RX_RESULT) {
     // already logged above; avoid duplicate prints
-    staState = IDLE; clearExpectedMac();
+    sessionEnd(src);
     return;
   }
 
-  // Optionally pass UI through when streaming
-  // UI handled earlier
-
-  // Filter only when a transaction is in-flight (snapshot expected MAC)
-  bool expect; uint8_t expMac[6];
-  portENTER_CRITICAL(&expMux);
-  expect = haveExpectedMac; memcpy(expMac, expectedMac, 6);
-  portEXIT_CRITICAL(&expMux);
-  if (expect && memcmp(src, expMac, 6) != 0) {
-    Serial.print("ignored: unexpected MAC. expected ");
-    Serial.print(macToString(expMac));
-    Serial.print(" got ");
-    Serial.println(macToString(src));
+  // Only the hub a command is in flight for may answer it
+  if (!sess.expecting) {
+    if (otherExpected) {
+      if (OutRec *r = outAcquire(OUT_UNEXPECTED, src)) { memcpy(r->mac2, otherMac, 6); outCommit(); }
+    }
     return;
   }
 
-  switch (staState) {
+  switch (sess.state) {
     case WAIT_HELLO: {
-      bool isReady   = (strncmp(rxb, "READY",   5) == 0);
-      bool isWelcome = (strncmp(rxb, "WELCOME", 7) == 0);
+      bool isReady   = (fr.kind == RX_READY);
+      bool isWelcome = (fr.kind == RX_WELCOME);
       if (isReady || isWelcome) {
-        Serial.printf("%s %s\n", isReady ? "READY" : "WELCOME", macToString(src).c_str());
-        staState = IDLE;
-        clearExpectedMac();
-      }
-      break;
-    }
-
-    case WAIT_RESULT: {
-      if (strncmp(rxb, "RESULT ", 7) == 0 ||
-          strncmp(rxb, "SUCCESS", 7) == 0 ||
-          strncmp(rxb, "FAILURE", 7) == 0) {
-        forwardLive = false;
-        staState = IDLE; clearExpectedMac();
-        break;
+        outPush(OUT_HELLO, src, isReady);
+        sessionReplied(src);
       }
       break;
     }
@@ -383,8 +926,9 @@ static void onEspNowRecv(const uint8_t *mac, const uint8_t *data, int len) {
   }
 }
 
-static bool sendToPeerRaw(const String &payload, const uint8_t mac[6]) {
-  if (isZeroMac(mac)) { Serial.println("ERROR: refusing to send to zero MAC"); return false; }
+// sentUs: micros() once esp_now_send() accepted the frame
+static bool sendToPeerRaw(const char *payload, const uint8_t mac[6], uint32_t *sentUs = nullptr) {
+  if (isZeroMac(mac)) { hostLine(nullptr, "ERROR: refusing to send to zero MAC"); return false; }
   esp_now_peer_info_t peer = {};
   memcpy(peer.peer_addr, mac, 6);
   peer.channel = ESPNOW_CHANNEL;
@@ -395,79 +939,199 @@ static bool sendToPeerRaw(const String &payload, const uint8_t mac[6]) {
 
   esp_err_t addRes = esp_now_add_peer(&peer);
   if (addRes != ESP_OK && addRes != ESP_ERR_ESPNOW_EXIST) {
-    Serial.printf("ERROR: add_peer failed (%s)\n", esp_err_to_name(addRes));
+    hostLine(mac, "ERROR: add_peer failed (%s)", esp_err_to_name(addRes));
     return false;
   }
 
-  esp_err_t res = esp_now_send(mac,
-                               (const uint8_t*)payload.c_str(),
-                               payload.length() + 1);
+  const size_t len = strlen(payload) + 1;
+  esp_err_t res = espNowSend(mac, (const uint8_t*)payload, len);
   if (res != ESP_OK) {
     // try re-add once if send fails
     esp_now_del_peer(mac);
     if (esp_now_add_peer(&peer) == ESP_OK) {
-      res = esp_now_send(mac, (const uint8_t*)payload.c_str(), payload.length() + 1);
+      res = espNowSend(mac, (const uint8_t*)payload, len);
     }
   }
   if (res != ESP_OK) {
-    Serial.printf("ERROR: send failed (%s)\n", esp_err_to_name(res));
+    hostLine(mac, "ERROR: send failed (%s)", esp_err_to_name(res));
     return false;
   }
-  Serial.print("→ Sent '"); Serial.print(payload); Serial.print("' to "); Serial.println(macToString(mac));
+  if (sentUs) *sentUs = micros();
+  char macStr[18]; macToChars(mac, macStr);
+  hostLine(mac, "→ Sent '%s' to %s", payload, macStr);
   return true;
 }
 
 
-static volatile bool txInFlight = false;
+// Per-hub ACK wait; false when this hub already has a reliable send in flight
+static bool ackWaitBegin(const uint8_t mac[6], uint32_t id) {
+  bool ok = false;
+  portENTER_CRITICAL(&sessionMux);
+  HubSession *s = sessionFind(mac);
+  if (s && !s->txInFlight) { s->txInFlight = true; s->ackWaitId = id; s->ackReceived = false; ok = true; }
+  portEXIT_CRITICAL(&sessionMux);
+  return ok;
+}
+
+static bool ackWaitDone(const uint8_t mac[6], bool finish, uint32_t *ackAtUs = nullptr) {
+  bool got = false;
+  portENTER_CRITICAL(&sessionMux);
+  if (HubSession *s = sessionFind(mac)) {
+    got = s->ackReceived;
+    if (ackAtUs) *ackAtUs = s->ackAtUs;
+    if (finish) s->txInFlight = false;
+  }
+  portEXIT_CRITICAL(&sessionMux);
+  return got;
+}
 
-static bool sendWithAck(const String &payload, const uint8_t mac[6], unsigned timeoutMs = STA_ACK_TIMEOUT_MS, int maxRetries = STA_ACK_MAX_RETRIES) {
-  if (txInFlight) { Serial.println("WARN: tx in flight"); return false; }
-  if (isZeroMac(mac)) { Serial.println("ERROR: zero MAC target"); return false; }
-  txInFlight = true;
-  uint32_t id = nextSeqId();
-  String framed = payload + " ID=" + String(id);
-  if (framed.length() > STA_MAX_PAYLOAD) {
-    Serial.println("ERROR: framed payload too long");
-    txInFlight = false;
+// ===== Async TX engine =====
+// One reliable command per hub is on the air at a time; later ones for the
+// same hub wait in their slot, other hubs proceed in parallel. Outcomes are
+// reported as "TX-OK ID=<n> <MAC>" / "TX-FAIL ID=<n> <MAC>" lines.
+struct TxReq {
+  uint8_t mac[6];
+  uint32_t lineUs;  // micros() when the host line was complete
+  SessionOp op;
+  char payload[STA_MAX_PAYLOAD + 1];
+};
+
+struct TxSlot {
+  enum : uint8_t { FREE, WAITING, IN_FLIGHT } st;
+  uint8_t mac[6];
+  uint32_t order;         // arrival order, keeps per-hub FIFO
+  uint32_t id;
+  int attempts;
+  unsigned long lastSend;
+  unsigned timeoutMs;
+  uint32_t lineUs, firstSendUs;
+  SessionOp op;
+  char framed[STA_MAX_PAYLOAD + 1]; // payload, then " ID=<n>" once started
+};
+
+static QueueHandle_t txQueue = nullptr;
+static TxSlot txSlots[TX_SLOTS];
+
+// loop() side: hand a command to txTask without waiting for the radio
+static bool queueTx(const char *payload, const uint8_t mac[6], uint32_t lineUs, const SessionOp &op) {
+  TxReq req;
+  memcpy(req.mac, mac, 6);
+  req.lineUs = lineUs;
+  req.op = op;
+  const size_t n = strlen(payload);
+  if (n >= sizeof(req.payload)) {
+    hostLine(nullptr, "ERROR: framed payload too long");
     return false;
   }
-  setAckWait(id, mac);
-
-  int attempts = 0;
-  unsigned long lastSend = 0;
-  unsigned curTimeout = timeoutMs;
-  while (attempts <= maxRetries) {
-    unsigned long now = millis();
-      if (attempts == 0 || now - lastSend >= curTimeout) {
-      if (!sendToPeerRaw(framed, mac)) {
-        // if send API failed, small yield then retry
-        vTaskDelay(pdMS_TO_TICKS(1));
+  memcpy(req.payload, payload, n + 1);
+  if (xQueueSend(txQueue, &req, 0) != pdTRUE) {
+    hostLine(nullptr, "ERROR: tx queue full");
+    return false;
+  }
+  return true;
+}
+
+static void txFinish(TxSlot &t, bool ok) {
+  uint32_t ackAtUs = 0;
+  if (ackWaitDone(t.mac, true, &ackAtUs) && ok) latency[LAT_ACK].record(ackAtUs - t.firstSendUs);
+  if (!ok) {
+    hostLine(t.mac, "WARN: no ACK for ID=%lu after %d attempts", (unsigned long)t.id, t.attempts);
+    sessionEnd(t.mac);
+  }
+  char macStr[18]; macToChars(t.mac, macStr);
+  hostLine(t.mac, "%s ID=%lu %s", ok ? "TX-OK" : "TX-FAIL", (unsigned long)t.id, macStr);
+  t.st = TxSlot::FREE;
+}
+
+static void txStart(TxSlot &t) {
+  t.id = nextSeqId();
+  size_t n = strlen(t.framed);
+  int m = snprintf(t.framed + n, sizeof(t.framed) - n, " ID=%lu", (unsigned long)t.id);
+  if (m < 0 || n + (size_t)m > STA_MAX_PAYLOAD) {
+    hostLine(nullptr, "ERROR: framed payload too long");
+    t.st = TxSlot::FREE;
+    return;
+  }
+  if (!sessionBegin(t.mac, t.op)) {
+    hostLine(nullptr, "ERROR: all %d hub sessions busy", MAX_SESSIONS);
+    char macStr[18]; macToChars(t.mac, macStr);
+    hostLine(t.mac, "TX-FAIL ID=%lu %s", (unsigned long)t.id, macStr);
+    t.st = TxSlot::FREE;
+    return;
+  }
+  if (!ackWaitBegin(t.mac, t.id)) { // session recycled underneath us
+    t.attempts = 0;
+    txFinish(t, false);
+    return;
+  }
+  t.st = TxSlot::IN_FLIGHT;
+  t.attempts = 1;
+  t.timeoutMs = STA_ACK_TIMEOUT_MS;
+  t.lastSend = millis();
+  t.firstSendUs = micros();
+  uint32_t sentUs;
+  if (sendToPeerRaw(t.framed, t.mac, &sentUs)) latency[LAT_CMD_TX].record(sentUs - t.lineUs);
+}
+
+static void txTask(void *) {
+  uint32_t order = 0;
+  for (;;) {
+    bool busy = false;
+    for (const TxSlot &t : txSlots) if (t.st != TxSlot::FREE) { busy = true; break; }
+
+    // Idle: sleep until a command arrives; busy: poll ACKs every tick
+    TxReq req;
+    if (xQueueReceive(txQueue, &req, busy ? 1 : portMAX_DELAY) == pdTRUE) {
+      TxSlot *t = nullptr;
+      for (TxSlot &e : txSlots) if (e.st == TxSlot::FREE) { t = &e; break; }
+      if (!t) {
+        // Not started, so no session state of it to undo
+        char macStr[18]; macToChars(req.mac, macStr);
+        hostLine(req.mac, "ERROR: tx backlog full, dropped for %s", macStr);
+      } else {
+        t->st = TxSlot::WAITING;
+        memcpy(t->mac, req.mac, 6);
+        t->order = order++;
+        t->lineUs = req.lineUs;
+        t->op = req.op;
+        memcpy(t->framed, req.payload, sizeof(req.payload));
       }
-      lastSend = now;
-      attempts++;
-      if (attempts > 1) { // simple linear backoff with clamp
-        unsigned next = curTimeout + 80;
-        curTimeout = (next > 640u) ? 640u : next;
+    }
+
+    // ACKs, retransmits and give-ups
+    const unsigned long now = millis();
+    for (TxSlot &t : txSlots) {
+      if (t.st != TxSlot::IN_FLIGHT) continue;
+      if (ackWaitDone(t.mac, false)) { txFinish(t, true); continue; }
+      if (now - t.lastSend < t.timeoutMs) continue;
+      if (t.attempts > STA_ACK_MAX_RETRIES) { txFinish(t, false); continue; }
+      sendToPeerRaw(t.framed, t.mac);
+      t.lastSend = now;
+      t.attempts++;
+      // simple linear backoff with clamp
+      unsigned next = t.timeoutMs + STA_ACK_BACKOFF_MS;
+      t.timeoutMs = (next > STA_ACK_TIMEOUT_MAX_MS) ? STA_ACK_TIMEOUT_MAX_MS : next;
+    }
+
+    // Start the oldest waiting command of every hub that has nothing in flight
+    for (;;) {
+      TxSlot *next = nullptr;
+      for (TxSlot &t : txSlots) {
+        if (t.st != TxSlot::WAITING) continue;
+        bool hubBusy = false;
+        for (const TxSlot &o : txSlots)
+          if (&o != &t && o.st != TxSlot::FREE && memcmp(o.mac, t.mac, 6) == 0 &&
+              (o.st == TxSlot::IN_FLIGHT || (int32_t)(o.order - t.order) < 0)) { hubBusy = true; break; }
+        if (!hubBusy) { next = &t; break; }
       }
+      if (!next) break;
+      txStart(*next);
     }
-    
-  bool gotAck = false;
-  portENTER_CRITICAL(&ackMux);
-  gotAck = staAckReceived;
-  portEXIT_CRITICAL(&ackMux);
-  if (gotAck) { txInFlight = false; return true; }
-
-    // cooperative yield to Wi-Fi task
-    vTaskDelay(pdMS_TO_TICKS(1));
-  }
-  Serial.printf("WARN: no ACK for ID=%lu after %d attempts\n", (unsigned long)id, attempts);
-  txInFlight = false;
-  return false;
+  }
 }
 
 void setup() {
-  Serial.begin(115200);
-  Serial.setTimeout(50);
+  Serial.begin(SERIAL_BAUD);
   while (!Serial) delay(10);
   Serial.println("Station booting...");
 
@@ -486,93 +1150,152 @@ void setup() {
     while (true) delay(1000);
   }
 
+  // Writer first: the callbacks start feeding its ring right away
+  if (xTaskCreatePinnedToCore(serialTask, "serial-out", 6144, nullptr, SERIAL_TASK_PRIO,
+                              &serialTaskHandle, tskNO_AFFINITY) != pdPASS) {
+    Serial.println("ERROR: serial task create failed");
+    while (true) delay(1000);
+  }
+
   esp_now_register_recv_cb(onEspNowRecv);
   esp_now_register_send_cb(onEspNowSent);
 
+  txQueue = xQueueCreate(TX_QUEUE_LEN, sizeof(TxReq));
+  if (!txQueue || xTaskCreatePinnedToCore(txTask, "tx", 4096, nullptr, TX_TASK_PRIO,
+                                          nullptr, tskNO_AFFINITY) != pdPASS) {
+    Serial.println("ERROR: tx task create failed");
+    while (true) delay(1000);
+  }
+
   Serial.println("Ready. Usage:");
   Serial.println("  WELCOME …MAC");
   Serial.println("  MONITOR NORMAL … LATCH … …MAC");
-  Serial.println("  CHECK 5,6,10,13,20 …MAC");
+  Serial.println("  CHECK 5,6,10-13,20 …MAC");
   Serial.println("  PING …MAC");
   Serial.println("  CLEAN …MAC");
+  Serial.println("  STATS [RESET] [MAC]   (latency per stage; no MAC = this station)");
+  Serial.println("  MONITOR/CHECK options: SAMPLES=n SPACING=ms PASS=n|ALL|MAJORITY SETTLE=ms HOLD=ms");
   Serial.println("Also supported: cmd='CHECK 5,6,10,13,20 …MAC'");
 }
 
-void loop() {
-  if (!Serial.available()) { vTaskDelay(pdMS_TO_TICKS(10)); return; }
+// "SERIAL BIN [baud]" / "SERIAL TEXT". The acknowledgement goes out in the
+// old mode at the old rate; records caught in the switch fail the host's CRC.
+static void setLinkMode(char *args) {
+  args = trimInPlace(args);
+  if (startsWithNoCase(args, "TEXT")) {
+    hostLine(nullptr, "SERIAL-OK TEXT %lu", SERIAL_BAUD);
+    Serial.flush();
+    linkBinary.store(false, std::memory_order_relaxed);
+    Serial.updateBaudRate(SERIAL_BAUD);
+    return;
+  }
+  if (!startsWithNoCase(args, "BIN")) {
+    hostLine(nullptr, "ERROR: usage SERIAL BIN [baud] | SERIAL TEXT");
+    return;
+  }
+  unsigned long baud = strtoul(args + 3, nullptr, 10);
+  if (!baud) baud = SERIAL_FAST_BAUD;
+  if (baud < SERIAL_BAUD || baud > SERIAL_FAST_BAUD_MAX) {
+    hostLine(nullptr, "ERROR: serial baud %lu outside %lu..%lu", baud, SERIAL_BAUD, SERIAL_FAST_BAUD_MAX);
+    return;
+  }
+  hostLine(nullptr, "SERIAL-OK BIN %lu", baud);
+  Serial.flush();
+  linkBinary.store(true, std::memory_order_relaxed);
+  Serial.updateBaudRate(baud);
+}
 
-  // Read one line and extract "<payload> … <MAC at end>" or "cmd='… MAC'"
-  String line = Serial.readStringUntil('\n');
-  line.trim();
-  if (line.isEmpty()) return;
+// Local "STATS" / "STATS RESET"
+static void printStats(bool reset) {
+  if (reset) {
+    for (auto &h : latency) h.reset();
+    hostLine(nullptr, "STATS-OK RESET");
+    return;
+  }
+  char line[80];
+  for (int i = 0; i < LAT_COUNT; ++i) {
+    latency[i].format(LAT_NAMES[i], line, sizeof(line));
+    hostLine(nullptr, "%s", line);
+  }
+  hostLine(nullptr, "STATS-OK");
+}
 
-  String payload;
+void loop() {
+  char *line = readLine();
+  if (!line) { vTaskDelay(pdMS_TO_TICKS(10)); return; }
+  const uint32_t lineUs = micros();
+
+  // Extract "<payload> … <MAC at end>" or "cmd='… MAC'"
+  line = trimInPlace(line);
+  if (!*line) return;
+  if (startsWithNoCase(line, "SERIAL ")) { setLinkMode(line + 7); return; }
+  if (startsWithNoCase(line, "STATS") && (!line[5] || (startsWithNoCase(line + 5, " RESET") && !line[11]))) {
+    printStats(line[5] != '\0');
+    return;
+  }
+
+  char raw[LINE_MAX];  // parsing is destructive; keep the line for the error message
+  memcpy(raw, line, strlen(line) + 1);
   uint8_t macTmp[6] = {0};
-  if (!parseLineForCommand(line, payload, macTmp)) {
-    Serial.printf("ERROR: invalid command or MAC in line: '%s'\n", line.c_str());
-    clearExpectedMac();
+  char *payload = parseLineForCommand(line, macTmp);
+  if (!payload) {
+    hostLine(nullptr, "ERROR: invalid command or MAC in line: '%s'", raw);
     return;
   }
   if (isZeroMac(macTmp)) {
-    Serial.println("ERROR: target MAC is all zeroes");
-    clearExpectedMac();
+    hostLine(nullptr, "ERROR: target MAC is all zeroes");
     return;
   }
-  setExpectedMac(macTmp, true);
 
-  String pfx = payload; pfx.trim(); pfx.toUpperCase();
-  bool isWelcome = pfx.startsWith("WELCOME");
-  bool isMonitor = pfx.startsWith("MONITOR");
-  bool isCheck   = pfx.startsWith("CHECK");
-  bool isPing    = pfx.startsWith("PING");
-  bool isClean   = pfx.startsWith("CLEAN");
-  bool isNoise   = pfx.startsWith("HELLO") || pfx.startsWith("READY");
-
-  if (!(isWelcome || isMonitor || isCheck || isPing || isClean)) {
-    if (isNoise) Serial.println("note: host noise ignored");
-    else Serial.printf("ignored: unknown command '%s'\n", payload.c_str());
-    clearExpectedMac();
+  bool isWelcome = startsWithNoCase(payload, "WELCOME");
+  bool isMonitor = startsWithNoCase(payload, "MONITOR");
+  bool isCheck   = startsWithNoCase(payload, "CHECK");
+  bool isPing    = startsWithNoCase(payload, "PING");
+  bool isClean   = startsWithNoCase(payload, "CLEAN");
+  bool isStats   = startsWithNoCase(payload, "STATS");
+  bool isNoise   = startsWithNoCase(payload, "HELLO") || startsWithNoCase(payload, "READY");
+
+  if (!(isWelcome || isMonitor || isCheck || isPing || isClean || isStats)) {
+    if (isNoise) hostLine(nullptr, "note: host noise ignored");
+    else hostLine(nullptr, "ignored: unknown command '%s'", payload);
     return;
   }
 
-  if (isCheck && !validateCheckPins(payload)) {
-    Serial.println("ERROR: invalid CHECK pins list");
-    clearExpectedMac();
-    return;
+  // Long channel lists (boards past 40 channels) only fit one frame as ranges;
+  // 16 = room for " ID=<n>"
+  if ((isMonitor || isCheck) && strlen(payload) + 16 > STA_MAX_PAYLOAD) compactRuns(payload);
+
+  if (isMonitor || isCheck) {
+    // FINAL_CHECK policy tokens (SAMPLES=, SPACING=, PASS=, SETTLE=, HOLD=) go
+    // to the hub as typed; check their ranges here and the pins without them
+    char args[LINE_MAX];
+    memcpy(args, payload, strlen(payload) + 1);
+    kfb::CheckPolicy policy{};
+    if (!kfb::takePolicy(args, policy)) {
+      hostLine(nullptr, "ERROR: invalid FINAL_CHECK policy in '%s'", payload);
+      return;
+    }
+    if (isCheck && !validateCheckPins(args)) {
+      hostLine(nullptr, "ERROR: invalid CHECK pins list");
+      return;
+    }
   }
 
   // payload saved no longer needed; send directly
 
-  if (isWelcome)      staState = WAIT_HELLO;
-  else if (isCheck)   staState = WAIT_RESULT;
-  else                staState = IDLE; // MONITOR, PING, CLEAN are fire-and-forget
+  // MONITOR, PING, CLEAN, STATS are fire-and-forget; other hubs' sessions are
+  // untouched. CHECK/MONITOR gate live forwarding on until end-of-session.
+  // txTask applies this when the command starts, after earlier ones for the hub.
+  SessionOp op{!(isPing || isStats), isWelcome ? WAIT_HELLO : isCheck ? WAIT_RESULT : IDLE,
+               int8_t(isMonitor || isCheck ? 1 : isClean ? 0 : -1)};
+  if (!sessionReserve(macTmp)) {
+    hostLine(nullptr, "ERROR: all %d hub sessions busy", MAX_SESSIONS);
+    return;
+  }
 
-  // Gate live forwarding during CHECK/MONITOR until end-of-session; bind session to MAC
-  if (isMonitor || isCheck) {
-    forwardLive = true;
-    portENTER_CRITICAL(&sessionMux);
-    memcpy(sessionMac, macTmp, 6);
-    haveSessionMac = true;
-    portEXIT_CRITICAL(&sessionMux);
-  }
-  if (isClean) {
-    forwardLive = false;
-    portENTER_CRITICAL(&sessionMux);
-    haveSessionMac = false;
-    memset(sessionMac, 0, sizeof sessionMac);
-    portEXIT_CRITICAL(&sessionMux);
-  }
-
-  if (!sendWithAck(payload, macTmp)) {
-    staState = IDLE;
-    clearExpectedMac();
-    forwardLive = false;
-    portENTER_CRITICAL(&sessionMux);
-    haveSessionMac = false;
-    memset(sessionMac, 0, sizeof sessionMac);
-    portEXIT_CRITICAL(&sessionMux);
-  }
-  vTaskDelay(pdMS_TO_TICKS(1));
+  // Non-blocking: txTask reports TX-OK / TX-FAIL, loop() goes back to reading.
+  // A command that never got queued changed no session state.
+  queueTx(payload, macTmp, lineUs, op);
 }
 
 #endif // GUI_HAS_ESP32_HEADERS
@@ -28,6 +28,8 @@ export type SerialEvent =
       line?: string;
       ts?: number;
     }
+  // Final harness state sent with a hub's RESULT (see parseFinalLine in serial.ts)
+  | { type: 'final'; mac: string; pressed: number[]; latched: number[]; unlatched: number[]; ts: number }
   // Union aliases broadcast (after CHECK or manual rehydrate)
   | { type: 'aliases/union'; mac: string; names?: Record<string,string>; normalPins?: number[]; latchPins?: number[] }
   // Simulate API can force UI checks without a physical scan event
@@ -0,0 +1,116 @@
+// src/lib/espLink.ts
+import { Transform, type TransformCallback } from "stream";
+
+/* ────────────────────────────────────────────────────────────────────────────
+   Station binary link ("SERIAL BIN <baud>")
+   Record: [type][hub MAC, 6][payload][CRC16-CCITT LE], COBS-encoded, 0x00-terminated.
+   Decoded records are rendered back into the legacy text lines so every
+   consumer of the ESP line stream keeps working unchanged.
+   ──────────────────────────────────────────────────────────────────────────── */
+
+export const LR_LINE = 1;   // payload: one text line
+export const LR_EV = 2;     // payload: [kind 'P'|'L'][channel][value]
+export const LR_EVENTS = 3; // payload: [flags][n][P changed][P value][L changed][L value]
+export const LR_REPLY = 4;  // payload: reply text
+
+const EVF_SNAPSHOT = 0x01;
+
+export type LinkRecord = { type: number; mac: string; payload: Buffer };
+
+export function crc16(d: Uint8Array, end = d.length): number {
+  let crc = 0xffff;
+  for (let i = 0; i < end; i++) {
+    crc ^= d[i]! << 8;
+    for (let b = 0; b < 8; b++) crc = crc & 0x8000 ? ((crc << 1) ^ 0x1021) & 0xffff : (crc << 1) & 0xffff;
+  }
+  return crc;
+}
+
+/** Decode one COBS block (delimiter already stripped); null when malformed. */
+export function cobsDecode(src: Uint8Array): Buffer | null {
+  const out = Buffer.alloc(src.length);
+  let o = 0;
+  let i = 0;
+  while (i < src.length) {
+    const code = src[i++]!;
+    if (code === 0 || i + code - 1 > src.length) return null;
+    for (let k = 1; k < code; k++) out[o++] = src[i++]!;
+    if (code < 0xff && i < src.length) out[o++] = 0;
+  }
+  return out.subarray(0, o);
+}
+
+function macString(b: Uint8Array, off: number): string {
+  const parts: string[] = [];
+  for (let i = 0; i < 6; i++) parts.push(b[off + i]!.toString(16).toUpperCase().padStart(2, "0"));
+  return parts.join(":");
+}
+
+export function decodeRecord(frame: Uint8Array): LinkRecord | null {
+  const rec = cobsDecode(frame);
+  if (!rec || rec.length < 9) return null;
+  const end = rec.length - 2;
+  if (crc16(rec, end) !== (rec[end]! | (rec[end + 1]! << 8))) return null;
+  return { type: rec[0]!, mac: macString(rec, 1), payload: rec.subarray(7, end) };
+}
+
+/** Same lines, in the same order, as the station prints in text mode. */
+export function recordToLines(r: LinkRecord): string[] {
+  const p = r.payload;
+  switch (r.type) {
+    case LR_LINE:
+      return [p.toString("utf8")];
+    case LR_REPLY:
+      return [`← reply from ${r.mac}: ${p.toString("utf8")}`];
+    case LR_EV:
+      if (p.length < 3) return [];
+      return [`EV ${String.fromCharCode(p[0]!)} ${p[1]} ${p[2] ? 1 : 0} ${r.mac}`];
+    case LR_EVENTS: {
+      if (p.length < 2) return [];
+      const n = p[1]!;
+      if (p.length < 2 + 4 * n) return [];
+      const bit = (base: number, i: number) => (p[2 + base * n + (i >> 3)]! >> (i & 7)) & 1;
+      const ev = (kind: "P" | "L", i: number) => `EV ${kind} ${i + 1} ${bit(kind === "P" ? 1 : 3, i)} ${r.mac}`;
+      const out: string[] = [];
+      if (p[0]! & EVF_SNAPSHOT) {
+        for (let i = 0; i < n * 8; i++) {
+          if (bit(0, i)) out.push(ev("P", i));
+          if (bit(2, i)) out.push(ev("L", i));
+        }
+        return out;
+      }
+      for (let i = 0; i < n * 8; i++) if (bit(2, i)) out.push(ev("L", i));
+      for (let i = 0; i < n * 8; i++) if (bit(0, i)) out.push(ev("P", i));
+      return out;
+    }
+    default:
+      return [];
+  }
+}
+
+/** Byte stream -> legacy text lines. Frames failing COBS/CRC are counted and skipped. */
+export class EspLinkParser extends Transform {
+  private buf = Buffer.alloc(0);
+  bad = 0;
+
+  constructor() {
+    super({ readableObjectMode: true });
+  }
+
+  _transform(chunk: Buffer, _enc: BufferEncoding, cb: TransformCallback): void {
+    this.buf = this.buf.length ? Buffer.concat([this.buf, chunk]) : chunk;
+    let start = 0;
+    let z: number;
+    while ((z = this.buf.indexOf(0, start)) !== -1) {
+      if (z > start) {
+        const rec = decodeRecord(this.buf.subarray(start, z));
+        if (rec) for (const line of recordToLines(rec)) this.push(line);
+        else this.bad++;
+      }
+      start = z + 1;
+    }
+    this.buf = this.buf.subarray(start);
+    if (this.buf.length > 4096) { this.buf = Buffer.alloc(0); this.bad++; } // no delimiter: resync
+    cb();
+  }
+}
@@ -6,6 +6,7 @@ import { broadcast } from "./bus.js";
 import type { DeviceInfo } from "./bus.js";
 import { Transform } from "stream";
 import { ReadlineParser } from "@serialport/parser-readline";
+import { EspLinkParser } from "./espLink.js";
 /* ────────────────────────────────────────────────────────────────────────────
    ESP line stream — singleton with ring buffer + subscriber fan-out
    Adds cursoring so callers can fence reads to “future-only”.
@@ -35,6 +36,13 @@ function espBaud(): number {
   const b = Number(process.env.ESP_BAUD ?? 115200);
   return Number.isFinite(b) && b > 0 ? b : 115200;
 }
+// ESP_LINK=bin negotiates the station's framed binary mode at ESP_LINK_BAUD
+function espLinkBaud(): number | null {
+  const mode = String(process.env.ESP_LINK ?? "text").trim().toLowerCase();
+  if (mode !== "bin" && mode !== "binary") return null;
+  const b = Number(process.env.ESP_LINK_BAUD ?? 921600);
+  return Number.isFinite(b) && b > 0 ? b : 921600;
+}
 
 // Simple env toggle. Accepts 1/true/TRUE. Also force-enable when Krosy is offline.
 const SIMULATE = (() => {
@@ -217,7 +225,7 @@ function armEsp(): EspLineStream {
   const parser = port.pipe(new ReadlineParser({ delimiter: "\n" }));
 
   // --- update the data handler
-  parser.on("data", (buf: Buffer | string) => {
+  const onLine = (buf: Buffer | string) => {
     const s = String(buf).trim();
     if (!s) return;
 
@@ -237,12 +245,25 @@ function armEsp(): EspLineStream {
     subs.forEach((fn) => {
       try { fn(s, ringIds[ringIds.length - 1]!); } catch {}
     });
-  });
+
+    const fin = parseFinalLine(s);
+    if (fin) {
+      finalStates.set(fin.mac, fin);
+      broadcast({ type: "final", ...fin });
+    }
+  };
+  parser.on("data", onLine);
 
   port.on("error", (e) => {
     LOG.tag('esp').error(`error on ${path}`, e?.message ?? e);
   });
 
+  const linkBaud = espLinkBaud();
+  if (linkBaud) {
+    enterBinaryLink(port, parser, onLine, baudRate, linkBaud).catch((e) =>
+      LOG.tag('esp').warn(`binary link on ${path} failed, staying in text mode: ${e?.message ?? e}`));
+  }
+
   port.on("close", () => {
     GBL.__ESP_STREAM = undefined; // allow re-open later
   });
@@ -251,6 +272,148 @@ function armEsp(): EspLineStream {
   return GBL.__ESP_STREAM as EspLineStream;
 }
 
+// "FINAL PRESSED=<hex> LATCHED=<hex> UNLATCHED=<hex> <MAC>": the station prints
+// it right before a RESULT. Each set is a bitmask in hex, byte 0 first, bit i =
+// channel i+1. pressed/latched are the final state of the tracked channels,
+// unlatched the contactless channels among the missing ones.
+export type FinalState = { mac: string; pressed: number[]; latched: number[]; unlatched: number[]; ts: number };
+
+const FINAL_RE = /\bFINAL PRESSED=([0-9A-F]*) LATCHED=([0-9A-F]*) UNLATCHED=([0-9A-F]*) ([0-9A-F]{2}(?::[0-9A-F]{2}){5})\b/i;
+
+function maskChannels(hex: string): number[] {
+  const out: number[] = [];
+  for (let i = 0; 2 * i + 1 < hex.length; i++) {
+    const b = parseInt(hex.slice(2 * i, 2 * i + 2), 16);
+    for (let k = 0; k < 8; k++) if (b & (1 << k)) out.push(i * 8 + k + 1);
+  }
+  return out;
+}
+
+export function parseFinalLine(line: string): FinalState | null {
+  const m = FINAL_RE.exec(line);
+  if (!m) return null;
+  return {
+    mac: m[4]!.toUpperCase(),
+    pressed: maskChannels(m[1]!),
+    latched: maskChannels(m[2]!),
+    unlatched: maskChannels(m[3]!),
+    ts: Date.now(),
+  };
+}
+
+// Latest final state per hub MAC, from the last RESULT that carried one
+const finalStates = new Map<string, FinalState>();
+export function getFinalState(mac: string): FinalState | null {
+  return finalStates.get(mac.toUpperCase()) ?? null;
+}
+
+// Binary link watchdog. A station reset puts it back in text at its boot
+// rate, which the record decoder only sees as CRC failures or silence.
+const LINK_CHECK_MS = 1000;
+const LINK_MAX_BAD = 4;          // bad records within one check period
+const LINK_SILENCE_MS = 10000;   // no record this long: probe the station
+const LINK_PROBE_MS = 2000;      // probe answer deadline
+
+function setBaud(port: SerialPort, baudRate: number): Promise<void> {
+  return new Promise<void>((resolve, reject) =>
+    port.update({ baudRate }, (err) => (err ? reject(err) : resolve())));
+}
+
+// Ask the station for "SERIAL BIN <baud>", then swap the line parser for the
+// record decoder. Decoded records arrive as the same text lines as before.
+async function enterBinaryLink(
+  port: SerialPort,
+  lineParser: ReadlineParser,
+  onLine: (s: string) => void,
+  textBaud: number,
+  baudRate: number
+): Promise<void> {
+  await waitUntilOpen(port);
+  const acked = new Promise<boolean>((resolve) => {
+    const onData = (buf: Buffer | string) => {
+      if (!/^SERIAL-OK BIN\b/.test(String(buf).trim())) return;
+      clearTimeout(timer); lineParser.off("data", onData); resolve(true);
+    };
+    const timer = setTimeout(() => { lineParser.off("data", onData); resolve(false); }, 2000);
+    lineParser.on("data", onData);
+  });
+  port.write(`SERIAL BIN ${baudRate}\r\n`);
+  if (!(await acked)) throw new Error("no SERIAL-OK from station");
+
+  port.unpipe(lineParser);
+  try {
+    await setBaud(port, baudRate);
+  } catch (e: any) {
+    // The station already switched; only its reset brings it back to text
+    port.pipe(lineParser);
+    throw new Error(`baud switch failed (${e?.message ?? e}), text parser kept for the station's next reset`);
+  }
+  const frames = port.pipe(new EspLinkParser());
+  frames.on("data", onLine);
+  if (GBL.__ESP_STREAM) GBL.__ESP_STREAM.parser = frames;
+  LOG.tag('esp').info(`binary link @${baudRate}`);
+  watchBinaryLink(port, lineParser, frames, onLine, textBaud, baudRate);
+}
+
+// Every LINK_CHECK_MS: fall back after LINK_MAX_BAD bad records, or when a
+// re-sent "SERIAL BIN" after LINK_SILENCE_MS of silence goes unanswered.
+function watchBinaryLink(
+  port: SerialPort,
+  lineParser: ReadlineParser,
+  frames: EspLinkParser,
+  onLine: (s: string) => void,
+  textBaud: number,
+  baudRate: number
+): void {
+  let seenBad = frames.bad;
+  let lastRecordAt = Date.now();
+  let probeAt = 0;
+  const onRecord = () => { lastRecordAt = Date.now(); probeAt = 0; };
+  frames.on("data", onRecord);
+  const timer = setInterval(() => {
+    const now = Date.now();
+    const bad = frames.bad - seenBad;
+    seenBad = frames.bad;
+    let reason: string | null = null;
+    if (bad >= LINK_MAX_BAD) reason = `${bad} bad records in ${LINK_CHECK_MS} ms`;
+    else if (probeAt && now - probeAt >= LINK_PROBE_MS) reason = `silent for ${now - lastRecordAt} ms`;
+    else if (!probeAt && now - lastRecordAt >= LINK_SILENCE_MS) {
+      probeAt = now;
+      port.write(`SERIAL BIN ${baudRate}\r\n`);
+    }
+    if (!reason) return;
+    stop();
+    fallBackToText(port, lineParser, frames, onLine, textBaud, baudRate, reason).catch((e) =>
+      LOG.tag('esp').warn(`text fallback failed: ${e?.message ?? e}`));
+  }, LINK_CHECK_MS);
+  const stop = () => {
+    clearInterval(timer);
+    frames.off("data", onRecord);
+    port.off("close", stop);
+  };
+  port.on("close", stop);
+}
+
+// Back to the line parser at the text rate, then negotiate the link again
+async function fallBackToText(
+  port: SerialPort,
+  lineParser: ReadlineParser,
+  frames: EspLinkParser,
+  onLine: (s: string) => void,
+  textBaud: number,
+  baudRate: number,
+  reason: string
+): Promise<void> {
+  LOG.tag('esp').warn(`binary link lost (${reason}), back to text @${textBaud}`);
+  port.unpipe(frames);
+  frames.off("data", onLine);
+  await setBaud(port, textBaud);
+  port.pipe(lineParser);
+  if (GBL.__ESP_STREAM) GBL.__ESP_STREAM.parser = lineParser;
+  await enterBinaryLink(port, lineParser, onLine, textBaud, baudRate).catch((e) =>
+    LOG.tag('esp').warn(`binary link renegotiation failed, staying in text mode: ${e?.message ?? e}`));
+}
+
 export function getEspLineStream(): EspLineStream { return armEsp(); }
 export function mark(): number {
   const { ringIds } = armEsp();